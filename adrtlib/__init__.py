@@ -10,7 +10,52 @@ try:
         ds_non_recursive as ds_non_recursive,
         dt_recursive as dt_recursive,
         dt_non_recursive as dt_non_recursive,
+        ds_adjoint as ds_adjoint,
+        dt_adjoint as dt_adjoint,
+        ids_adjoint as ids_adjoint,
+        idt_adjoint as idt_adjoint,
+        ds_pruned as ds_pruned,
+        dt_pruned as dt_pruned,
+        ds_roi as ds_roi,
+        dt_roi as dt_roi,
+        ds_top_k as ds_top_k,
+        dt_top_k as dt_top_k,
+        ms as ms,
+        mt as mt,
+        ss as ss,
+        st as st,
+        sp as sp,
+        khanipov as khanipov,
+        rdbu as rdbu,
+        rubd as rubd,
+        asd2 as asd2,
+        asd2_statistics as asd2_statistics,
+        ds_batch as ds_batch,
+        dt_batch as dt_batch,
+        ids_batch as ids_batch,
+        idt_batch as idt_batch,
+        ds_full as ds_full,
+        dt_full as dt_full,
+        ids_full as ids_full,
+        idt_full as idt_full,
+        DPlan as DPlan,
+        IDSPlan as IDSPlan,
+        IDTPlan as IDTPlan,
+        DBatchPlan as DBatchPlan,
+        IDSBatchPlan as IDSBatchPlan,
+        IDTBatchPlan as IDTBatchPlan,
+        MPlan as MPlan,
+        SPlan as SPlan,
+        SPPlan as SPPlan,
+        KhanipovPlan as KhanipovPlan,
+        ASD2Plan as ASD2Plan,
+        DTStream as DTStream,
+        DIncremental as DIncremental,
         round05 as round05,
+        ISA as ISA,
+        set_isa as set_isa,
+        active_isa as active_isa,
+        supported_isa as supported_isa,
     )
 
     # aliases
@@ -22,5 +67,22 @@ try:
     fht2ds_non_recursive = ds_non_recursive
     fht2dt_recursive = dt_recursive
     fht2dt_non_recursive = dt_non_recursive
+    fht2ds_adjoint = ds_adjoint
+    fht2dt_adjoint = dt_adjoint
+    fht2ids_adjoint = ids_adjoint
+    fht2idt_adjoint = idt_adjoint
+    fht2ds_pruned = ds_pruned
+    fht2dt_pruned = dt_pruned
+    fht2ds_roi = ds_roi
+    fht2dt_roi = dt_roi
+    fht2ds_top_k = ds_top_k
+    fht2dt_top_k = dt_top_k
+    fht2ms = ms
+    fht2mt = mt
+    fht2ss = ss
+    fht2st = st
+    fht2sp = sp
+    fht2rdbu = rdbu
+    fht2rubd = rubd
 except ImportError:
     pass  # fine, c++ version failed to compile
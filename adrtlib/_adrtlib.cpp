@@ -1,13 +1,26 @@
 #include <nanobind/nanobind.h>
 #include <nanobind/ndarray.h>
+#include <nanobind/stl/optional.h>
+#include <nanobind/stl/pair.h>
+#include <nanobind/stl/vector.h>
 
 #include <adrtlib/adrtlib.hpp>
+#include <limits>
 #include <memory>
+#include <mutex>
+#include <optional>
+#include <type_traits>
+#include <utility>
+#include <variant>
+#include <vector>
 
 namespace nb = nanobind;
 using namespace nb::literals;
 
-using Image2D = nb::ndarray<nb::numpy, nb::ndim<2>, nb::device::cpu>;
+// Any DLPack producer on CPU: NumPy, PyTorch, JAX, ...
+using Image2D = nb::ndarray<nb::ndim<2>, nb::device::cpu>;
+// for images that are only read
+using ConstImage2D = nb::ndarray<nb::ro, nb::ndim<2>, nb::device::cpu>;
 
 static adrt::Sign int_to_sign(int sign) {
   switch (sign) {
@@ -20,6 +33,116 @@ static adrt::Sign int_to_sign(int sign) {
   }
 }
 
+//
+// `adrt::Tensor2D` over an image. Rows may be padded, reversed or be a view
+// into a larger frame, they are used in place. The transforms need pixels of
+// a row to be adjacent, so images with other column strides go through a
+// contiguous copy: filled from the image on `Load::Yes` and written back by
+// `store`.
+//
+class ImageView {
+  std::unique_ptr<uint8_t[]> staging;
+  uint8_t *data;
+  int64_t row_stride;     // bytes
+  int64_t column_stride;  // bytes
+  size_t itemsize;
+
+  template <typename Callback>
+  void for_each_pixel(Callback const &callback) const {
+    size_t const line = this->tensor.width * this->itemsize;
+    for (int32_t y = 0; y != this->tensor.height; ++y) {
+      uint8_t *staged = this->staging.get() + y * line;
+      uint8_t *pixel = this->data + y * this->row_stride;
+      for (int32_t x = 0; x != this->tensor.width; ++x) {
+        callback(staged, pixel);
+        staged += this->itemsize;
+        pixel += this->column_stride;
+      }
+    }
+  }
+
+ public:
+  enum class Load { Yes, No };
+  adrt::Tensor2D tensor;
+
+  template <typename Array>
+  ImageView(Array &image, Load load)
+      : data{(uint8_t *)image.data()},
+        row_stride{image.stride(0) * static_cast<int64_t>(image.itemsize())},
+        column_stride{image.stride(1) *
+                      static_cast<int64_t>(image.itemsize())},
+        itemsize{image.itemsize()},
+        tensor{/* height = */ static_cast<int32_t>(image.shape(0)),
+               /* width = */ static_cast<int32_t>(image.shape(1)),
+               /* stride = */
+               static_cast<adrt::Tensor2D::stride_t>(this->row_stride),
+               /* data = */ this->data} {
+    if (image.shape(1) <= 1 || image.stride(1) == 1) {
+      return;
+    }
+    size_t const line = this->tensor.width * this->itemsize;
+    this->staging.reset(new uint8_t[line * this->tensor.height]);
+    this->tensor.stride = static_cast<adrt::Tensor2D::stride_t>(line);
+    this->tensor.data = this->staging.get();
+    if (load == Load::Yes) {
+      size_t const itemsize = this->itemsize;
+      this->for_each_pixel([itemsize](uint8_t *staged, uint8_t *pixel) {
+        std::memcpy(staged, pixel, itemsize);
+      });
+    }
+  }
+
+  void store() const {
+    if (!this->staging) {
+      return;
+    }
+    size_t const itemsize = this->itemsize;
+    this->for_each_pixel([itemsize](uint8_t *staged, uint8_t *pixel) {
+      std::memcpy(pixel, staged, itemsize);
+    });
+  }
+};
+
+template <typename Scalar>
+static auto new_image(size_t height, size_t width) {
+  Scalar *data = new Scalar[height * width];
+  // Delete 'data' when the 'owner' capsule expires
+  nb::capsule owner(data, [](void *p) noexcept { delete[] (Scalar *)p; });
+  return nb::ndarray<nb::numpy, Scalar, nb::ndim<2>>(
+      /* data = */ data,
+      /* shape = */ {height, width},
+      /* owner = */ owner);
+}
+
+static auto new_swaps(size_t height) {
+  int *swaps = new int[height];
+  nb::capsule owner(swaps, [](void *p) noexcept { delete[] (int *)p; });
+  return nb::ndarray<nb::numpy, int, nb::ndim<1>, nb::device::cpu>(
+      /* data = */ swaps,
+      /* shape = */ {height},
+      /* owner = */ owner);
+}
+
+// Calls `callback(Scalar{})` for the scalar type of `dtype`
+template <typename Callback>
+static auto visit_dtype(nb::dlpack::dtype dtype, Callback &&callback) {
+  if (dtype == nb::dtype<float>()) {
+    return callback(float{});
+  } else if (dtype == nb::dtype<double>()) {
+    return callback(double{});
+  } else if (dtype == nb::dtype<int32_t>()) {
+    return callback(int32_t{});
+  } else if (dtype == nb::dtype<uint32_t>()) {
+    return callback(uint32_t{});
+  } else if (dtype == nb::dtype<int64_t>()) {
+    return callback(int64_t{});
+  } else if (dtype == nb::dtype<uint64_t>()) {
+    return callback(uint64_t{});
+  } else {
+    throw nb::type_error("unimplemented type");
+  }
+}
+
 enum class Recursive { Yes, No };
 enum class Algorithm { DS, DT };
 
@@ -27,16 +150,19 @@ template <typename Scalar>
 static auto py_ids_visit(adrt::Tensor2D const &tensor, adrt::Sign sign,
                          Recursive recursive) {
   std::unique_ptr<int[]> swaps;
-  if (recursive == Recursive::Yes) {
-    auto ids_recursive =
-        adrt::ids_recursive<Scalar>::create(tensor.as<Scalar>());
-    ids_recursive(tensor.as<Scalar>(), sign);
-    swaps = std::move(ids_recursive.swaps);
-  } else {
-    auto ids_non_recursive =
-        adrt::ids_non_recursive<Scalar>::create(tensor.as<Scalar>());
-    ids_non_recursive(tensor.as<Scalar>(), sign);
-    swaps = std::move(ids_non_recursive.swaps);
+  {
+    nb::gil_scoped_release release;
+    if (recursive == Recursive::Yes) {
+      auto ids_recursive =
+          adrt::ids_recursive<Scalar>::create(tensor.as<Scalar>());
+      ids_recursive(tensor.as<Scalar>(), sign);
+      swaps = std::move(ids_recursive.swaps);
+    } else {
+      auto ids_non_recursive =
+          adrt::ids_non_recursive<Scalar>::create(tensor.as<Scalar>());
+      ids_non_recursive(tensor.as<Scalar>(), sign);
+      swaps = std::move(ids_non_recursive.swaps);
+    }
   }
   nb::capsule swaps_owner(swaps.get(),
                           [](void *p) noexcept { delete[] (int *)p; });
@@ -48,48 +174,31 @@ static auto py_ids_visit(adrt::Tensor2D const &tensor, adrt::Sign sign,
 }
 
 auto py_ids(Image2D &image, adrt::Sign sign, Recursive recursive) {
-  auto const height = image.shape(0);
-  auto const width = image.shape(1);
-  auto const &dtype = image.dtype();
-  auto const itemsize = image.itemsize();
-
-  adrt::Tensor2D const tensor{
-      /*height = */ static_cast<int>(height),
-      /*width = */ static_cast<int>(width),
-      /*stride = */ static_cast<adrt::Tensor2D::stride_t>(width * itemsize),
-      /*data = */ reinterpret_cast<uint8_t *>(image.data())};
-
-  if (dtype == nb::dtype<float>()) {
-    return py_ids_visit<float>(tensor, sign, recursive);
-  } else if (dtype == nb::dtype<double>()) {
-    return py_ids_visit<double>(tensor, sign, recursive);
-  } else if (dtype == nb::dtype<int32_t>()) {
-    return py_ids_visit<int32_t>(tensor, sign, recursive);
-  } else if (dtype == nb::dtype<uint32_t>()) {
-    return py_ids_visit<uint32_t>(tensor, sign, recursive);
-  } else if (dtype == nb::dtype<int64_t>()) {
-    return py_ids_visit<int64_t>(tensor, sign, recursive);
-  } else if (dtype == nb::dtype<uint64_t>()) {
-    return py_ids_visit<uint64_t>(tensor, sign, recursive);
-  } else {
-    throw nb::type_error("unimplemented type");
-  }
+  ImageView const view{image, ImageView::Load::Yes};
+  auto swaps = visit_dtype(image.dtype(), [&](auto scalar) {
+    return py_ids_visit<decltype(scalar)>(view.tensor, sign, recursive);
+  });
+  view.store();
+  return swaps;
 }
 
 template <typename Scalar>
 static auto py_idt_visit(adrt::Tensor2D const &tensor, adrt::Sign sign,
                          Recursive recursive) {
   std::unique_ptr<int[]> swaps;
-  if (recursive == Recursive::Yes) {
-    auto idt_recursive =
-        adrt::idt_recursive<Scalar>::create(tensor.as<Scalar>());
-    idt_recursive(tensor.as<Scalar>(), sign);
-    swaps = std::move(idt_recursive.swaps);
-  } else {
-    auto idt_non_recursive =
-        adrt::idt_non_recursive<Scalar>::create(tensor.as<Scalar>());
-    idt_non_recursive(tensor.as<Scalar>(), sign);
-    swaps = std::move(idt_non_recursive.swaps);
+  {
+    nb::gil_scoped_release release;
+    if (recursive == Recursive::Yes) {
+      auto idt_recursive =
+          adrt::idt_recursive<Scalar>::create(tensor.as<Scalar>());
+      idt_recursive(tensor.as<Scalar>(), sign);
+      swaps = std::move(idt_recursive.swaps);
+    } else {
+      auto idt_non_recursive =
+          adrt::idt_non_recursive<Scalar>::create(tensor.as<Scalar>());
+      idt_non_recursive(tensor.as<Scalar>(), sign);
+      swaps = std::move(idt_non_recursive.swaps);
+    }
   }
   nb::capsule swaps_owner(swaps.get(),
                           [](void *p) noexcept { delete[] (int *)p; });
@@ -101,93 +210,958 @@ static auto py_idt_visit(adrt::Tensor2D const &tensor, adrt::Sign sign,
 }
 
 auto py_idt(Image2D &image, adrt::Sign sign, Recursive recursive) {
-  size_t const height = image.shape(0);
-  size_t const width = image.shape(1);
-  auto const dtype = image.dtype();
-  auto const itemsize = image.itemsize();
-
-  adrt::Tensor2D const tensor{
-      /* height = */ static_cast<int>(height),
-      /* width = */ static_cast<int>(width),
-      /* stride = */ static_cast<adrt::Tensor2D::stride_t>(width * itemsize),
-      /* data = */ reinterpret_cast<uint8_t *>(image.data())};
+  ImageView const view{image, ImageView::Load::Yes};
+  auto swaps = visit_dtype(image.dtype(), [&](auto scalar) {
+    return py_idt_visit<decltype(scalar)>(view.tensor, sign, recursive);
+  });
+  view.store();
+  return swaps;
+}
 
-  if (dtype == nb::dtype<float>()) {
-    return py_idt_visit<float>(tensor, sign, recursive);
-  } else if (dtype == nb::dtype<double>()) {
-    return py_idt_visit<double>(tensor, sign, recursive);
-  } else if (dtype == nb::dtype<int32_t>()) {
-    return py_idt_visit<int32_t>(tensor, sign, recursive);
-  } else if (dtype == nb::dtype<uint32_t>()) {
-    return py_idt_visit<uint32_t>(tensor, sign, recursive);
-  } else if (dtype == nb::dtype<int64_t>()) {
-    return py_idt_visit<int64_t>(tensor, sign, recursive);
-  } else if (dtype == nb::dtype<uint64_t>()) {
-    return py_idt_visit<uint64_t>(tensor, sign, recursive);
-  } else {
-    throw nb::type_error("unimplemented type");
+// Pool of `threads` threads counting the caller, of every hardware thread
+// for 0 and none for 1, when transforms run serially
+static std::unique_ptr<adrt::ThreadPool> new_pool(int threads) {
+  if (threads < 0) {
+    throw nb::value_error("`threads` must be non-negative");
   }
+  if (threads == 1) {
+    return nullptr;
+  }
+  return std::make_unique<adrt::ThreadPool>(
+      threads == 0 ? adrt::ThreadPool::default_workers()
+                   : static_cast<unsigned>(threads - 1));
 }
 
-template <typename Scalar>
-static auto py_d_visit(adrt::Tensor2D const &src, adrt::Sign sign,
-                       Recursive recursive, Algorithm algorithm) {
-  size_t const height = static_cast<size_t>(src.height);
-  size_t const width = static_cast<size_t>(src.width);
-  Scalar *data = new Scalar[height * width];
-
-  // Delete 'data' when the 'owner' capsule expires
-  nb::capsule owner(data, [](void *p) noexcept { delete[] (Scalar *)p; });
-  adrt::Tensor2D dst = src;
-  dst.data = reinterpret_cast<uint8_t *>(data);
-
-  auto idt_core = adrt::d<Scalar>::create(src.as<Scalar>());
+// Serial without `pool`
+template <typename Scalar, typename Input = Scalar>
+static void run_d(adrt::d<Scalar> const &d, adrt::Tensor2D const &dst,
+                  adrt::Tensor2D const &src, adrt::Sign sign,
+                  Recursive recursive, Algorithm algorithm,
+                  adrt::ThreadPool *pool = nullptr) {
+  if (pool != nullptr) {
+    adrt::Parallel const parallel{*pool};
+    if (algorithm == Algorithm::DS) {
+      if (recursive == Recursive::Yes) {
+        d.ds_recursive(dst.as<Scalar>(), src.as<Input>(), sign, parallel);
+      } else {
+        d.ds_non_recursive(dst.as<Scalar>(), src.as<Input>(), sign, parallel);
+      }
+    } else {
+      if (recursive == Recursive::Yes) {
+        d.dt_recursive(dst.as<Scalar>(), src.as<Input>(), sign, parallel);
+      } else {
+        d.dt_non_recursive(dst.as<Scalar>(), src.as<Input>(), sign, parallel);
+      }
+    }
+    return;
+  }
   if (algorithm == Algorithm::DS) {
     if (recursive == Recursive::Yes) {
-      idt_core.ds_recursive(dst.as<Scalar>(), src.as<Scalar>(), sign);
+      d.ds_recursive(dst.as<Scalar>(), src.as<Input>(), sign);
     } else {
-      idt_core.ds_non_recursive(dst.as<Scalar>(), src.as<Scalar>(), sign);
+      d.ds_non_recursive(dst.as<Scalar>(), src.as<Input>(), sign);
     }
   } else {
     if (recursive == Recursive::Yes) {
-      idt_core.dt_recursive(dst.as<Scalar>(), src.as<Scalar>(), sign);
+      d.dt_recursive(dst.as<Scalar>(), src.as<Input>(), sign);
     } else {
-      idt_core.dt_non_recursive(dst.as<Scalar>(), src.as<Scalar>(), sign);
+      d.dt_non_recursive(dst.as<Scalar>(), src.as<Input>(), sign);
     }
   }
-  return nb::cast(nb::ndarray<nb::numpy, Scalar, nb::ndim<2>>(
-      /* data = */ data,
-      /* shape = */ {height, width},
-      /* owner = */ owner));
 }
 
-auto py_d(Image2D &image, adrt::Sign sign, Recursive recursive,
-          Algorithm algorithm) {
+// `callback(Input{}, int32_t{})` when a sum of `height` pixels fits, with
+// `int64_t` otherwise
+template <typename Input, typename Callback>
+static auto visit_integer_accum(size_t height, Callback &&callback) {
+  using limits = std::numeric_limits<Input>;
+  uint64_t const max_abs = std::max<uint64_t>(
+      limits::max(), -static_cast<int64_t>(limits::min()));
+  if (height * max_abs <= static_cast<uint64_t>(INT32_MAX)) {
+    return callback(Input{}, int32_t{});
+  }
+  return callback(Input{}, int64_t{});
+}
+
+//
+// Calls `callback(Input{}, Accum{})` for the pixel type of `dtype` and the
+// type the transform sums in. Every output pixel is a sum of `height`
+// pixels: types of `visit_dtype` are their own accumulators, narrow types
+// are widened to one that cannot overflow.
+//
+template <typename Callback>
+static auto visit_input_dtype(nb::dlpack::dtype dtype, size_t height,
+                              Callback &&callback) {
+  using Code = nb::dlpack::dtype_code;
+  if (dtype == nb::dtype<uint8_t>()) {
+    return visit_integer_accum<uint8_t>(height, callback);
+  } else if (dtype == nb::dtype<uint16_t>()) {
+    return visit_integer_accum<uint16_t>(height, callback);
+  } else if (dtype == nb::dtype<int16_t>()) {
+    return visit_integer_accum<int16_t>(height, callback);
+  } else if (dtype.code == static_cast<uint8_t>(Code::Float) &&
+             dtype.bits == 16 && dtype.lanes == 1) {
+    return callback(adrt::half{}, float{});
+  } else if (dtype.code == static_cast<uint8_t>(Code::Bfloat) &&
+             dtype.bits == 16 && dtype.lanes == 1) {
+    return callback(adrt::bfloat16{}, float{});
+  }
+  return visit_dtype(dtype,
+                     [&](auto scalar) { return callback(scalar, scalar); });
+}
+
+// Bytes [begin, end) that the elements of `array` span, its strides may be
+// negative
+template <typename Array>
+static std::pair<uintptr_t, uintptr_t> byte_range(Array const &array) {
+  auto const itemsize = static_cast<int64_t>(array.itemsize());
+  uintptr_t begin = reinterpret_cast<uintptr_t>(array.data());
+  uintptr_t end = begin + static_cast<uintptr_t>(itemsize);
+  for (size_t axis = 0; axis != array.ndim(); ++axis) {
+    int64_t const offset = static_cast<int64_t>(array.shape(axis) - 1) *
+                           array.stride(axis) * itemsize;
+    (offset < 0 ? begin : end) += offset;
+  }
+  return {begin, end};
+}
+
+// Whether the bytes spanned by `a` and `b` intersect. Shifted or strided
+// views of one buffer count, as transforms read `src` after writing `dst`.
+template <typename ArrayA, typename ArrayB>
+static bool overlap(ArrayA const &a, ArrayB const &b) {
+  if (a.size() == 0 || b.size() == 0) {
+    return false;
+  }
+  auto const a_range = byte_range(a);
+  auto const b_range = byte_range(b);
+  return a_range.first < b_range.second && b_range.first < a_range.second;
+}
+
+// Returns `out` when given, a new array of `dtype` otherwise
+static nb::object prepare_out(ConstImage2D &image, nb::object out,
+                              Image2D &out_array, nb::dlpack::dtype dtype) {
+  if (out.is_none()) {
+    out = visit_dtype(dtype, [&](auto scalar) {
+      return nb::cast(
+          new_image<decltype(scalar)>(image.shape(0), image.shape(1)));
+    });
+  }
+  out_array = nb::cast<Image2D>(out);
+  if (out_array.dtype() != dtype || out_array.shape(0) != image.shape(0) ||
+      out_array.shape(1) != image.shape(1)) {
+    throw nb::value_error("`out` must have the shape and dtype of the output");
+  }
+  if (overlap(out_array, image)) {
+    throw nb::value_error("`out` must not overlap `image`");
+  }
+  return out;
+}
+
+static nb::object prepare_out(ConstImage2D &image, nb::object out,
+                              Image2D &out_array) {
+  return prepare_out(image, std::move(out), out_array, image.dtype());
+}
+
+// Narrow inputs (uint8, uint16, int16, float16, bfloat16) are transformed
+// without a widened copy, the output has the accumulator dtype
+nb::object py_d(ConstImage2D &image, adrt::Sign sign, Recursive recursive,
+                Algorithm algorithm, nb::object out, int threads) {
+  size_t const height = image.shape(0);
+  auto const pool = new_pool(threads);
+  nb::dlpack::dtype const out_dtype = visit_input_dtype(
+      image.dtype(), height,
+      [](auto, auto accum) { return nb::dtype<decltype(accum)>(); });
+  Image2D out_array;
+  out = prepare_out(image, std::move(out), out_array, out_dtype);
+  ImageView const src{image, ImageView::Load::Yes};
+  ImageView const dst{out_array, ImageView::Load::No};
+  visit_input_dtype(image.dtype(), height, [&](auto input, auto accum) {
+    using Input = decltype(input);
+    using Scalar = decltype(accum);
+    nb::gil_scoped_release release;
+    auto const d = adrt::d<Scalar>::create(dst.tensor.as<Scalar>());
+    run_d<Scalar, Input>(d, dst.tensor, src.tensor, sign, recursive,
+                         algorithm, pool.get());
+  });
+  dst.store();
+  return out;
+}
+
+// Swap tables returned by `ids_*` and `idt_*`
+using Swaps = nb::ndarray<nb::ro, int, nb::ndim<1>, nb::c_contig,
+                          nb::device::cpu>;
+
+// Transpose of `ds` or `dt`, or of `ids` or `idt` when `swaps` is given
+nb::object py_adjoint(ConstImage2D &image, adrt::Sign sign,
+                      Algorithm algorithm, std::optional<Swaps> swaps,
+                      nb::object out) {
+  int const *src_rows = nullptr;
+  if (swaps) {
+    if (swaps->shape(0) != image.shape(0)) {
+      throw nb::value_error("`swaps` must have an entry per image row");
+    }
+    src_rows = swaps->data();
+    for (size_t idx = 0; idx != swaps->shape(0); ++idx) {
+      if (src_rows[idx] < 0 ||
+          static_cast<size_t>(src_rows[idx]) >= image.shape(0)) {
+        throw nb::value_error("`swaps` entries must be image rows");
+      }
+    }
+  }
+  Image2D out_array;
+  out = prepare_out(image, std::move(out), out_array);
+  ImageView const src{image, ImageView::Load::Yes};
+  ImageView const dst{out_array, ImageView::Load::No};
+  visit_dtype(image.dtype(), [&](auto scalar) {
+    using Scalar = decltype(scalar);
+    nb::gil_scoped_release release;
+    auto const d = adrt::d<Scalar>::create(src.tensor.as<Scalar>());
+    if (algorithm == Algorithm::DS) {
+      d.ds_adjoint(dst.tensor.as<Scalar>(), src.tensor.as<Scalar>(), sign,
+                   src_rows);
+    } else {
+      d.dt_adjoint(dst.tensor.as<Scalar>(), src.tensor.as<Scalar>(), sign,
+                   src_rows);
+    }
+  });
+  dst.store();
+  return out;
+}
+
+// Rows `ts` of `ds` or `dt`, only the rows feeding them are merged
+nb::object py_pruned(ConstImage2D &image, std::vector<int> const &ts,
+                     adrt::Sign sign, Algorithm algorithm) {
   size_t const height = image.shape(0);
   size_t const width = image.shape(1);
-  auto const dtype = image.dtype();
-  auto const itemsize = image.itemsize();
-
-  adrt::Tensor2D const tensor{
-      /* height = */ static_cast<int>(height),
-      /* width = */ static_cast<int>(width),
-      /* stride = */ static_cast<adrt::Tensor2D::stride_t>(width * itemsize),
-      /* data = */ reinterpret_cast<uint8_t *>(image.data())};
-  if (dtype == nb::dtype<float>()) {
-    return py_d_visit<float>(tensor, sign, recursive, algorithm);
-  } else if (dtype == nb::dtype<double>()) {
-    return py_d_visit<double>(tensor, sign, recursive, algorithm);
-  } else if (dtype == nb::dtype<int32_t>()) {
-    return py_d_visit<int32_t>(tensor, sign, recursive, algorithm);
-  } else if (dtype == nb::dtype<uint32_t>()) {
-    return py_d_visit<uint32_t>(tensor, sign, recursive, algorithm);
-  } else if (dtype == nb::dtype<int64_t>()) {
-    return py_d_visit<int64_t>(tensor, sign, recursive, algorithm);
-  } else if (dtype == nb::dtype<uint64_t>()) {
-    return py_d_visit<uint64_t>(tensor, sign, recursive, algorithm);
-  } else {
-    throw nb::type_error("unimplemented type");
+  for (int t : ts) {
+    if (t < 0 || static_cast<size_t>(t) >= height) {
+      throw nb::value_error("`ts` entries must be image rows");
+    }
+  }
+  ImageView const src{image, ImageView::Load::Yes};
+  return visit_input_dtype(image.dtype(), height, [&](auto input,
+                                                      auto accum) {
+    using Input = decltype(input);
+    using Scalar = decltype(accum);
+    auto out = new_image<Scalar>(ts.size(), width);
+    adrt::Tensor2D const dst{
+        static_cast<int32_t>(ts.size()), static_cast<int32_t>(width),
+        static_cast<adrt::Tensor2D::stride_t>(width * sizeof(Scalar)),
+        reinterpret_cast<uint8_t *>(out.data())};
+    adrt::Tensor2D const prototype{
+        static_cast<int32_t>(height), static_cast<int32_t>(width),
+        static_cast<adrt::Tensor2D::stride_t>(width * sizeof(Scalar)),
+        nullptr};
+    {
+      nb::gil_scoped_release release;
+      auto const pruned =
+          algorithm == Algorithm::DS
+              ? adrt::d_pruned<Scalar>::create(prototype.as<Scalar>(), ts,
+                                               adrt::ds_mid)
+              : adrt::d_pruned<Scalar>::create(prototype.as<Scalar>(), ts,
+                                               adrt::dt_mid);
+      pruned(dst.as<Scalar>(), src.tensor.as<Input>(), sign);
+    }
+    return nb::cast(out);
+  });
+}
+
+// Columns [column_begin, column_end) of `ds` or `dt`, `out` may be a view
+// of columns of a larger array
+nb::object py_roi(ConstImage2D &image, int column_begin, int column_end,
+                  adrt::Sign sign, Algorithm algorithm, nb::object out) {
+  size_t const height = image.shape(0);
+  if (column_begin < 0 || column_begin >= column_end ||
+      static_cast<size_t>(column_end) > image.shape(1)) {
+    throw nb::value_error("columns must be a non-empty range of the image");
+  }
+  size_t const columns = static_cast<size_t>(column_end - column_begin);
+  if (out.is_none()) {
+    out = visit_dtype(image.dtype(), [&](auto scalar) {
+      return nb::cast(new_image<decltype(scalar)>(height, columns));
+    });
+  }
+  Image2D out_array = nb::cast<Image2D>(out);
+  if (out_array.dtype() != image.dtype() || out_array.shape(0) != height ||
+      out_array.shape(1) != columns) {
+    throw nb::value_error("`out` must have the shape and dtype of the output");
+  }
+  if (overlap(out_array, image)) {
+    throw nb::value_error("`out` must not overlap `image`");
+  }
+  ImageView const src{image, ImageView::Load::Yes};
+  ImageView const dst{out_array, ImageView::Load::No};
+  visit_dtype(image.dtype(), [&](auto scalar) {
+    using Scalar = decltype(scalar);
+    nb::gil_scoped_release release;
+    auto const roi =
+        algorithm == Algorithm::DS
+            ? adrt::d_roi<Scalar>::create(src.tensor.as<Scalar>(),
+                                          column_begin, column_end,
+                                          adrt::ds_mid)
+            : adrt::d_roi<Scalar>::create(src.tensor.as<Scalar>(),
+                                          column_begin, column_end,
+                                          adrt::dt_mid);
+    roi(dst.tensor.as<Scalar>(), src.tensor.as<Scalar>(), sign);
+  });
+  dst.store();
+  return out;
+}
+
+static adrt::ThreadPool &batch_pool() {
+  static adrt::ThreadPool pool;
+  return pool;
+}
+
+// `k` strongest cells of `ds` or `dt` as (ts, shifts, values), strongest
+// first, without the transform image
+nb::object py_top_k(ConstImage2D &image, size_t k, adrt::Sign sign,
+                    int radius, Algorithm algorithm) {
+  if (radius < 0) {
+    throw nb::value_error("`radius` must be non-negative");
+  }
+  size_t const height = image.shape(0);
+  ImageView const src{image, ImageView::Load::Yes};
+  return visit_input_dtype(image.dtype(), height, [&](auto input,
+                                                      auto accum) {
+    using Input = decltype(input);
+    using Scalar = decltype(accum);
+    std::vector<adrt::HoughPeak<Scalar>> peaks;
+    {
+      nb::gil_scoped_release release;
+      adrt::Tensor2D const prototype{
+          src.tensor.height, src.tensor.width,
+          static_cast<adrt::Tensor2D::stride_t>(src.tensor.width *
+                                                sizeof(Scalar)),
+          nullptr};
+      auto const d = adrt::d<Scalar>::create(prototype.as<Scalar>());
+      adrt::Parallel const parallel{batch_pool()};
+      adrt::Tensor2D scratch{prototype};
+      scratch.height = algorithm == Algorithm::DS ? d.ds_top_k_rows(radius)
+                                                  : d.dt_top_k_rows(radius);
+      std::unique_ptr<Scalar[]> scratch_data{
+          new Scalar[static_cast<size_t>(scratch.height) * scratch.width]};
+      scratch.data = reinterpret_cast<uint8_t *>(scratch_data.get());
+      peaks = algorithm == Algorithm::DS
+                  ? d.ds_top_k(src.tensor.as<Input>(), scratch.as<Scalar>(),
+                               sign, k, radius, parallel)
+                  : d.dt_top_k(src.tensor.as<Input>(), scratch.as<Scalar>(),
+                               sign, k, radius, parallel);
+    }
+    auto ts = new_swaps(peaks.size());
+    auto shifts = new_swaps(peaks.size());
+    Scalar *values = new Scalar[peaks.size()];
+    nb::capsule owner(values,
+                      [](void *p) noexcept { delete[] (Scalar *)p; });
+    for (size_t idx = 0; idx != peaks.size(); ++idx) {
+      ts.data()[idx] = peaks[idx].t;
+      shifts.data()[idx] = peaks[idx].x;
+      values[idx] = peaks[idx].value;
+    }
+    return nb::make_tuple(
+        ts, shifts,
+        nb::ndarray<nb::numpy, Scalar, nb::ndim<1>, nb::device::cpu>(
+            values, {peaks.size()}, owner));
+  });
+}
+
+// `fht2rdbu` or `fht2rubd`, the resize needs a floating point image
+nb::object py_resample(ConstImage2D &image, adrt::Sign sign,
+                       adrt::HeightRound round) {
+  if (image.dtype() != nb::dtype<float>() &&
+      image.dtype() != nb::dtype<double>()) {
+    throw nb::type_error("resampling needs a float32 or float64 image");
+  }
+  Image2D out_array;
+  nb::object out = prepare_out(image, nb::none(), out_array);
+  ImageView const src{image, ImageView::Load::Yes};
+  ImageView const dst{out_array, ImageView::Load::No};
+  visit_dtype(image.dtype(), [&](auto scalar) {
+    using Scalar = decltype(scalar);
+    if constexpr (std::is_floating_point_v<Scalar>) {
+      nb::gil_scoped_release release;
+      adrt::resample<Scalar>::create(src.tensor.as<Scalar>(), round)(
+          dst.tensor.as<Scalar>(), src.tensor.as<Scalar>(), sign);
+    }
+  });
+  dst.store();
+  return out;
+}
+
+using Images3D = nb::ndarray<nb::ndim<3>, nb::device::cpu>;
+using ConstImages3D = nb::ndarray<nb::ro, nb::ndim<3>, nb::device::cpu>;
+
+// Unlike `ImageView` there is no staging, pixels of a row must be adjacent
+template <typename Array>
+static adrt::Tensor3D images_to_tensor(Array &images) {
+  if (images.shape(2) > 1 && images.stride(2) != 1) {
+    throw nb::value_error("pixels of image rows must be adjacent");
+  }
+  auto const itemsize = static_cast<int64_t>(images.itemsize());
+  return adrt::Tensor3D{
+      /* batch = */ static_cast<int32_t>(images.shape(0)),
+      /* height = */ static_cast<int32_t>(images.shape(1)),
+      /* width = */ static_cast<int32_t>(images.shape(2)),
+      /* batch_stride = */ images.stride(0) * itemsize,
+      /* stride = */
+      static_cast<adrt::Tensor2D::stride_t>(images.stride(1) * itemsize),
+      /* data = */ (uint8_t *)images.data()};
+}
+
+// Tensors of `images` and `out`, which are either the same images or
+// images that don't share memory
+static std::pair<adrt::Tensor3D, adrt::Tensor3D> batch_tensors(
+    ConstImages3D &images, Images3D &out) {
+  if (out.dtype() != images.dtype()) {
+    throw nb::type_error("`out` must have the dtype of `images`");
+  }
+  adrt::Tensor3D const src{images_to_tensor(images)};
+  adrt::Tensor3D const dst{images_to_tensor(out)};
+  if (!dst.same_shape(src)) {
+    throw nb::value_error("`out` must have the shape of `images`");
+  }
+  bool const same = dst.data == src.data &&
+                    dst.batch_stride == src.batch_stride &&
+                    dst.stride == src.stride;
+  if (!same && overlap(images, out)) {
+    throw nb::value_error("`out` must be `images` or not overlap it");
+  }
+  return {src, dst};
+}
+
+// (batch, height) swaps of batched in-place transforms
+static auto new_batch_swaps(size_t batch, size_t height) {
+  int *swaps = new int[batch * height];
+  nb::capsule owner(swaps, [](void *p) noexcept { delete[] (int *)p; });
+  return nb::ndarray<nb::numpy, int, nb::ndim<2>, nb::device::cpu>(
+      /* data = */ swaps,
+      /* shape = */ {batch, height},
+      /* owner = */ owner);
+}
+
+// Returns the (2, h, w) quadrants of the image and the (2, w, h) ones of its
+// transpose, and 2 * (h + w) swaps for `IDS` and `IDT`, see
+// `adrt::fht2_full` for the layout
+nb::object py_full(ConstImage2D &image, adrt::FullTransform transform) {
+  size_t const height = image.shape(0);
+  size_t const width = image.shape(1);
+  ImageView const src{image, ImageView::Load::Yes};
+  return visit_dtype(image.dtype(), [&](auto scalar) -> nb::object {
+    using Scalar = decltype(scalar);
+    size_t const area = height * width;
+    auto const new_quadrants = [&](size_t rows, size_t columns) {
+      Scalar *data = new Scalar[2 * area];
+      nb::capsule owner(data, [](void *p) noexcept { delete[] (Scalar *)p; });
+      adrt::Tensor3D const tensor{
+          2,
+          static_cast<int32_t>(rows),
+          static_cast<int32_t>(columns),
+          static_cast<int64_t>(area * sizeof(Scalar)),
+          static_cast<adrt::Tensor2D::stride_t>(columns * sizeof(Scalar)),
+          reinterpret_cast<uint8_t *>(data)};
+      return std::make_pair(
+          nb::ndarray<nb::numpy, Scalar, nb::ndim<3>>(
+              /* data = */ data,
+              /* shape = */ {2, rows, columns},
+              /* owner = */ owner),
+          tensor);
+    };
+    auto const out = new_quadrants(height, width);
+    auto const out_T = new_quadrants(width, height);
+    auto swaps = new_swaps(2 * (height + width));
+    {
+      nb::gil_scoped_release release;
+      auto const full = adrt::fht2_full<Scalar>::create(
+          transform, static_cast<int>(height), static_cast<int>(width));
+      full(out.second, out_T.second, src.tensor.as<Scalar>(), swaps.data(),
+           &batch_pool());
+    }
+    if (transform == adrt::FullTransform::DS ||
+        transform == adrt::FullTransform::DT) {
+      return nb::make_tuple(out.first, out_T.first);
+    }
+    return nb::make_tuple(out.first, out_T.first, swaps);
+  });
+}
+
+template <template <typename> class Transform>
+using ByDtype = std::variant<Transform<float>, Transform<double>,
+                             Transform<int32_t>, Transform<uint32_t>,
+                             Transform<int64_t>, Transform<uint64_t>>;
+
+template <typename Transform>
+struct scalar_of;
+template <template <typename> class Transform, typename Scalar>
+struct scalar_of<Transform<Scalar>> {
+  using type = Scalar;
+};
+
+//
+// Transform objects created once for the shape and dtype of `prototype`.
+// Calls release the GIL, so different plans may run in parallel from Python
+// threads. Calls to one plan are serialized, as its buffers are shared.
+//
+class PlanBase {
+ protected:
+  nb::dlpack::dtype dtype;
+  size_t height;
+  size_t width;
+  std::mutex mutex;
+
+  PlanBase(nb::dlpack::dtype dtype, size_t height, size_t width)
+      : dtype{dtype}, height{height}, width{width} {}
+
+  explicit PlanBase(ConstImage2D &prototype)
+      : PlanBase{prototype.dtype(), prototype.shape(0), prototype.shape(1)} {}
+
+  template <typename Array>
+  void check(Array &image) const {
+    if (image.dtype() != this->dtype || image.shape(0) != this->height ||
+        image.shape(1) != this->width) {
+      throw nb::value_error("image must have the shape and dtype of the plan");
+    }
+  }
+
+  // images of a batch of any size
+  template <typename Array>
+  void check_images(Array &images) const {
+    if (images.dtype() != this->dtype || images.shape(1) != this->height ||
+        images.shape(2) != this->width) {
+      throw nb::value_error(
+          "images must have the shape and dtype of the plan");
+    }
+  }
+};
+
+class DPlan : PlanBase {
+  std::unique_ptr<adrt::ThreadPool> pool;
+  ByDtype<adrt::d> d;
+
+ public:
+  // `threads` as in `new_pool`, the pool is kept between calls
+  DPlan(ConstImage2D &prototype, int threads)
+      : PlanBase{prototype},
+        pool{new_pool(threads)},
+        d{visit_dtype(prototype.dtype(), [&](auto scalar) {
+          using Scalar = decltype(scalar);
+          adrt::Tensor2D const tensor{
+              static_cast<int32_t>(this->height),
+              static_cast<int32_t>(this->width),
+              static_cast<adrt::Tensor2D::stride_t>(this->width *
+                                                    sizeof(Scalar)),
+              nullptr};
+          return ByDtype<adrt::d>{adrt::d<Scalar>::create(tensor.as<Scalar>())};
+        })} {}
+
+  nb::object operator()(ConstImage2D &image, adrt::Sign sign,
+                        Algorithm algorithm, nb::object out) {
+    this->check(image);
+    Image2D out_array;
+    out = prepare_out(image, std::move(out), out_array);
+    ImageView const src_view{image, ImageView::Load::Yes};
+    ImageView const dst_view{out_array, ImageView::Load::No};
+    adrt::Tensor2D const &src = src_view.tensor;
+    adrt::Tensor2D const &dst = dst_view.tensor;
+    {
+      nb::gil_scoped_release release;
+      std::lock_guard<std::mutex> lock{this->mutex};
+      std::visit(
+          [&](auto const &d) {
+            using Scalar = typename scalar_of<std::decay_t<decltype(d)>>::type;
+            run_d<Scalar>(d, dst, src, sign, Recursive::No, algorithm,
+                          this->pool.get());
+          },
+          this->d);
+    }
+    dst_view.store();
+    return out;
+  }
+};
+
+// `ids_non_recursive` and compiled `idt_non_recursive`, transforms `image`
+// in place and returns swaps, in `swaps` when given
+template <template <typename> class Transform>
+class InplacePlan : PlanBase {
+  ByDtype<Transform> transform;
+
+  using Swaps = nb::ndarray<nb::numpy, int, nb::ndim<1>, nb::device::cpu,
+                            nb::c_contig>;
+
+ public:
+  template <typename... Args>
+  explicit InplacePlan(ConstImage2D &prototype, Args... args)
+      : PlanBase{prototype},
+        transform{visit_dtype(prototype.dtype(), [&](auto scalar) {
+          using Scalar = decltype(scalar);
+          adrt::Tensor2D const tensor{
+              static_cast<int32_t>(this->height),
+              static_cast<int32_t>(this->width),
+              static_cast<adrt::Tensor2D::stride_t>(this->width *
+                                                    sizeof(Scalar)),
+              nullptr};
+          return ByDtype<Transform>{
+              Transform<Scalar>::create(tensor.as<Scalar>(), args...)};
+        })} {}
+
+  nb::object operator()(Image2D &image, adrt::Sign sign, nb::object swaps) {
+    this->check(image);
+    if (swaps.is_none()) {
+      swaps = nb::cast(new_swaps(this->height));
+    }
+    Swaps swaps_array = nb::cast<Swaps>(swaps);
+    if (swaps_array.shape(0) != this->height) {
+      throw nb::value_error("`swaps` must have the height of the plan");
+    }
+    ImageView const view{image, ImageView::Load::Yes};
+    adrt::Tensor2D const &tensor = view.tensor;
+    {
+      nb::gil_scoped_release release;
+      std::lock_guard<std::mutex> lock{this->mutex};
+      std::visit(
+          [&](auto &transform) {
+            using Scalar =
+                typename scalar_of<std::decay_t<decltype(transform)>>::type;
+            transform(tensor.as<Scalar>(), sign);
+            std::copy(transform.swaps.get(),
+                      transform.swaps.get() + this->height,
+                      swaps_array.data());
+          },
+          this->transform);
+    }
+    view.store();
+    return swaps;
+  }
+};
+
+// `ds` or `dt` of frames that change in a few rows, see `d_incremental`
+class DIncremental : PlanBase {
+  ByDtype<adrt::d_incremental> transform;
+  adrt::IncrementalStats stats;
+
+ public:
+  DIncremental(ConstImage2D &prototype, adrt::Sign sign, Algorithm algorithm)
+      : PlanBase{prototype},
+        transform{visit_dtype(prototype.dtype(), [&](auto scalar) {
+          using Scalar = decltype(scalar);
+          adrt::Tensor2D const tensor{
+              static_cast<int32_t>(this->height),
+              static_cast<int32_t>(this->width),
+              static_cast<adrt::Tensor2D::stride_t>(this->width *
+                                                    sizeof(Scalar)),
+              nullptr};
+          if (algorithm == Algorithm::DS) {
+            return ByDtype<adrt::d_incremental>{
+                adrt::d_incremental<Scalar>::create(tensor.as<Scalar>(), sign,
+                                                    adrt::ds_mid)};
+          }
+          return ByDtype<adrt::d_incremental>{
+              adrt::d_incremental<Scalar>::create(tensor.as<Scalar>(), sign,
+                                                  adrt::dt_mid)};
+        })} {}
+
+  // `image` is the complete frame, `changed` are the [begin, end) row
+  // ranges that differ from the previous one, `None` recomputes everything
+  nb::object operator()(
+      ConstImage2D &image,
+      std::optional<std::vector<std::pair<int, int>>> const &changed,
+      nb::object out) {
+    this->check(image);
+    std::vector<adrt::Slice> slices;
+    if (changed) {
+      for (auto const &range : *changed) {
+        if (range.first < 0 || range.first >= range.second ||
+            static_cast<size_t>(range.second) > this->height) {
+          throw nb::value_error(
+              "`changed` ranges must be non-empty and inside the image");
+        }
+        slices.emplace_back(range.first, range.second);
+      }
+    }
+    Image2D out_array;
+    out = prepare_out(image, std::move(out), out_array);
+    ImageView const src_view{image, ImageView::Load::Yes};
+    ImageView const dst_view{out_array, ImageView::Load::No};
+    adrt::Tensor2D const &src = src_view.tensor;
+    adrt::Tensor2D const &dst = dst_view.tensor;
+    {
+      nb::gil_scoped_release release;
+      std::lock_guard<std::mutex> lock{this->mutex};
+      std::visit(
+          [&](auto &transform) {
+            using Scalar =
+                typename scalar_of<std::decay_t<decltype(transform)>>::type;
+            if (!changed) {
+              transform.reset();
+            }
+            this->stats =
+                transform(dst.as<Scalar>(), src.as<Scalar>(), slices);
+          },
+          this->transform);
+    }
+    dst_view.store();
+    return out;
+  }
+
+  int64_t merged_rows() {
+    std::lock_guard<std::mutex> lock{this->mutex};
+    return this->stats.merged_rows;
+  }
+
+  int64_t skipped_rows() {
+    std::lock_guard<std::mutex> lock{this->mutex};
+    return this->stats.skipped_rows;
+  }
+};
+
+using IDSPlan = InplacePlan<adrt::ids_non_recursive>;
+using IDTPlan = InplacePlan<adrt::idt_non_recursive>;
+
+//
+// Batched transforms of images like those of `prototype`, batches may be of
+// any size. Merge plans, schedules and the workspaces of threads are kept
+// between calls. `out` is either `images` or doesn't overlap it.
+//
+template <template <typename> class Transform>
+class BatchPlan : PlanBase {
+  ByDtype<Transform> transform;
+
+ public:
+  explicit BatchPlan(ConstImages3D &prototype)
+      : PlanBase{prototype.dtype(), prototype.shape(1), prototype.shape(2)},
+        transform{visit_dtype(prototype.dtype(), [&](auto scalar) {
+          using Scalar = decltype(scalar);
+          return ByDtype<Transform>{
+              Transform<Scalar>::create(static_cast<int>(this->height),
+                                        static_cast<int>(this->width))};
+        })} {}
+
+  // `d_batch`, returns nothing
+  nb::object operator()(ConstImages3D &images, Images3D &out,
+                        adrt::Sign sign, Algorithm algorithm) {
+    this->check_images(images);
+    auto const tensors = batch_tensors(images, out);
+    {
+      nb::gil_scoped_release release;
+      std::lock_guard<std::mutex> lock{this->mutex};
+      std::visit(
+          [&](auto const &d_batch) {
+            if (algorithm == Algorithm::DS) {
+              d_batch.ds(tensors.second, tensors.first, sign, batch_pool());
+            } else {
+              d_batch.dt(tensors.second, tensors.first, sign, batch_pool());
+            }
+          },
+          this->transform);
+    }
+    return nb::none();
+  }
+
+  // `ids_batch` or `idt_batch`, returns (batch, height) swaps
+  nb::object operator()(ConstImages3D &images, Images3D &out,
+                        adrt::Sign sign) {
+    this->check_images(images);
+    auto const tensors = batch_tensors(images, out);
+    auto swaps = new_batch_swaps(images.shape(0), this->height);
+    {
+      nb::gil_scoped_release release;
+      std::lock_guard<std::mutex> lock{this->mutex};
+      std::visit(
+          [&](auto const &transform) {
+            transform(tensors.second, tensors.first, sign, swaps.data(),
+                      batch_pool());
+          },
+          this->transform);
+    }
+    return nb::cast(swaps);
+  }
+};
+
+using DBatchPlan = BatchPlan<adrt::d_batch>;
+using IDSBatchPlan = BatchPlan<adrt::ids_batch>;
+using IDTBatchPlan = BatchPlan<adrt::idt_batch>;
+
+// `dt` of the last `height` rows pushed, `prototype` is the window
+class DTStream : PlanBase {
+  ByDtype<adrt::dt_stream> stream;
+
+ public:
+  DTStream(ConstImage2D &prototype, int block, adrt::Sign sign)
+      : PlanBase{prototype},
+        stream{visit_dtype(prototype.dtype(), [&](auto scalar) {
+          using Scalar = decltype(scalar);
+          if (block < 1 || (block & (block - 1)) != 0 ||
+              this->height % block != 0) {
+            throw nb::value_error(
+                "`block` must be a power of two dividing the height");
+          }
+          return ByDtype<adrt::dt_stream>{
+              adrt::dt_stream<Scalar>{static_cast<int>(this->height),
+                                      static_cast<int>(this->width), block,
+                                      sign}};
+        })} {}
+
+  void push(ConstImage2D &rows) {
+    size_t const block = std::visit(
+        [](auto const &stream) { return stream.block_height(); },
+        this->stream);
+    if (rows.dtype() != this->dtype || rows.shape(1) != this->width ||
+        rows.shape(0) % block != 0) {
+      throw nb::value_error(
+          "`rows` must be whole blocks with the width and dtype of the "
+          "stream");
+    }
+    ImageView const view{rows, ImageView::Load::Yes};
+    adrt::Tensor2D const &tensor = view.tensor;
+    nb::gil_scoped_release release;
+    std::lock_guard<std::mutex> lock{this->mutex};
+    std::visit(
+        [&](auto &stream) {
+          using Scalar =
+              typename scalar_of<std::decay_t<decltype(stream)>>::type;
+          stream.push(tensor.as<Scalar>());
+        },
+        this->stream);
+  }
+
+  bool ready() {
+    std::lock_guard<std::mutex> lock{this->mutex};
+    return std::visit([](auto const &stream) { return stream.ready(); },
+                      this->stream);
+  }
+
+  nb::object operator()(nb::object out) {
+    if (!this->ready()) {
+      throw nb::value_error("the window is not full yet");
+    }
+    if (out.is_none()) {
+      out = visit_dtype(this->dtype, [&](auto scalar) {
+        return nb::cast(
+            new_image<decltype(scalar)>(this->height, this->width));
+      });
+    }
+    Image2D out_array = nb::cast<Image2D>(out);
+    this->check(out_array);
+    ImageView const view{out_array, ImageView::Load::No};
+    adrt::Tensor2D const &dst = view.tensor;
+    {
+      nb::gil_scoped_release release;
+      std::lock_guard<std::mutex> lock{this->mutex};
+      std::visit(
+          [&](auto const &stream) {
+            using Scalar =
+                typename scalar_of<std::decay_t<decltype(stream)>>::type;
+            stream(dst.as<Scalar>());
+          },
+          this->stream);
+    }
+    view.store();
+    return out;
+  }
+};
+
+//
+// Transforms of images like `prototype` with `rows` output rows, the
+// height or min(height, width). Calls allocate the output and run
+// `run(transform, dst, src)` with the GIL released.
+//
+template <template <typename> class Transform>
+class TransformPlan : PlanBase {
+  size_t rows;
+  ByDtype<Transform> transform;
+
+ public:
+  template <typename... Args>
+  TransformPlan(ConstImage2D &prototype, size_t rows, Args... args)
+      : PlanBase{prototype},
+        rows{rows},
+        transform{visit_dtype(prototype.dtype(), [&](auto scalar) {
+          using Scalar = decltype(scalar);
+          adrt::Tensor2D const tensor{
+              static_cast<int32_t>(this->height),
+              static_cast<int32_t>(this->width),
+              static_cast<adrt::Tensor2D::stride_t>(this->width *
+                                                    sizeof(Scalar)),
+              nullptr};
+          return ByDtype<Transform>{
+              Transform<Scalar>::create(tensor.as<Scalar>(), args...)};
+        })} {}
+
+  template <typename Run>
+  nb::object operator()(ConstImage2D &image, Run const &run) {
+    this->check(image);
+    ImageView const src{image, ImageView::Load::Yes};
+    return std::visit(
+        [&](auto const &transform) {
+          using Scalar =
+              typename scalar_of<std::decay_t<decltype(transform)>>::type;
+          auto out = new_image<Scalar>(this->rows, this->width);
+          adrt::Tensor2D const dst{
+              static_cast<int32_t>(this->rows),
+              static_cast<int32_t>(this->width),
+              static_cast<adrt::Tensor2D::stride_t>(this->width *
+                                                    sizeof(Scalar)),
+              (uint8_t *)out.data()};
+          {
+            nb::gil_scoped_release release;
+            std::lock_guard<std::mutex> lock{this->mutex};
+            run(transform, dst.as<Scalar>(), src.tensor.as<Scalar>());
+          }
+          return nb::cast(out);
+        },
+        this->transform);
+  }
+};
+
+static size_t min_rows(ConstImage2D &image) {
+  return std::min(image.shape(0), image.shape(1));
+}
+
+using MPlan = TransformPlan<adrt::m>;
+using SPlan = TransformPlan<adrt::s>;
+using SPPlan = TransformPlan<adrt::sp>;
+using KhanipovPlan = TransformPlan<adrt::khanipov>;
+using ASD2Plan = TransformPlan<adrt::asd2>;
+
+nb::object py_m(MPlan &plan, ConstImage2D &image, adrt::Sign sign,
+                adrt::PatternRule rule) {
+  return plan(image, [&](auto const &m, auto const &dst, auto const &src) {
+    if (rule == adrt::PatternRule::MS) {
+      m.ms(dst, src, sign);
+    } else {
+      m.mt(dst, src, sign);
+    }
+  });
+}
+
+// `fht2ss` or `fht2st`, strips are transformed in parallel
+nb::object py_s(SPlan &plan, ConstImage2D &image, adrt::Sign sign,
+                adrt::StripRule rule) {
+  return plan(image, [&](auto const &s, auto const &dst, auto const &src) {
+    if (rule == adrt::StripRule::SS) {
+      s.ss(dst, src, sign, &batch_pool());
+    } else {
+      s.st(dst, src, sign, &batch_pool());
+    }
+  });
+}
+
+static SPPlan new_sp_plan(ConstImage2D &prototype, int hs, int ws, int ns) {
+  if (hs < 1 || ws < 1) {
+    throw nb::value_error("superpixel shape must be positive");
+  }
+  if (ns >= hs) {
+    throw nb::value_error("ns must be less than hs");
   }
+  return SPPlan{prototype, prototype.shape(0), hs, ws, ns};
+}
+
+// `sp`, `khanipov` and `asd2`, which are calls of the transform
+template <typename Plan>
+nb::object py_call(Plan &plan, ConstImage2D &image, adrt::Sign sign) {
+  return plan(image,
+              [&](auto const &transform, auto const &dst, auto const &src) {
+                transform(dst, src, sign);
+              });
 }
 
 NB_MODULE(_adrtlib, m) {
@@ -217,28 +1191,442 @@ NB_MODULE(_adrtlib, m) {
       nb::arg("image"), nb::arg("sign") = 1);
   m.def(
       "ds_recursive",
-      [](Image2D &image, int sign) {
-        return py_d(image, int_to_sign(sign), Recursive::Yes, Algorithm::DS);
+      [](ConstImage2D &image, int sign, nb::object out, int threads) {
+        return py_d(image, int_to_sign(sign), Recursive::Yes, Algorithm::DS,
+                    std::move(out), threads);
       },
-      nb::arg("image"), nb::arg("sign") = 1);
+      nb::arg("image"), nb::arg("sign") = 1, nb::arg("out") = nb::none(),
+      nb::arg("threads") = 1);
   m.def(
       "ds_non_recursive",
-      [](Image2D &image, int sign) {
-        return py_d(image, int_to_sign(sign), Recursive::No, Algorithm::DS);
+      [](ConstImage2D &image, int sign, nb::object out, int threads) {
+        return py_d(image, int_to_sign(sign), Recursive::No, Algorithm::DS,
+                    std::move(out), threads);
       },
-      nb::arg("image"), nb::arg("sign") = 1);
+      nb::arg("image"), nb::arg("sign") = 1, nb::arg("out") = nb::none(),
+      nb::arg("threads") = 1);
   m.def(
       "dt_recursive",
-      [](Image2D &image, int sign) {
-        return py_d(image, int_to_sign(sign), Recursive::Yes, Algorithm::DT);
+      [](ConstImage2D &image, int sign, nb::object out, int threads) {
+        return py_d(image, int_to_sign(sign), Recursive::Yes, Algorithm::DT,
+                    std::move(out), threads);
       },
-      nb::arg("image"), nb::arg("sign") = 1);
+      nb::arg("image"), nb::arg("sign") = 1, nb::arg("out") = nb::none(),
+      nb::arg("threads") = 1);
   m.def(
       "dt_non_recursive",
-      [](Image2D &image, int sign) {
-        return py_d(image, int_to_sign(sign), Recursive::No, Algorithm::DT);
+      [](ConstImage2D &image, int sign, nb::object out, int threads) {
+        return py_d(image, int_to_sign(sign), Recursive::No, Algorithm::DT,
+                    std::move(out), threads);
+      },
+      nb::arg("image"), nb::arg("sign") = 1, nb::arg("out") = nb::none(),
+      nb::arg("threads") = 1);
+  m.def(
+      "ds_adjoint",
+      [](ConstImage2D &image, int sign, nb::object out) {
+        return py_adjoint(image, int_to_sign(sign), Algorithm::DS,
+                          std::nullopt, std::move(out));
+      },
+      nb::arg("image"), nb::arg("sign") = 1, nb::arg("out") = nb::none());
+  m.def(
+      "dt_adjoint",
+      [](ConstImage2D &image, int sign, nb::object out) {
+        return py_adjoint(image, int_to_sign(sign), Algorithm::DT,
+                          std::nullopt, std::move(out));
+      },
+      nb::arg("image"), nb::arg("sign") = 1, nb::arg("out") = nb::none());
+  m.def(
+      "ids_adjoint",
+      [](ConstImage2D &image, Swaps swaps, int sign, nb::object out) {
+        return py_adjoint(image, int_to_sign(sign), Algorithm::DS, swaps,
+                          std::move(out));
+      },
+      nb::arg("image"), nb::arg("swaps"), nb::arg("sign") = 1,
+      nb::arg("out") = nb::none(),
+      "Transpose of `ids`, `image` and `swaps` are laid out as it returns "
+      "them");
+  m.def(
+      "idt_adjoint",
+      [](ConstImage2D &image, Swaps swaps, int sign, nb::object out) {
+        return py_adjoint(image, int_to_sign(sign), Algorithm::DT, swaps,
+                          std::move(out));
+      },
+      nb::arg("image"), nb::arg("swaps"), nb::arg("sign") = 1,
+      nb::arg("out") = nb::none(),
+      "Transpose of `idt`, `image` and `swaps` are laid out as it returns "
+      "them");
+  m.def(
+      "ds_pruned",
+      [](ConstImage2D &image, std::vector<int> const &ts, int sign) {
+        return py_pruned(image, ts, int_to_sign(sign), Algorithm::DS);
+      },
+      nb::arg("image"), nb::arg("ts"), nb::arg("sign") = 1,
+      "Rows `ts` of `ds`, merging only the rows that feed them");
+  m.def(
+      "dt_pruned",
+      [](ConstImage2D &image, std::vector<int> const &ts, int sign) {
+        return py_pruned(image, ts, int_to_sign(sign), Algorithm::DT);
+      },
+      nb::arg("image"), nb::arg("ts"), nb::arg("sign") = 1,
+      "Rows `ts` of `dt`, merging only the rows that feed them");
+  m.def(
+      "ds_roi",
+      [](ConstImage2D &image, int column_begin, int column_end, int sign,
+         nb::object out) {
+        return py_roi(image, column_begin, column_end, int_to_sign(sign),
+                      Algorithm::DS, std::move(out));
+      },
+      nb::arg("image"), nb::arg("column_begin"), nb::arg("column_end"),
+      nb::arg("sign") = 1, nb::arg("out") = nb::none(),
+      "Columns [column_begin, column_end) of `ds`");
+  m.def(
+      "dt_roi",
+      [](ConstImage2D &image, int column_begin, int column_end, int sign,
+         nb::object out) {
+        return py_roi(image, column_begin, column_end, int_to_sign(sign),
+                      Algorithm::DT, std::move(out));
+      },
+      nb::arg("image"), nb::arg("column_begin"), nb::arg("column_end"),
+      nb::arg("sign") = 1, nb::arg("out") = nb::none(),
+      "Columns [column_begin, column_end) of `dt`");
+  m.def(
+      "ds_top_k",
+      [](ConstImage2D &image, size_t k, int sign, int radius) {
+        return py_top_k(image, k, int_to_sign(sign), radius, Algorithm::DS);
+      },
+      nb::arg("image"), nb::arg("k"), nb::arg("sign") = 1,
+      nb::arg("radius") = 0,
+      "`k` strongest cells of `ds` as (ts, shifts, values), local maxima "
+      "within `radius` when it is positive");
+  m.def(
+      "dt_top_k",
+      [](ConstImage2D &image, size_t k, int sign, int radius) {
+        return py_top_k(image, k, int_to_sign(sign), radius, Algorithm::DT);
+      },
+      nb::arg("image"), nb::arg("k"), nb::arg("sign") = 1,
+      nb::arg("radius") = 0,
+      "`k` strongest cells of `dt` as (ts, shifts, values), local maxima "
+      "within `radius` when it is positive");
+  m.def(
+      "ms",
+      [](ConstImage2D &image, int sign) {
+        MPlan plan{image, min_rows(image)};
+        return py_m(plan, image, int_to_sign(sign), adrt::PatternRule::MS);
       },
       nb::arg("image"), nb::arg("sign") = 1);
+  m.def(
+      "mt",
+      [](ConstImage2D &image, int sign) {
+        MPlan plan{image, min_rows(image)};
+        return py_m(plan, image, int_to_sign(sign), adrt::PatternRule::MT);
+      },
+      nb::arg("image"), nb::arg("sign") = 1);
+  m.def(
+      "ss",
+      [](ConstImage2D &image, int sign) {
+        SPlan plan{image, image.shape(0)};
+        return py_s(plan, image, int_to_sign(sign), adrt::StripRule::SS);
+      },
+      nb::arg("image"), nb::arg("sign") = 1);
+  m.def(
+      "st",
+      [](ConstImage2D &image, int sign) {
+        SPlan plan{image, image.shape(0)};
+        return py_s(plan, image, int_to_sign(sign), adrt::StripRule::ST);
+      },
+      nb::arg("image"), nb::arg("sign") = 1);
+  m.def(
+      "sp",
+      [](ConstImage2D &image, int sign, int hs, int ws, int ns) {
+        SPPlan plan{new_sp_plan(image, hs, ws, ns)};
+        return py_call(plan, image, int_to_sign(sign));
+      },
+      nb::arg("image"), nb::arg("sign") = 1, nb::arg("hs") = 3,
+      nb::arg("ws") = 3, nb::arg("ns") = -1,
+      "Superpixel transform, `ns` < 0 is the middle row of a superpixel");
+  m.def(
+      "khanipov",
+      [](ConstImage2D &image, int sign) {
+        KhanipovPlan plan{image, image.shape(0)};
+        return py_call(plan, image, int_to_sign(sign));
+      },
+      nb::arg("image"), nb::arg("sign") = 1);
+  m.def(
+      "rdbu",
+      [](ConstImage2D &image, int sign) {
+        return py_resample(image, int_to_sign(sign), adrt::HeightRound::Floor);
+      },
+      nb::arg("image"), nb::arg("sign") = -1);
+  m.def(
+      "rubd",
+      [](ConstImage2D &image, int sign) {
+        return py_resample(image, int_to_sign(sign), adrt::HeightRound::Ceil);
+      },
+      nb::arg("image"), nb::arg("sign") = -1);
+  m.def(
+      "asd2",
+      [](ConstImage2D &image, int sign) {
+        ASD2Plan plan{image, min_rows(image)};
+        return py_call(plan, image, int_to_sign(sign));
+      },
+      nb::arg("image"), nb::arg("sign") = 1);
+  m.def(
+      "asd2_statistics",
+      [](int size) {
+        auto const plan = adrt::ASD2Plan::create(size, size);
+        return nb::make_tuple(plan.statistics.memory,
+                              plan.statistics.operations);
+      },
+      nb::arg("size"),
+      "(memory, operations) of a size x size image, as in "
+      "`asd2_statistics.py`");
+  m.def(
+      "ds_batch",
+      [](ConstImages3D &images, Images3D &out, int sign) {
+        return DBatchPlan{images}(images, out, int_to_sign(sign),
+                                  Algorithm::DS);
+      },
+      nb::arg("images"), nb::arg("out"), nb::arg("sign") = 1);
+  m.def(
+      "dt_batch",
+      [](ConstImages3D &images, Images3D &out, int sign) {
+        return DBatchPlan{images}(images, out, int_to_sign(sign),
+                                  Algorithm::DT);
+      },
+      nb::arg("images"), nb::arg("out"), nb::arg("sign") = 1);
+  m.def(
+      "ids_batch",
+      [](ConstImages3D &images, Images3D &out, int sign) {
+        return IDSBatchPlan{images}(images, out, int_to_sign(sign));
+      },
+      nb::arg("images"), nb::arg("out"), nb::arg("sign") = 1,
+      "In-place transforms of `out` when it is `images`, returns swaps");
+  m.def(
+      "idt_batch",
+      [](ConstImages3D &images, Images3D &out, int sign) {
+        return IDTBatchPlan{images}(images, out, int_to_sign(sign));
+      },
+      nb::arg("images"), nb::arg("out"), nb::arg("sign") = 1,
+      "In-place transforms of `out` when it is `images`, returns swaps");
+  m.def(
+      "ds_full",
+      [](ConstImage2D &image) {
+        return py_full(image, adrt::FullTransform::DS);
+      },
+      nb::arg("image"),
+      "All four quadrants of slopes, (2, h, w) of the image and (2, w, h) "
+      "of its transpose");
+  m.def(
+      "dt_full",
+      [](ConstImage2D &image) {
+        return py_full(image, adrt::FullTransform::DT);
+      },
+      nb::arg("image"),
+      "All four quadrants of slopes, (2, h, w) of the image and (2, w, h) "
+      "of its transpose");
+  m.def(
+      "ids_full",
+      [](ConstImage2D &image) {
+        return py_full(image, adrt::FullTransform::IDS);
+      },
+      nb::arg("image"),
+      "All four quadrants of slopes, (2, h, w) of the image and (2, w, h) "
+      "of its transpose, and (2 * (h + w)) swaps");
+  m.def(
+      "idt_full",
+      [](ConstImage2D &image) {
+        return py_full(image, adrt::FullTransform::IDT);
+      },
+      nb::arg("image"),
+      "All four quadrants of slopes, (2, h, w) of the image and (2, w, h) "
+      "of its transpose, and (2 * (h + w)) swaps");
+  nb::class_<DPlan>(m, "DPlan",
+                    "`ds` and `dt` for images like `prototype`, on "
+                    "`threads` threads, all of them for 0")
+      .def(nb::init<ConstImage2D &, int>(), nb::arg("prototype"),
+           nb::arg("threads") = 1)
+      .def(
+          "ds",
+          [](DPlan &plan, ConstImage2D &image, int sign, nb::object out) {
+            return plan(image, int_to_sign(sign), Algorithm::DS,
+                        std::move(out));
+          },
+          nb::arg("image"), nb::arg("sign") = 1, nb::arg("out") = nb::none())
+      .def(
+          "dt",
+          [](DPlan &plan, ConstImage2D &image, int sign, nb::object out) {
+            return plan(image, int_to_sign(sign), Algorithm::DT,
+                        std::move(out));
+          },
+          nb::arg("image"), nb::arg("sign") = 1, nb::arg("out") = nb::none());
+  nb::class_<IDSPlan>(m, "IDSPlan",
+                      "In-place `ids` for images like `prototype`")
+      .def(nb::init<ConstImage2D &>(), nb::arg("prototype"))
+      .def(
+          "__call__",
+          [](IDSPlan &plan, Image2D &image, int sign, nb::object swaps) {
+            return plan(image, int_to_sign(sign), std::move(swaps));
+          },
+          nb::arg("image"), nb::arg("sign") = 1, nb::arg("swaps") = nb::none());
+  nb::class_<IDTPlan>(m, "IDTPlan",
+                      "In-place `idt` for images like `prototype`")
+      .def(
+          "__init__",
+          [](IDTPlan *plan, ConstImage2D &prototype) {
+            new (plan) IDTPlan{prototype, adrt::ScheduleMode::Compiled};
+          },
+          nb::arg("prototype"))
+      .def(
+          "__call__",
+          [](IDTPlan &plan, Image2D &image, int sign, nb::object swaps) {
+            return plan(image, int_to_sign(sign), std::move(swaps));
+          },
+          nb::arg("image"), nb::arg("sign") = 1, nb::arg("swaps") = nb::none());
+  nb::class_<DBatchPlan>(
+      m, "DBatchPlan",
+      "`ds_batch` and `dt_batch` for batches of images like `prototype`")
+      .def(nb::init<ConstImages3D &>(), nb::arg("prototype"))
+      .def(
+          "ds",
+          [](DBatchPlan &plan, ConstImages3D &images, Images3D &out,
+             int sign) {
+            return plan(images, out, int_to_sign(sign), Algorithm::DS);
+          },
+          nb::arg("images"), nb::arg("out"), nb::arg("sign") = 1)
+      .def(
+          "dt",
+          [](DBatchPlan &plan, ConstImages3D &images, Images3D &out,
+             int sign) {
+            return plan(images, out, int_to_sign(sign), Algorithm::DT);
+          },
+          nb::arg("images"), nb::arg("out"), nb::arg("sign") = 1);
+  nb::class_<IDSBatchPlan>(m, "IDSBatchPlan",
+                           "`ids_batch` for batches of images like "
+                           "`prototype`")
+      .def(nb::init<ConstImages3D &>(), nb::arg("prototype"))
+      .def(
+          "__call__",
+          [](IDSBatchPlan &plan, ConstImages3D &images, Images3D &out,
+             int sign) { return plan(images, out, int_to_sign(sign)); },
+          nb::arg("images"), nb::arg("out"), nb::arg("sign") = 1);
+  nb::class_<IDTBatchPlan>(m, "IDTBatchPlan",
+                           "`idt_batch` for batches of images like "
+                           "`prototype`")
+      .def(nb::init<ConstImages3D &>(), nb::arg("prototype"))
+      .def(
+          "__call__",
+          [](IDTBatchPlan &plan, ConstImages3D &images, Images3D &out,
+             int sign) { return plan(images, out, int_to_sign(sign)); },
+          nb::arg("images"), nb::arg("out"), nb::arg("sign") = 1);
+  nb::class_<MPlan>(m, "MPlan", "`ms` and `mt` for images like `prototype`")
+      .def(
+          "__init__",
+          [](MPlan *plan, ConstImage2D &prototype) {
+            new (plan) MPlan{prototype, min_rows(prototype)};
+          },
+          nb::arg("prototype"))
+      .def(
+          "ms",
+          [](MPlan &plan, ConstImage2D &image, int sign) {
+            return py_m(plan, image, int_to_sign(sign),
+                        adrt::PatternRule::MS);
+          },
+          nb::arg("image"), nb::arg("sign") = 1)
+      .def(
+          "mt",
+          [](MPlan &plan, ConstImage2D &image, int sign) {
+            return py_m(plan, image, int_to_sign(sign),
+                        adrt::PatternRule::MT);
+          },
+          nb::arg("image"), nb::arg("sign") = 1);
+  nb::class_<SPlan>(m, "SPlan", "`ss` and `st` for images like `prototype`")
+      .def(
+          "__init__",
+          [](SPlan *plan, ConstImage2D &prototype) {
+            new (plan) SPlan{prototype, prototype.shape(0)};
+          },
+          nb::arg("prototype"))
+      .def(
+          "ss",
+          [](SPlan &plan, ConstImage2D &image, int sign) {
+            return py_s(plan, image, int_to_sign(sign), adrt::StripRule::SS);
+          },
+          nb::arg("image"), nb::arg("sign") = 1)
+      .def(
+          "st",
+          [](SPlan &plan, ConstImage2D &image, int sign) {
+            return py_s(plan, image, int_to_sign(sign), adrt::StripRule::ST);
+          },
+          nb::arg("image"), nb::arg("sign") = 1);
+  nb::class_<SPPlan>(m, "SPPlan", "`sp` for images like `prototype`")
+      .def(
+          "__init__",
+          [](SPPlan *plan, ConstImage2D &prototype, int hs, int ws, int ns) {
+            new (plan) SPPlan{new_sp_plan(prototype, hs, ws, ns)};
+          },
+          nb::arg("prototype"), nb::arg("hs") = 3, nb::arg("ws") = 3,
+          nb::arg("ns") = -1)
+      .def(
+          "__call__",
+          [](SPPlan &plan, ConstImage2D &image, int sign) {
+            return py_call(plan, image, int_to_sign(sign));
+          },
+          nb::arg("image"), nb::arg("sign") = 1);
+  nb::class_<KhanipovPlan>(m, "KhanipovPlan",
+                           "`khanipov` for images like `prototype`")
+      .def(
+          "__init__",
+          [](KhanipovPlan *plan, ConstImage2D &prototype) {
+            new (plan) KhanipovPlan{prototype, prototype.shape(0)};
+          },
+          nb::arg("prototype"))
+      .def(
+          "__call__",
+          [](KhanipovPlan &plan, ConstImage2D &image, int sign) {
+            return py_call(plan, image, int_to_sign(sign));
+          },
+          nb::arg("image"), nb::arg("sign") = 1);
+  nb::class_<ASD2Plan>(m, "ASD2Plan", "`asd2` for images like `prototype`")
+      .def(
+          "__init__",
+          [](ASD2Plan *plan, ConstImage2D &prototype) {
+            new (plan) ASD2Plan{prototype, min_rows(prototype)};
+          },
+          nb::arg("prototype"))
+      .def(
+          "__call__",
+          [](ASD2Plan &plan, ConstImage2D &image, int sign) {
+            return py_call(plan, image, int_to_sign(sign));
+          },
+          nb::arg("image"), nb::arg("sign") = 1);
+  nb::class_<DTStream>(m, "DTStream",
+                       "`dt` of a window sliding over pushed blocks of rows")
+      .def(
+          "__init__",
+          [](DTStream *stream, ConstImage2D &prototype, int block, int sign) {
+            new (stream) DTStream{prototype, block, int_to_sign(sign)};
+          },
+          nb::arg("prototype"), nb::arg("block"), nb::arg("sign") = 1)
+      .def("push", &DTStream::push, nb::arg("rows"))
+      .def_prop_ro("ready", &DTStream::ready)
+      .def("__call__", &DTStream::operator(), nb::arg("out") = nb::none());
+  nb::class_<DIncremental>(
+      m, "DIncremental",
+      "`ds` (or `dt` when `dt=True`) of frames that change in a few rows")
+      .def(
+          "__init__",
+          [](DIncremental *transform, ConstImage2D &prototype, int sign,
+             bool dt) {
+            new (transform) DIncremental{prototype, int_to_sign(sign),
+                                         dt ? Algorithm::DT : Algorithm::DS};
+          },
+          nb::arg("prototype"), nb::arg("sign") = 1, nb::arg("dt") = false)
+      .def("__call__", &DIncremental::operator(), nb::arg("image"),
+           nb::arg("changed") = nb::none(), nb::arg("out") = nb::none())
+      .def_prop_ro("merged_rows", &DIncremental::merged_rows,
+                   "Rows merged by the last call, `width` additions each")
+      .def_prop_ro("skipped_rows", &DIncremental::skipped_rows,
+                   "Rows kept from previous calls by the last call");
   m.def(
       "round05",
       [](double value) {
@@ -248,6 +1636,15 @@ NB_MODULE(_adrtlib, m) {
         return adrt::round05(value);
       },
       nb::arg("value"));
+  m.def("set_isa", &adrt::simd::set_isa, nb::arg("isa"),
+        "Force SIMD kernels of a given level, returns the active level");
+  m.def("active_isa", &adrt::simd::active_isa);
+  m.def("supported_isa", &adrt::simd::supported_isa);
+  nb::enum_<adrt::simd::ISA>(m, "ISA", nb::is_arithmetic())
+      .value("Scalar", adrt::simd::ISA::Scalar)
+      .value("SSE2", adrt::simd::ISA::SSE2)
+      .value("AVX2", adrt::simd::ISA::AVX2)
+      .value("AVX512", adrt::simd::ISA::AVX512);
   nb::enum_<adrt::Sign>(m, "Sign", nb::is_arithmetic())
       .value("Positive", adrt::Sign::Positive)
       .value("Negative", adrt::Sign::Negative)
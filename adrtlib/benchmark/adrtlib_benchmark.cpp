@@ -2,6 +2,7 @@
 
 #include <adrtlib/adrtlib.hpp>
 #include <memory>
+#include <vector>
 
 enum class IsRecursive { Yes, No };
 
@@ -89,7 +90,334 @@ static void BM_fht2d(benchmark::State &state, DAlgorithm algorithm,
                           int64_t(height * width * sizeof(float)));
 }
 
-static void BM_fht2idt(benchmark::State &state, IsRecursive is_recursive) {
+static void BM_khanipov(benchmark::State &state) {
+  int const height = state.range(0);
+  int const width = height;
+  std::unique_ptr<float[]> src_data{new float[height * width]};
+  std::unique_ptr<float[]> dst_data{new float[height * width]{}};
+  for (int idx = 0; idx != height * width; ++idx) {
+    src_data.get()[idx] = idx;
+  }
+
+  adrt::Tensor2D const src{
+      height, width,
+      static_cast<adrt::Tensor2D::stride_t>(width * sizeof(float)),
+      reinterpret_cast<uint8_t *>(src_data.get())};
+  adrt::Tensor2D const dst{
+      height, width,
+      static_cast<adrt::Tensor2D::stride_t>(width * sizeof(float)),
+      reinterpret_cast<uint8_t *>(dst_data.get())};
+
+  auto const khanipov = adrt::khanipov<float>::create(src.as<float>());
+  for (auto _ : state) {
+    khanipov(dst.as<float>(), src.as<float>(), adrt::Sign::Positive);
+  }
+
+  state.SetBytesProcessed(int64_t(state.iterations()) *
+                          int64_t(height * width * sizeof(float)));
+}
+
+// a new frame of `block` rows and the `dt` of the 1024x1024 window
+static void BM_dt_stream(benchmark::State &state) {
+  int const block = state.range(0);
+  int const height = 1024;
+  int const width = 1024;
+  std::unique_ptr<float[]> src_data{new float[height * width]};
+  std::unique_ptr<float[]> dst_data{new float[height * width]{}};
+  for (int idx = 0; idx != height * width; ++idx) {
+    src_data.get()[idx] = idx;
+  }
+
+  adrt::Tensor2D const src{
+      height, width,
+      static_cast<adrt::Tensor2D::stride_t>(width * sizeof(float)),
+      reinterpret_cast<uint8_t *>(src_data.get())};
+  adrt::Tensor2D const dst{
+      height, width,
+      static_cast<adrt::Tensor2D::stride_t>(width * sizeof(float)),
+      reinterpret_cast<uint8_t *>(dst_data.get())};
+
+  auto stream = adrt::dt_stream<float>::create(dst.as<float>(), block,
+                                               adrt::Sign::Positive);
+  stream.push(src.as<float>());
+  int begin = 0;
+  for (auto _ : state) {
+    stream.push(adrt::slice_no_checks(src, begin, begin + block).as<float>());
+    stream(dst.as<float>());
+    begin = (begin + block) % height;
+  }
+
+  state.SetBytesProcessed(int64_t(state.iterations()) *
+                          int64_t(height * width * sizeof(float)));
+}
+
+// `ds` of a 1024x1024 frame with a band of `state.range(0)` changed rows
+static void BM_d_incremental(benchmark::State &state) {
+  int const band = state.range(0);
+  int const height = 1024;
+  int const width = 1024;
+  std::unique_ptr<float[]> src_data{new float[height * width]};
+  std::unique_ptr<float[]> dst_data{new float[height * width]{}};
+  for (int idx = 0; idx != height * width; ++idx) {
+    src_data.get()[idx] = idx;
+  }
+
+  adrt::Tensor2D const src{
+      height, width,
+      static_cast<adrt::Tensor2D::stride_t>(width * sizeof(float)),
+      reinterpret_cast<uint8_t *>(src_data.get())};
+  adrt::Tensor2D const dst{
+      height, width,
+      static_cast<adrt::Tensor2D::stride_t>(width * sizeof(float)),
+      reinterpret_cast<uint8_t *>(dst_data.get())};
+
+  auto transform = adrt::d_incremental<float>::create(
+      src.as<float>(), adrt::Sign::Positive, adrt::ds_mid);
+  transform(dst.as<float>(), src.as<float>(), {});
+  int begin = 0;
+  for (auto _ : state) {
+    transform(dst.as<float>(), src.as<float>(),
+              {adrt::Slice(begin, begin + band)});
+    begin = (begin + band) % height;
+  }
+
+  state.SetBytesProcessed(int64_t(state.iterations()) *
+                          int64_t(height * width * sizeof(float)));
+}
+
+// `state.range(0)` middle rows of `ds` of a 1024x1024 image
+static void BM_d_pruned(benchmark::State &state) {
+  int const band = state.range(0);
+  int const height = 1024;
+  int const width = 1024;
+  std::unique_ptr<float[]> src_data{new float[height * width]};
+  std::unique_ptr<float[]> dst_data{new float[band * width]{}};
+  for (int idx = 0; idx != height * width; ++idx) {
+    src_data.get()[idx] = idx;
+  }
+
+  adrt::Tensor2D const src{
+      height, width,
+      static_cast<adrt::Tensor2D::stride_t>(width * sizeof(float)),
+      reinterpret_cast<uint8_t *>(src_data.get())};
+  adrt::Tensor2D const dst{
+      band, width,
+      static_cast<adrt::Tensor2D::stride_t>(width * sizeof(float)),
+      reinterpret_cast<uint8_t *>(dst_data.get())};
+
+  std::vector<int> ts;
+  for (int t = (height - band) / 2; t != (height + band) / 2; ++t) {
+    ts.push_back(t);
+  }
+  auto const pruned =
+      adrt::d_pruned<float>::create(src.as<float>(), ts, adrt::ds_mid);
+  for (auto _ : state) {
+    pruned(dst.as<float>(), src.as<float>(), adrt::Sign::Positive);
+  }
+
+  state.SetBytesProcessed(int64_t(state.iterations()) *
+                          int64_t(height * width * sizeof(float)));
+  state.counters["merged_rows"] = static_cast<double>(pruned.merged_rows());
+}
+
+// 32 middle columns of `ds` of a `state.range(0)`x1024 image
+static void BM_d_roi(benchmark::State &state) {
+  int const height = state.range(0);
+  int const width = 1024;
+  int const columns = 32;
+  std::unique_ptr<float[]> src_data{new float[height * width]};
+  std::unique_ptr<float[]> dst_data{new float[height * columns]{}};
+  for (int idx = 0; idx != height * width; ++idx) {
+    src_data.get()[idx] = idx;
+  }
+
+  adrt::Tensor2D const src{
+      height, width,
+      static_cast<adrt::Tensor2D::stride_t>(width * sizeof(float)),
+      reinterpret_cast<uint8_t *>(src_data.get())};
+  adrt::Tensor2D const dst{
+      height, columns,
+      static_cast<adrt::Tensor2D::stride_t>(columns * sizeof(float)),
+      reinterpret_cast<uint8_t *>(dst_data.get())};
+
+  int const begin = (width - columns) / 2;
+  auto const roi = adrt::d_roi<float>::create(src.as<float>(), begin,
+                                              begin + columns, adrt::ds_mid);
+  for (auto _ : state) {
+    roi(dst.as<float>(), src.as<float>(), adrt::Sign::Positive);
+  }
+
+  state.SetBytesProcessed(int64_t(state.iterations()) *
+                          int64_t(height * width * sizeof(float)));
+  state.counters["merged_columns"] =
+      static_cast<double>(roi.merged_columns(adrt::Sign::Positive));
+}
+
+// 16 strongest cells of `ds`, suppressed within 2 cells
+static void BM_d_top_k(benchmark::State &state) {
+  int const height = state.range(0);
+  int const width = height;
+  std::unique_ptr<float[]> src_data{new float[height * width]};
+  for (int idx = 0; idx != height * width; ++idx) {
+    src_data.get()[idx] = static_cast<float>((idx * 2654435761u) % 1000u);
+  }
+
+  adrt::Tensor2D const src{
+      height, width,
+      static_cast<adrt::Tensor2D::stride_t>(width * sizeof(float)),
+      reinterpret_cast<uint8_t *>(src_data.get())};
+
+  auto const d = adrt::d<float>::create(src.as<float>());
+  int const rows = d.ds_top_k_rows(2);
+  std::unique_ptr<float[]> scratch_data{new float[rows * width]};
+  adrt::Tensor2D const scratch{
+      rows, width,
+      static_cast<adrt::Tensor2D::stride_t>(width * sizeof(float)),
+      reinterpret_cast<uint8_t *>(scratch_data.get())};
+
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(d.ds_top_k(src.as<float>(), scratch.as<float>(),
+                                        adrt::Sign::Positive, 16, 2));
+  }
+
+  state.SetBytesProcessed(int64_t(state.iterations()) *
+                          int64_t(height * width * sizeof(float)));
+}
+
+static void BM_fht2m(benchmark::State &state, adrt::PatternRule rule) {
+  int const height = state.range(0);
+  int const width = height;
+  size_t const size = static_cast<size_t>(height) * width;
+  std::unique_ptr<float[]> src_data{new float[size]};
+  std::unique_ptr<float[]> dst_data{new float[size]{}};
+  for (size_t idx = 0; idx != size; ++idx) {
+    src_data.get()[idx] = static_cast<float>(idx);
+  }
+  adrt::Tensor2D::stride_t const stride = width * sizeof(float);
+  adrt::Tensor2D const src{height, width, stride,
+                           reinterpret_cast<uint8_t *>(src_data.get())};
+  adrt::Tensor2D const dst{height, width, stride,
+                           reinterpret_cast<uint8_t *>(dst_data.get())};
+  adrt::Sign const sign = adrt::Sign::Positive;
+
+  auto const m = adrt::m<float>::create(src.as<float>());
+  for (auto _ : state) {
+    if (rule == adrt::PatternRule::MS) {
+      m.ms(dst.as<float>(), src.as<float>(), sign);
+    } else {
+      m.mt(dst.as<float>(), src.as<float>(), sign);
+    }
+  }
+  state.SetBytesProcessed(int64_t(state.iterations()) *
+                          int64_t(size * sizeof(float)));
+}
+
+static void BM_asd2(benchmark::State &state) {
+  int const height = state.range(0);
+  int const width = height;
+  size_t const size = static_cast<size_t>(height) * width;
+  std::unique_ptr<float[]> src_data{new float[size]};
+  std::unique_ptr<float[]> dst_data{new float[size]{}};
+  for (size_t idx = 0; idx != size; ++idx) {
+    src_data.get()[idx] = static_cast<float>(idx);
+  }
+  adrt::Tensor2D::stride_t const stride = width * sizeof(float);
+  adrt::Tensor2D const src{height, width, stride,
+                           reinterpret_cast<uint8_t *>(src_data.get())};
+  adrt::Tensor2D const dst{height, width, stride,
+                           reinterpret_cast<uint8_t *>(dst_data.get())};
+
+  auto const asd2 = adrt::asd2<float>::create(src.as<float>());
+  for (auto _ : state) {
+    asd2(dst.as<float>(), src.as<float>(), adrt::Sign::Positive);
+  }
+  state.counters["operations"] =
+      static_cast<double>(asd2.statistics().operations);
+  state.counters["buffer_elements"] =
+      static_cast<double>(asd2.buffer_elements());
+  state.SetBytesProcessed(int64_t(state.iterations()) *
+                          int64_t(size * sizeof(float)));
+}
+
+static void BM_fht2s(benchmark::State &state, adrt::StripRule rule) {
+  int const height = state.range(0);
+  int const width = height;
+  size_t const size = static_cast<size_t>(height) * width;
+  std::unique_ptr<float[]> src_data{new float[size]};
+  std::unique_ptr<float[]> dst_data{new float[size]{}};
+  for (size_t idx = 0; idx != size; ++idx) {
+    src_data.get()[idx] = static_cast<float>(idx % 1024);
+  }
+  adrt::Tensor2D::stride_t const stride = width * sizeof(float);
+  adrt::Tensor2D const src{height, width, stride,
+                           reinterpret_cast<uint8_t *>(src_data.get())};
+  adrt::Tensor2D const dst{height, width, stride,
+                           reinterpret_cast<uint8_t *>(dst_data.get())};
+  adrt::ThreadPool pool{static_cast<unsigned>(state.range(1))};
+  adrt::ThreadPool *const cur_pool = state.range(1) == 0 ? nullptr : &pool;
+
+  auto const s = adrt::s<float>::create(src.as<float>());
+  for (auto _ : state) {
+    if (rule == adrt::StripRule::SS) {
+      s.ss(dst.as<float>(), src.as<float>(), adrt::Sign::Positive, cur_pool);
+    } else {
+      s.st(dst.as<float>(), src.as<float>(), adrt::Sign::Positive, cur_pool);
+    }
+  }
+  state.SetBytesProcessed(int64_t(state.iterations()) *
+                          int64_t(size * sizeof(float)));
+}
+
+static void BM_fht2resample(benchmark::State &state,
+                            adrt::HeightRound round) {
+  int const height = state.range(0);
+  int const width = height;
+  size_t const size = static_cast<size_t>(height) * width;
+  std::unique_ptr<float[]> src_data{new float[size]};
+  std::unique_ptr<float[]> dst_data{new float[size]{}};
+  for (size_t idx = 0; idx != size; ++idx) {
+    src_data.get()[idx] = static_cast<float>(idx % 1024);
+  }
+  adrt::Tensor2D::stride_t const stride = width * sizeof(float);
+  adrt::Tensor2D const src{height, width, stride,
+                           reinterpret_cast<uint8_t *>(src_data.get())};
+  adrt::Tensor2D const dst{height, width, stride,
+                           reinterpret_cast<uint8_t *>(dst_data.get())};
+
+  auto const resample = adrt::resample<float>::create(src.as<float>(), round);
+  for (auto _ : state) {
+    resample(dst.as<float>(), src.as<float>(), adrt::Sign::Negative);
+  }
+  state.SetBytesProcessed(int64_t(state.iterations()) *
+                          int64_t(size * sizeof(float)));
+}
+
+static void BM_fht2sp(benchmark::State &state) {
+  int const height = state.range(0);
+  int const width = height;
+  size_t const size = static_cast<size_t>(height) * width;
+  std::unique_ptr<float[]> src_data{new float[size]};
+  std::unique_ptr<float[]> dst_data{new float[size]{}};
+  for (size_t idx = 0; idx != size; ++idx) {
+    src_data.get()[idx] = static_cast<float>(idx % 1024);
+  }
+  adrt::Tensor2D::stride_t const stride = width * sizeof(float);
+  adrt::Tensor2D const src{height, width, stride,
+                           reinterpret_cast<uint8_t *>(src_data.get())};
+  adrt::Tensor2D const dst{height, width, stride,
+                           reinterpret_cast<uint8_t *>(dst_data.get())};
+
+  // 3x3 superpixels, the transform runs on a 9 times larger grid
+  auto const sp = adrt::sp<float>::create(src.as<float>());
+  for (auto _ : state) {
+    sp(dst.as<float>(), src.as<float>(), adrt::Sign::Positive);
+  }
+  state.SetBytesProcessed(int64_t(state.iterations()) *
+                          int64_t(size * sizeof(float)));
+}
+
+static void BM_fht2idt(benchmark::State &state, IsRecursive is_recursive,
+                       adrt::ScheduleMode mode = adrt::ScheduleMode::Dynamic) {
   int const height = state.range(0);
   int const width = height;
   std::unique_ptr<float[]> src{new float[height * width]{}};
@@ -103,13 +431,14 @@ static void BM_fht2idt(benchmark::State &state, IsRecursive is_recursive) {
   adrt::Sign const sign = adrt::Sign::Positive;
 
   if (is_recursive == IsRecursive::Yes) {
-    auto idt_recursive = adrt::idt_recursive<float>::create(tensor.as<float>());
+    auto idt_recursive =
+        adrt::idt_recursive<float>::create(tensor.as<float>(), mode);
     for (auto _ : state) {
       idt_recursive(tensor.as<float>(), sign);
     }
   } else {
     auto idt_non_recursive =
-        adrt::idt_non_recursive<float>::create(tensor.as<float>());
+        adrt::idt_non_recursive<float>::create(tensor.as<float>(), mode);
     for (auto _ : state) {
       idt_non_recursive(tensor.as<float>(), sign);
     }
@@ -118,7 +447,229 @@ static void BM_fht2idt(benchmark::State &state, IsRecursive is_recursive) {
                           int64_t(height * width * sizeof(float)));
 }
 
+static adrt::ThreadPool &benchmark_pool() {
+  static adrt::ThreadPool pool;
+  return pool;
+}
+
+static void BM_fht2d_parallel(benchmark::State &state, DAlgorithm algorithm,
+                              IsRecursive is_recursive) {
+  int const height = state.range(0);
+  int const width = height;
+  std::unique_ptr<float[]> src_data{new float[height * width]};
+  std::unique_ptr<float[]> dst_data{new float[height * width]{}};
+  for (int idx = 0; idx != height * width; ++idx) {
+    src_data.get()[idx] = idx;
+  }
+  adrt::Tensor2D const src{
+      height, width,
+      static_cast<adrt::Tensor2D::stride_t>(width * sizeof(float)),
+      reinterpret_cast<uint8_t *>(src_data.get())};
+  adrt::Tensor2D const dst{
+      height, width,
+      static_cast<adrt::Tensor2D::stride_t>(width * sizeof(float)),
+      reinterpret_cast<uint8_t *>(dst_data.get())};
+  adrt::Sign const sign = adrt::Sign::Positive;
+
+  adrt::Parallel const parallel{benchmark_pool()};
+  auto const d_core = adrt::d<float>::create(src.as<float>());
+  for (auto _ : state) {
+    if (is_recursive == IsRecursive::Yes) {
+      if (algorithm == DAlgorithm::DS) {
+        d_core.ds_recursive(dst.as<float>(), src.as<float>(), sign, parallel);
+      } else {
+        d_core.dt_recursive(dst.as<float>(), src.as<float>(), sign, parallel);
+      }
+    } else {
+      if (algorithm == DAlgorithm::DS) {
+        d_core.ds_non_recursive(dst.as<float>(), src.as<float>(), sign,
+                                parallel);
+      } else {
+        d_core.dt_non_recursive(dst.as<float>(), src.as<float>(), sign,
+                                parallel);
+      }
+    }
+  }
+  state.SetBytesProcessed(int64_t(state.iterations()) *
+                          int64_t(height * width * sizeof(float)));
+}
+
+enum class IsTiled { Yes, No };
+
+// `ds_recursive` with and without `Tiling` on (height, width) images, wide
+// rows are where subtrees stop fitting in cache
+static void BM_fht2d_tiled(benchmark::State &state, IsTiled is_tiled) {
+  int const height = state.range(0);
+  int const width = state.range(1);
+  size_t const size = static_cast<size_t>(height) * width;
+  std::unique_ptr<float[]> src_data{new float[size]};
+  std::unique_ptr<float[]> dst_data{new float[size]{}};
+  for (size_t idx = 0; idx != size; ++idx) {
+    src_data.get()[idx] = static_cast<float>(idx % 1024);
+  }
+  adrt::Tensor2D const src{
+      height, width,
+      static_cast<adrt::Tensor2D::stride_t>(width * sizeof(float)),
+      reinterpret_cast<uint8_t *>(src_data.get())};
+  adrt::Tensor2D const dst{
+      height, width,
+      static_cast<adrt::Tensor2D::stride_t>(width * sizeof(float)),
+      reinterpret_cast<uint8_t *>(dst_data.get())};
+  adrt::Sign const sign = adrt::Sign::Positive;
+
+  adrt::Tiling const tiling;
+  auto const d_core = adrt::d<float>::create(src.as<float>());
+  for (auto _ : state) {
+    if (is_tiled == IsTiled::Yes) {
+      d_core.ds_recursive(dst.as<float>(), src.as<float>(), sign, tiling);
+    } else {
+      d_core.ds_recursive(dst.as<float>(), src.as<float>(), sign);
+    }
+  }
+  state.SetBytesProcessed(int64_t(state.iterations()) *
+                          int64_t(size * sizeof(float)));
+}
+
+template <typename Transform>
+static void BM_inplace_parallel(benchmark::State &state) {
+  int const height = state.range(0);
+  int const width = height;
+  std::unique_ptr<float[]> src{new float[height * width]{}};
+  for (int idx = 0; idx != height * width; ++idx) {
+    src.get()[idx] = idx;
+  }
+  adrt::Tensor2D const tensor{
+      height, width,
+      static_cast<adrt::Tensor2D::stride_t>(width * sizeof(float)),
+      reinterpret_cast<uint8_t *>(src.get())};
+  adrt::Parallel const parallel{benchmark_pool()};
+  auto transform = Transform::create(tensor.as<float>());
+  for (auto _ : state) {
+    transform(tensor.as<float>(), adrt::Sign::Positive, parallel);
+  }
+  state.SetBytesProcessed(int64_t(state.iterations()) *
+                          int64_t(height * width * sizeof(float)));
+}
+
+enum class BatchTransform { DS, IDS, IDT };
+
+// 256 tiles of `range(0)` x `range(0)`, `range(1)` worker threads
+static void BM_batch(benchmark::State &state, BatchTransform transform) {
+  int const batch = 256;
+  int const height = state.range(0);
+  int const width = height;
+  size_t const size = static_cast<size_t>(batch) * height * width;
+  std::unique_ptr<float[]> src_data{new float[size]};
+  std::unique_ptr<float[]> dst_data{new float[size]{}};
+  std::unique_ptr<int[]> swaps{new int[batch * height]};
+  for (size_t idx = 0; idx != size; ++idx) {
+    src_data.get()[idx] = static_cast<float>(idx % 1024);
+  }
+  auto const make_tensor = [&](float *data) {
+    return adrt::Tensor3D{
+        batch,
+        height,
+        width,
+        static_cast<int64_t>(height * width * sizeof(float)),
+        static_cast<adrt::Tensor2D::stride_t>(width * sizeof(float)),
+        reinterpret_cast<uint8_t *>(data)};
+  };
+  adrt::Tensor3D const src{make_tensor(src_data.get())};
+  adrt::Tensor3D const dst{make_tensor(dst_data.get())};
+  adrt::Sign const sign = adrt::Sign::Positive;
+  adrt::ThreadPool pool{static_cast<unsigned>(state.range(1))};
+
+  auto const d_batch = adrt::d_batch<float>::create(height, width);
+  auto const ids_batch = adrt::ids_batch<float>::create(height, width);
+  auto const idt_batch = adrt::idt_batch<float>::create(height, width);
+  for (auto _ : state) {
+    switch (transform) {
+      case BatchTransform::DS:
+        d_batch.ds(dst, src, sign, pool);
+        break;
+      case BatchTransform::IDS:
+        ids_batch(dst, src, sign, swaps.get(), pool);
+        break;
+      case BatchTransform::IDT:
+        idt_batch(dst, src, sign, swaps.get(), pool);
+        break;
+    }
+  }
+  state.SetBytesProcessed(int64_t(state.iterations()) *
+                          int64_t(size * sizeof(float)));
+}
+
+static void BM_full(benchmark::State &state, adrt::FullTransform transform) {
+  int const size = state.range(0);
+  size_t const area = static_cast<size_t>(size) * size;
+  std::unique_ptr<float[]> src_data{new float[area]};
+  std::unique_ptr<float[]> dst_data{new float[4 * area]{}};
+  std::unique_ptr<int[]> swaps{new int[4 * size]};
+  for (size_t idx = 0; idx != area; ++idx) {
+    src_data.get()[idx] = static_cast<float>(idx % 1024);
+  }
+  adrt::Tensor2D const src{
+      size, size, static_cast<adrt::Tensor2D::stride_t>(size * sizeof(float)),
+      reinterpret_cast<uint8_t *>(src_data.get())};
+  adrt::Tensor3D const dst{
+      2,
+      size,
+      size,
+      static_cast<int64_t>(area * sizeof(float)),
+      static_cast<adrt::Tensor2D::stride_t>(size * sizeof(float)),
+      reinterpret_cast<uint8_t *>(dst_data.get())};
+  adrt::Tensor3D const dst_T{
+      2,
+      size,
+      size,
+      static_cast<int64_t>(area * sizeof(float)),
+      static_cast<adrt::Tensor2D::stride_t>(size * sizeof(float)),
+      reinterpret_cast<uint8_t *>(dst_data.get() + 2 * area)};
+  adrt::ThreadPool pool{static_cast<unsigned>(state.range(1))};
+  auto const full = adrt::fht2_full<float>::create(transform, size, size);
+  for (auto _ : state) {
+    full(dst, dst_T, src.as<float>(), swaps.get(), &pool);
+  }
+  state.SetBytesProcessed(int64_t(state.iterations()) *
+                          int64_t(4 * area * sizeof(float)));
+}
+
+// Compare kernels of a forced instruction set level against each other
+static void BM_add(benchmark::State &state, adrt::simd::ISA isa) {
+  if (static_cast<int>(isa) > static_cast<int>(adrt::simd::supported_isa())) {
+    state.SkipWithError("instruction set is not supported by this CPU");
+    return;
+  }
+  int const width = state.range(0);
+  std::unique_ptr<float[]> dst{new float[width]{}};
+  std::unique_ptr<float[]> src0{new float[width]};
+  std::unique_ptr<float[]> src1{new float[width]};
+  for (int idx = 0; idx != width; ++idx) {
+    src0.get()[idx] = idx;
+    src1.get()[idx] = width - idx;
+  }
+  for (auto _ : state) {
+    adrt::simd::add(dst.get(), src0.get(), src1.get(), width, isa);
+    benchmark::DoNotOptimize(dst.get());
+    benchmark::ClobberMemory();
+  }
+  state.SetBytesProcessed(int64_t(state.iterations()) *
+                          int64_t(width * sizeof(float)));
+}
+
+static void BM_fht2d_isa(benchmark::State &state, adrt::simd::ISA isa) {
+  if (static_cast<int>(isa) > static_cast<int>(adrt::simd::supported_isa())) {
+    state.SkipWithError("instruction set is not supported by this CPU");
+    return;
+  }
+  adrt::simd::ISA const initial_isa = adrt::simd::active_isa();
+  adrt::simd::set_isa(isa);
+  BM_fht2d(state, DAlgorithm::DS, IsRecursive::No);
+  adrt::simd::set_isa(initial_isa);
+}
+
 #define TEST_ARG ->DenseRange(1, 4096, 1)
+#define ISA_ARG ->RangeMultiplier(4)->Range(16, 4096)
 
 // Register the function as a benchmark
 BENCHMARK_CAPTURE(BM_fht2ids, recursive, IsRecursive::Yes) TEST_ARG;
@@ -129,6 +680,10 @@ BENCHMARK_CAPTURE(BM_fht2idt, recursive, IsRecursive::Yes) TEST_ARG;
 
 BENCHMARK_CAPTURE(BM_fht2idt, non_recursive, IsRecursive::No) TEST_ARG;
 
+BENCHMARK_CAPTURE(BM_fht2idt, non_recursive_compiled, IsRecursive::No,
+                  adrt::ScheduleMode::Compiled)
+TEST_ARG;
+
 BENCHMARK_CAPTURE(BM_fht2d, ds_recursive, DAlgorithm::DS, IsRecursive::Yes)
 TEST_ARG;
 
@@ -141,4 +696,76 @@ TEST_ARG;
 BENCHMARK_CAPTURE(BM_fht2d, dt_non_recursive, DAlgorithm::DT, IsRecursive::No)
 TEST_ARG;
 
+BENCHMARK(BM_khanipov)->RangeMultiplier(2)->Range(64, 1024);
+BENCHMARK(BM_dt_stream)->RangeMultiplier(4)->Range(16, 1024);
+BENCHMARK(BM_d_incremental)->RangeMultiplier(8)->Range(1, 1024);
+BENCHMARK(BM_d_pruned)->RangeMultiplier(8)->Range(1, 1024);
+BENCHMARK(BM_d_roi)->RangeMultiplier(4)->Range(64, 1024);
+BENCHMARK(BM_d_top_k)->RangeMultiplier(4)->Range(64, 1024);
+
+BENCHMARK_CAPTURE(BM_fht2m, ms, adrt::PatternRule::MS)
+    ->RangeMultiplier(4)
+    ->Range(16, 4096);
+BENCHMARK_CAPTURE(BM_fht2m, mt, adrt::PatternRule::MT)
+    ->RangeMultiplier(4)
+    ->Range(16, 4096);
+
+BENCHMARK(BM_asd2)->RangeMultiplier(4)->Range(16, 1024);
+
+// frame heights, which are never powers of two
+#define STRIP_ARG \
+  ->ArgsProduct({{720, 1080, 1200}, {0, 3}})->UseRealTime()
+BENCHMARK_CAPTURE(BM_fht2s, ss, adrt::StripRule::SS) STRIP_ARG;
+BENCHMARK_CAPTURE(BM_fht2s, st, adrt::StripRule::ST) STRIP_ARG;
+
+BENCHMARK_CAPTURE(BM_fht2resample, rdbu, adrt::HeightRound::Floor)
+    ->Arg(720)->Arg(1080)->Arg(1200);
+BENCHMARK_CAPTURE(BM_fht2resample, rubd, adrt::HeightRound::Ceil)
+    ->Arg(720)->Arg(1080)->Arg(1200);
+
+BENCHMARK(BM_fht2sp)->RangeMultiplier(2)->Range(64, 1024);
+
+#define PARALLEL_ARG ->RangeMultiplier(2)->Range(256, 8192)->UseRealTime()
+
+BENCHMARK_CAPTURE(BM_fht2d_parallel, ds_recursive, DAlgorithm::DS,
+                  IsRecursive::Yes) PARALLEL_ARG;
+BENCHMARK_CAPTURE(BM_fht2d_parallel, dt_recursive, DAlgorithm::DT,
+                  IsRecursive::Yes) PARALLEL_ARG;
+BENCHMARK_CAPTURE(BM_fht2d_parallel, ds_non_recursive, DAlgorithm::DS,
+                  IsRecursive::No) PARALLEL_ARG;
+BENCHMARK_CAPTURE(BM_fht2d_parallel, dt_non_recursive, DAlgorithm::DT,
+                  IsRecursive::No) PARALLEL_ARG;
+#define TILED_ARG \
+  ->Args({4096, 4096})->Args({1024, 16384})->Args({256, 65536})
+BENCHMARK_CAPTURE(BM_fht2d_tiled, untiled, IsTiled::No) TILED_ARG;
+BENCHMARK_CAPTURE(BM_fht2d_tiled, tiled, IsTiled::Yes) TILED_ARG;
+BENCHMARK_TEMPLATE(BM_inplace_parallel, adrt::ids_non_recursive<float>)
+PARALLEL_ARG;
+BENCHMARK_TEMPLATE(BM_inplace_parallel, adrt::idt_non_recursive<float>)
+PARALLEL_ARG;
+
+#define BATCH_ARG \
+  ->ArgsProduct({{16, 64, 256}, {0, 1, 3, 7, 15}})->UseRealTime()
+
+BENCHMARK_CAPTURE(BM_batch, ds, BatchTransform::DS) BATCH_ARG;
+BENCHMARK_CAPTURE(BM_batch, ids, BatchTransform::IDS) BATCH_ARG;
+BENCHMARK_CAPTURE(BM_batch, idt, BatchTransform::IDT) BATCH_ARG;
+
+#define FULL_ARG \
+  ->ArgsProduct({{256, 1024, 4096}, {0, 3}})->UseRealTime()
+BENCHMARK_CAPTURE(BM_full, ds, adrt::FullTransform::DS) FULL_ARG;
+BENCHMARK_CAPTURE(BM_full, dt, adrt::FullTransform::DT) FULL_ARG;
+BENCHMARK_CAPTURE(BM_full, ids, adrt::FullTransform::IDS) FULL_ARG;
+BENCHMARK_CAPTURE(BM_full, idt, adrt::FullTransform::IDT) FULL_ARG;
+
+BENCHMARK_CAPTURE(BM_add, scalar, adrt::simd::ISA::Scalar) ISA_ARG;
+BENCHMARK_CAPTURE(BM_add, sse2, adrt::simd::ISA::SSE2) ISA_ARG;
+BENCHMARK_CAPTURE(BM_add, avx2, adrt::simd::ISA::AVX2) ISA_ARG;
+BENCHMARK_CAPTURE(BM_add, avx512, adrt::simd::ISA::AVX512) ISA_ARG;
+
+BENCHMARK_CAPTURE(BM_fht2d_isa, scalar, adrt::simd::ISA::Scalar) ISA_ARG;
+BENCHMARK_CAPTURE(BM_fht2d_isa, sse2, adrt::simd::ISA::SSE2) ISA_ARG;
+BENCHMARK_CAPTURE(BM_fht2d_isa, avx2, adrt::simd::ISA::AVX2) ISA_ARG;
+BENCHMARK_CAPTURE(BM_fht2d_isa, avx512, adrt::simd::ISA::AVX512) ISA_ARG;
+
 BENCHMARK_MAIN();
@@ -1,4 +1,16 @@
 #pragma once
+#include "asd2.hpp"
+#include "batch.hpp"
 #include "fht2d.hpp"
 #include "fht2ids.hpp"
 #include "fht2idt.hpp"
+#include "fht2m.hpp"
+#include "fht2s.hpp"
+#include "fht2sp.hpp"
+#include "full.hpp"
+#include "incremental.hpp"
+#include "khanipov.hpp"
+#include "pruned.hpp"
+#include "resample.hpp"
+#include "roi.hpp"
+#include "stream.hpp"
@@ -0,0 +1,299 @@
+#pragma once
+#include <algorithm>  // std::stable_sort, std::min, std::max
+#include <array>
+#include <cmath>   // std::nearbyint
+#include <memory>  // std::unique_ptr
+#include <vector>
+
+#include "fht2m.hpp"
+
+namespace adrt {
+
+//
+// ASD2, the transform over exact digital line patterns (see `ref/asd2.py`).
+// The image is split in halves, every section of a pattern is identified
+// by its `find_nqps` hash (see `ref/Patterns4numbers.py`) and patterns with
+// equal hashes share one row of the section transform.
+//
+
+// (n, q, p, s) of `find_nqps`
+using PatternHash = std::array<int, 4>;
+
+// Smallest period of `values`, `values.size()` when there is none
+static inline int smallest_period(std::vector<int> const &values) {
+  int const size = static_cast<int>(values.size());
+  std::vector<int> z(size, 0);  // Z-function
+  for (int idx = 1, left = 0, right = 0; idx < size; ++idx) {
+    if (idx < right) {
+      z[idx] = std::min(right - idx, z[idx - left]);
+    }
+    while (idx + z[idx] < size && values[z[idx]] == values[idx + z[idx]]) {
+      ++z[idx];
+    }
+    if (idx + z[idx] > right) {
+      left = idx;
+      right = idx + z[idx];
+    }
+    if (z[idx] == size - idx) {
+      return idx;
+    }
+  }
+  return size;
+}
+
+// sgn((b - a)^T x (c - b)) of `T`
+static inline int turn(std::array<int, 2> const &a,
+                       std::array<int, 2> const &b,
+                       std::array<int, 2> const &c) {
+  int64_t const cross = int64_t{b[0] - a[0]} * (c[1] - b[1]) -
+                        int64_t{b[1] - a[1]} * (c[0] - b[0]);
+  return (cross > 0) - (cross < 0);
+}
+
+// `find_Nkhx0`: x of the upper point of the separating common tangent
+static inline int pattern_x0(int const points[], int count) {
+  std::vector<std::array<int, 2>> upper, lower;  // `find_Ss`
+  lower.push_back({0, count - 1});
+  for (int idx = 0; idx != count; ++idx) {
+    upper.push_back({idx, points[idx]});
+    lower.push_back({idx, points[idx] + 1});
+  }
+  upper.push_back({count - 1, 0});
+  int const n0 = static_cast<int>(upper.size());
+  int const n1 = static_cast<int>(lower.size());
+  int s0 = 0, t0 = 1, s1 = 0, t1 = 1;
+  bool first = true;
+  while (t0 <= 2 * n0 && t1 <= 2 * n1) {
+    A_NEVER(s0 >= n0 || s1 >= n1);
+    if (first) {
+      if (turn(lower[s1], upper[s0], upper[t0 % n0]) == 1) {
+        s0 = t0;
+        t1 = s1 + 1;
+      }
+      ++t0;
+    } else {
+      if (turn(upper[s0], lower[s1], lower[t1 % n1]) == 1) {
+        s1 = t1;
+        t0 = s0 + 1;
+      }
+      ++t1;
+    }
+    first = !first;
+  }
+  A_NEVER(s0 >= n0);
+  return upper[s0][0];
+}
+
+static inline PatternHash find_nqps(int const points[], int count) {
+  std::vector<int> steps;
+  for (int idx = 1; idx < count; ++idx) {
+    steps.emplace_back(points[idx] - points[idx - 1]);
+  }
+  int const q = smallest_period(steps);
+  int p = 0;
+  for (int idx = 0; idx != q; ++idx) {
+    p += steps[idx];
+  }
+  return {count - 1, q, p, pattern_x0(points, count)};
+}
+
+// Patterns of one section, every pattern is `length` shifts from its start
+struct PatternSet {
+  int length{};
+  std::vector<int> shifts;  // pattern `k` is [k * length, (k + 1) * length)
+
+  int size() const {
+    return static_cast<int>(this->shifts.size()) / this->length;
+  }
+  int const *operator[](int k) const {
+    return this->shifts.data() + static_cast<size_t>(k) * this->length;
+  }
+};
+
+// `Build_Gkchp`: the digital line of slope `k` for every output row
+static inline PatternSet line_patterns(int height, int width) {
+  PatternSet patterns{height, {}};
+  for (int k = 0; k != std::min(height, width); ++k) {
+    for (int idx = 0; idx != height; ++idx) {
+      // `round` of python rounds half to even, as `nearbyint` does
+      int const shift = static_cast<int>(std::nearbyint(
+          static_cast<double>(int64_t{k} * idx) / (height - 1)));
+      patterns.shifts.emplace_back(shift % width);
+    }
+  }
+  return patterns;
+}
+
+// `Get_Patterns_Section`: distinct sections [begin, begin + length) of
+// `patterns` ordered by hash, `index[k]` is the section of pattern `k`
+static inline PatternSet pattern_section(PatternSet const &patterns,
+                                         int begin, int length,
+                                         std::vector<int> &index) {
+  int const count = patterns.size();
+  std::vector<PatternHash> hashes(count);
+  std::vector<int> order(count);
+  std::vector<int> section(length);
+  for (int k = 0; k != count; ++k) {
+    int const *pattern = patterns[k];
+    for (int idx = 0; idx != length; ++idx) {
+      section[idx] = pattern[begin + idx] - pattern[begin];
+    }
+    hashes[k] = find_nqps(section.data(), length);
+    order[k] = k;
+  }
+  std::stable_sort(order.begin(), order.end(), [&](int lhs, int rhs) {
+    return hashes[lhs] < hashes[rhs];
+  });
+  PatternSet sections{length, {}};
+  index.assign(count, -1);
+  int n = -1;
+  for (int pos = 0; pos != count; ++pos) {
+    int const k = order[pos];
+    if (pos == 0 || hashes[k] != hashes[order[pos - 1]]) {
+      int const *pattern = patterns[k];
+      for (int idx = 0; idx != length; ++idx) {
+        sections.shifts.emplace_back(pattern[begin + idx] - pattern[begin]);
+      }
+      ++n;
+    }
+    index[k] = n;
+  }
+  return sections;
+}
+
+// Counts of `asd2_statistics.py` for square images, in elements and
+// element additions
+struct ASD2Statistics {
+  int64_t memory{};      // two `height` x `width` images per merge
+  int64_t operations{};  // `width` per output row of every merge
+};
+
+//
+// `MergePlan` of ASD2 in the layout of `fht2m`. Section transforms of
+// depth > 0 are allocated on a stack per depth parity: a merge pushes its
+// rows after its children and pops them, so `buffer_rows` are the peaks.
+//
+struct ASD2Plan {
+  MergePlan merge;
+  int buffer_rows[2]{};  // odd, even depths
+  ASD2Statistics statistics;
+
+  static ASD2Plan create(int height, int width) {
+    ASD2Plan plan;
+    plan.merge.height = height;
+    plan.merge.width = width;
+    if (height > 1 && width > 0) {
+      int top[2]{};
+      plan.add_steps(line_patterns(height, width), 0, height, 0, top);
+    }
+    return plan;
+  }
+
+ private:
+  struct Section {
+    int step;
+    int offset;  // first row of the section transform
+    int rows;
+  };
+
+  Section add_steps(PatternSet const &patterns, int begin, int height,
+                    int level, int top[2]) {
+    if (height <= 1) {
+      return Section{-1, begin, 1};
+    }
+    int const h_T = height / 2;
+    std::vector<int> index_T, index_B;
+    Section const section_T =
+        this->add_steps(pattern_section(patterns, 0, h_T, index_T), begin,
+                        h_T, level + 1, top);
+    Section const section_B = this->add_steps(
+        pattern_section(patterns, h_T, height - h_T, index_B), begin + h_T,
+        height - h_T, level + 1, top);
+
+    int const rows = patterns.size();
+    int &stack = top[(level & 1) == 0];
+    int const offset = level == 0 ? 0 : stack;
+    if (level != 0) {
+      stack += rows;
+      int &peak = this->buffer_rows[(level & 1) == 0];
+      peak = std::max(peak, stack);
+    }
+    MergeStep step;
+    step.child_T = section_T.step;
+    step.child_B = section_B.step;
+    step.level = level;
+    step.rows_begin = static_cast<int>(this->merge.rows.size());
+    int const width = this->merge.width;
+    for (int k = 0; k != rows; ++k) {
+      int const shift = patterns[k][h_T];
+      this->merge.rows.push_back(
+          MergeRow{offset + k, section_T.offset + index_T[k],
+                   section_B.offset + index_B[k],
+                   apply_sign(Sign::Positive, shift, width),
+                   apply_sign(Sign::Negative, shift, width)});
+    }
+    step.rows_end = static_cast<int>(this->merge.rows.size());
+    this->merge.steps.push_back(step);
+    // children are the two latest sections of the other stack
+    int &child_stack = top[(level & 1) != 0];
+    for (Section const *child : {&section_T, &section_B}) {
+      if (child->step >= 0) {
+        child_stack -= child->rows;
+      }
+    }
+    this->statistics.memory += int64_t{2} * height * width;
+    this->statistics.operations += int64_t{rows} * width;
+    return Section{static_cast<int>(this->merge.steps.size()) - 1, offset,
+                   rows};
+  }
+};
+
+//
+// ASD2 for one image shape. Patterns, sections and their hashes are built
+// once in `create`; `dst` has min(height, width) rows.
+//
+template <typename Scalar>
+class asd2 {
+  ASD2Plan plan;
+  std::unique_ptr<Scalar[]> buffer_data;
+  Tensor2D buffer_odd;
+  Tensor2D buffer_even;
+
+ public:
+  explicit asd2(ASD2Plan &&plan)
+      : plan{std::move(plan)},
+        buffer_data{new Scalar[static_cast<size_t>(
+                                   this->plan.buffer_rows[0] +
+                                   this->plan.buffer_rows[1]) *
+                               this->plan.merge.width]},
+        buffer_odd{this->plan.buffer_rows[0], this->plan.merge.width,
+                   static_cast<Tensor2D::stride_t>(this->plan.merge.width *
+                                                   sizeof(Scalar)),
+                   reinterpret_cast<uint8_t *>(this->buffer_data.get())},
+        buffer_even{this->plan.buffer_rows[1], this->plan.merge.width,
+                    this->buffer_odd.stride,
+                    reinterpret_cast<uint8_t *>(
+                        this->buffer_data.get() +
+                        static_cast<size_t>(this->plan.buffer_rows[0]) *
+                            this->plan.merge.width)} {}
+
+  static asd2<Scalar> create(Tensor2DTyped<Scalar> const &prototype) {
+    return asd2<Scalar>{ASD2Plan::create(prototype.height, prototype.width)};
+  }
+
+  void operator()(Tensor2DTyped<Scalar> const &dst,
+                  Tensor2DTyped<Scalar> const &src, Sign sign) const {
+    fht2m(dst, src, this->buffer_odd.as<Scalar>(),
+          this->buffer_even.as<Scalar>(), sign, this->plan.merge);
+  }
+
+  ASD2Statistics const &statistics() const { return this->plan.statistics; }
+
+  // elements of the buffers, measured after the plan is built
+  int64_t buffer_elements() const {
+    return int64_t{this->plan.buffer_rows[0] + this->plan.buffer_rows[1]} *
+           this->plan.merge.width;
+  }
+};
+
+}  // namespace adrt
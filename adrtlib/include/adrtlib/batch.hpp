@@ -0,0 +1,230 @@
+#pragma once
+#include <memory>  // std::unique_ptr
+#include <vector>
+
+#include "fht2d.hpp"
+#include "fht2ids.hpp"
+#include "fht2idt.hpp"
+#include "level_schedule.hpp"
+#include "thread_pool.hpp"
+
+namespace adrt {
+
+// Stack of `batch` images of the same shape
+struct Tensor3D {
+  int32_t batch;
+  int32_t height;
+  int32_t width;
+  int64_t batch_stride;       // bytes between images
+  Tensor2D::stride_t stride;  // bytes between rows of an image
+  uint8_t *data;
+
+  Tensor3D(int32_t batch, int32_t height, int32_t width, int64_t batch_stride,
+           Tensor2D::stride_t stride, uint8_t *data)
+      : batch{batch},
+        height{height},
+        width{width},
+        batch_stride{batch_stride},
+        stride{stride},
+        data{data} {}
+
+  Tensor2D image(int idx) const {
+    A_NEVER(idx < 0 || idx >= this->batch);
+    return Tensor2D{this->height, this->width, this->stride,
+                    this->data + idx * this->batch_stride};
+  }
+
+  bool same_shape(Tensor3D const &other) const {
+    return this->batch == other.batch && this->height == other.height &&
+           this->width == other.width;
+  }
+};
+
+// Calls `callback(idx, workspace)` for every image index, images are spread
+// between threads of `pool` and every chunk of images leases one workspace
+template <typename Workspace, typename Callback>
+static inline void for_each_image(ThreadPool &pool, int batch,
+                                  WorkspacePool<Workspace> &workspaces,
+                                  Callback const &callback) {
+  parallel_for(pool, 0, batch, 1, [&](int begin, int end) {
+    auto const workspace = workspaces.acquire();
+    for (int idx = begin; idx != end; ++idx) {
+      callback(idx, *workspace);
+    }
+  });
+}
+
+template <typename Scalar>
+struct d_batch_workspace {
+  std::unique_ptr<Scalar[]> buffer_data;
+  Tensor2D buffer;
+
+  static d_batch_workspace<Scalar> create(int height, int width) {
+    std::unique_ptr<Scalar[]> buffer_data{
+        new Scalar[static_cast<size_t>(height) * width]};
+    Tensor2D const buffer{
+        height, width,
+        static_cast<Tensor2D::stride_t>(width * sizeof(Scalar)),
+        reinterpret_cast<uint8_t *>(buffer_data.get())};
+    return d_batch_workspace<Scalar>{std::move(buffer_data), buffer};
+  }
+};
+
+//
+// `d` for many images of one shape. Merge plans are built once and shared
+// by all threads, every thread gets its own buffer image. `dst` may be
+// `src`: all rows of an image are loaded into the merge tree before the
+// first merge writes it. Other overlaps of `dst` and `src` are not allowed.
+//
+template <typename Scalar>
+class d_batch {
+  MergePlan ds_plan;
+  MergePlan dt_plan;
+  std::unique_ptr<WorkspacePool<d_batch_workspace<Scalar>>> workspaces;
+
+  void run(Tensor3D const &dst, Tensor3D const &src, Sign sign,
+           MergePlan const &plan, ThreadPool &pool) const {
+    A_NEVER(!dst.same_shape(src) || !plan.matches(src.height, src.width));
+    for_each_image(
+        pool, src.batch, *this->workspaces,
+        [&](int idx, d_batch_workspace<Scalar> &workspace) {
+          fht2d_recursive(dst.image(idx).as<Scalar>(),
+                          src.image(idx).as<Scalar>(),
+                          workspace.buffer.template as<Scalar>(), sign, plan);
+        });
+  }
+
+ public:
+  d_batch(int height, int width, MergePlan &&ds_plan, MergePlan &&dt_plan)
+      : ds_plan{std::move(ds_plan)},
+        dt_plan{std::move(dt_plan)},
+        workspaces{new WorkspacePool<d_batch_workspace<Scalar>>{
+            [height, width] {
+              return d_batch_workspace<Scalar>::create(height, width);
+            }}} {}
+
+  static d_batch<Scalar> create(int height, int width) {
+    return d_batch<Scalar>{height, width,
+                           MergePlan::create(height, width, ds_mid),
+                           MergePlan::create(height, width, dt_mid)};
+  }
+
+  void ds(Tensor3D const &dst, Tensor3D const &src, Sign sign,
+          ThreadPool &pool) const {
+    this->run(dst, src, sign, this->ds_plan, pool);
+  }
+
+  void dt(Tensor3D const &dst, Tensor3D const &src, Sign sign,
+          ThreadPool &pool) const {
+    this->run(dst, src, sign, this->dt_plan, pool);
+  }
+};
+
+template <typename Scalar>
+struct inplace_batch_workspace {
+  std::unique_ptr<Scalar[]> line_buffer;
+  std::unique_ptr<int[]> swaps_buffer;
+
+  static inplace_batch_workspace<Scalar> create(int height, int width) {
+    return inplace_batch_workspace<Scalar>{
+        std::unique_ptr<Scalar[]>{new Scalar[width]},
+        std::unique_ptr<int[]>{new int[height]}};
+  }
+};
+
+// Copies images of `src` to `dst` unless the transform is done in place
+template <typename Scalar>
+static inline void prepare_inplace(Tensor2D const &dst, Tensor2D const &src) {
+  if (dst.data != src.data) {
+    copy_tensor(dst, src, sizeof(Scalar));
+  }
+}
+
+//
+// `ids_non_recursive` for many images of one shape. `dst` may be `src`,
+// swaps of image `idx` are written to `swaps + idx * height`.
+//
+template <typename Scalar>
+class ids_batch {
+  int height;
+  int width;
+  std::vector<ADRTTask> tasks;
+  std::unique_ptr<WorkspacePool<inplace_batch_workspace<Scalar>>> workspaces;
+
+ public:
+  ids_batch(int height, int width, std::vector<ADRTTask> &&tasks)
+      : height{height},
+        width{width},
+        tasks{std::move(tasks)},
+        workspaces{new WorkspacePool<inplace_batch_workspace<Scalar>>{
+            [height, width] {
+              return inplace_batch_workspace<Scalar>::create(height, width);
+            }}} {}
+
+  static ids_batch<Scalar> create(int height, int width) {
+    std::vector<ADRTTask> tasks;
+    non_recursive(
+        height, [&](ADRTTask const &task) { tasks.emplace_back(task); },
+        ds_mid);
+    return ids_batch<Scalar>{height, width, std::move(tasks)};
+  }
+
+  void operator()(Tensor3D const &dst, Tensor3D const &src, Sign sign,
+                  int swaps[], ThreadPool &pool) const {
+    A_NEVER(!dst.same_shape(src) || src.height != this->height ||
+            src.width != this->width);
+    for_each_image(
+        pool, src.batch, *this->workspaces,
+        [&](int idx, inplace_batch_workspace<Scalar> &workspace) {
+          Tensor2D const image{dst.image(idx)};
+          prepare_inplace<Scalar>(image, src.image(idx));
+          int *image_swaps = swaps + static_cast<size_t>(idx) * src.height;
+          if A_UNLIKELY (src.height <= 1) {
+            std::fill(image_swaps, image_swaps + src.height, 0);
+            return;
+          }
+          _fht2ids_non_recursive(image.as<Scalar>(), sign, image_swaps,
+                                 workspace.swaps_buffer.get(),
+                                 workspace.line_buffer.get(), this->tasks);
+        });
+  }
+};
+
+//
+// `idt_non_recursive` for many images of one shape, replays one compiled
+// schedule for every image. Conventions are the same as in `ids_batch`.
+//
+template <typename Scalar>
+class idt_batch {
+  IDTSchedule schedule;
+  std::unique_ptr<WorkspacePool<inplace_batch_workspace<Scalar>>> workspaces;
+
+ public:
+  explicit idt_batch(IDTSchedule &&schedule)
+      : schedule{std::move(schedule)},
+        workspaces{new WorkspacePool<inplace_batch_workspace<Scalar>>{
+            [height = this->schedule.height, width = this->schedule.width] {
+              return inplace_batch_workspace<Scalar>::create(height, width);
+            }}} {}
+
+  static idt_batch<Scalar> create(int height, int width) {
+    return idt_batch<Scalar>{
+        IDTSchedule::record(height, width, idt_tasks(height))};
+  }
+
+  void operator()(Tensor3D const &dst, Tensor3D const &src, Sign sign,
+                  int swaps[], ThreadPool &pool) const {
+    A_NEVER(!dst.same_shape(src));
+    for_each_image(
+        pool, src.batch, *this->workspaces,
+        [&](int idx, inplace_batch_workspace<Scalar> &workspace) {
+          Tensor2D const image{dst.image(idx)};
+          prepare_inplace<Scalar>(image, src.image(idx));
+          _fht2idt_replay(image.as<Scalar>(), sign,
+                          swaps + static_cast<size_t>(idx) * src.height,
+                          workspace.line_buffer.get(), this->schedule);
+        });
+  }
+};
+
+}  // namespace adrt
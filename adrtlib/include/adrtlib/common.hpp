@@ -45,6 +45,44 @@ enum class Sign : int_fast8_t {
   Positive = 1,
 };
 
+// 16-bit float pixels. They are only read, every transform widens them to
+// its accumulator type first.
+struct half {
+  uint16_t bits;
+
+  explicit operator float() const {
+    // the exponent is rebiased by a multiplication, which also normalizes
+    // subnormals; infinities and NaNs keep the top exponent
+    uint32_t const sign = static_cast<uint32_t>(this->bits & 0x8000u) << 16;
+    uint32_t const magnitude = static_cast<uint32_t>(this->bits & 0x7fffu)
+                               << 13;
+    float value;
+    if (magnitude >= (0x7c00u << 13)) {
+      uint32_t const special = sign | 0x7f800000u | magnitude;
+      std::memcpy(&value, &special, sizeof(value));
+      return value;
+    }
+    std::memcpy(&value, &magnitude, sizeof(value));
+    value *= 5.192296858534828e+33f;  // 2^112, the difference of the biases
+    uint32_t result;
+    std::memcpy(&result, &value, sizeof(result));
+    result |= sign;
+    std::memcpy(&value, &result, sizeof(value));
+    return value;
+  }
+};
+
+struct bfloat16 {
+  uint16_t bits;
+
+  explicit operator float() const {
+    uint32_t const value_bits = static_cast<uint32_t>(this->bits) << 16;
+    float value;
+    std::memcpy(&value, &value_bits, sizeof(value));
+    return value;
+  }
+};
+
 template <typename Scalar>
 struct Tensor2DTyped;
 
@@ -85,9 +123,13 @@ static inline Scalar *A_LINE(Tensor2DTyped<Scalar> const &tensor,
   return reinterpret_cast<Scalar *>(tensor.data + tensor.stride * (n));
 }
 
+// nothing to do when `dst` is `src`, as in transforms done in place
 static inline void copy_tensor(Tensor2D const &dst, Tensor2D const &src,
                                size_t scalar_size) {
   A_NEVER(dst.height != src.height || dst.width != src.width);
+  if (dst.data == src.data && dst.stride == src.stride) {
+    return;
+  }
   uint8_t *line_dst = dst.data;
   uint8_t const *line_src = src.data;
   size_t const line_length = src.width * scalar_size;
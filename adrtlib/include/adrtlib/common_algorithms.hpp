@@ -1,7 +1,11 @@
 #pragma once
-#include <cstring>  // std::memcpy
+#include <algorithm>  // std::min, std::max
+#include <cmath>      // std::rint
+#include <cstring>    // std::memcpy
+#include <type_traits>
 
 #include "common.hpp"
+#include "simd.hpp"
 
 namespace adrt {
 
@@ -9,9 +13,15 @@ template <typename Scalar>
 static inline void add(Scalar *A_RESTRICT dst, Scalar const *A_RESTRICT src0,
                        Scalar const *A_RESTRICT src1, int const width) {
   A_NEVER(width < 0);
-  for (int i = 0; i != width; ++i) {
-    dst[i] = src0[i] + src1[i];
-  }
+  simd::add(dst, src0, src1, width, simd::active_isa());
+}
+
+// dst += src * weight
+template <typename Scalar>
+static inline void add_scaled(Scalar *A_RESTRICT dst,
+                              Scalar const *A_RESTRICT src, Scalar weight,
+                              int const width) {
+  simd::add_scaled(dst, src, weight, width, simd::active_isa());
 }
 
 template <typename Scalar>
@@ -25,6 +35,25 @@ static inline void add_with_2nd_shifted(Scalar *A_RESTRICT dst,
   add(dst + shift, src0 + shift, src1, split);
 }
 
+// dst += src. `add` can't be called with `dst` as `src0`, its pointers are
+// restrict, the kernels it dispatches to allow it
+template <typename Scalar>
+static inline void accumulate(Scalar *dst, Scalar const *src,
+                              int const width) {
+  A_NEVER(width < 0);
+  simd::add(dst, dst, src, width, simd::active_isa());
+}
+
+// dst[x] += src[x - shift], cyclic in `width`
+template <typename Scalar>
+static inline void accumulate_shifted(Scalar *dst, Scalar const *src,
+                                      int const width, int const shift) {
+  A_NEVER(width <= 0 || shift > width);
+  int const split = width - shift;
+  accumulate(dst, src + split, shift);
+  accumulate(dst + shift, src, split);
+}
+
 template <typename Scalar>
 static inline void rotate(Scalar *A_RESTRICT dst, Scalar *A_RESTRICT src,
                           int width, int rotation) {
@@ -34,23 +63,134 @@ static inline void rotate(Scalar *A_RESTRICT dst, Scalar *A_RESTRICT src,
   std::memcpy(dst + rotation, src, split * sizeof(Scalar));
 }
 
+// dst = src converted to the accumulator type, a copy when they match and
+// nothing when `dst` is `src`, as in transforms done in place
+template <typename Scalar, typename Input>
+static inline void widen_row(Scalar *A_RESTRICT dst,
+                             Input const *A_RESTRICT src, int width) {
+  if constexpr (std::is_same_v<Scalar, Input>) {
+    if (dst != src) {
+      std::memcpy(dst, src, width * sizeof(Scalar));
+    }
+  } else {
+    for (int x = 0; x != width; ++x) {
+      dst[x] = static_cast<Scalar>(src[x]);
+    }
+  }
+}
+
+// dst = src^T, walked in square blocks so that both the rows being read and
+// the rows being written stay in cache
+template <typename Scalar>
+static inline void transpose_tensor(Tensor2DTyped<Scalar> const &dst,
+                                    Tensor2DTyped<Scalar> const &src) {
+  A_NEVER(dst.height != src.width || dst.width != src.height);
+  constexpr int block = 32;
+  for (int y0 = 0; y0 < src.height; y0 += block) {
+    int const y1 = std::min(y0 + block, static_cast<int>(src.height));
+    for (int x0 = 0; x0 < src.width; x0 += block) {
+      int const x1 = std::min(x0 + block, static_cast<int>(src.width));
+      for (int x = x0; x != x1; ++x) {
+        Scalar *line = A_LINE(dst, x);
+        for (int y = y0; y != y1; ++y) {
+          line[y] = A_LINE(src, y)[x];
+        }
+      }
+    }
+  }
+}
+
+// Elements of `line1` are read through a stack tile of this size when the
+// cyclically shifted source is closer to the destination than this
+static constexpr int shifted_add_tile = 512;
+
+// In-place butterfly without rotating `line1` into a full line buffer:
+//   line1[j] = line0[j] + line1[(j + p + d1) % width]
+//   line0[j] = line0[j] + line1[(j + p + d0) % width]  (when `Both`)
+// where {d1, d0} = {0, 1}. Only the part of `line1` that wraps around is
+// saved into `buffer`, that is at most width / 2 + 2 elements. The rest
+// of the line is walked away from the wrap point, so every source element
+// is read before it is overwritten.
+template <typename Scalar, bool Both>
+static inline void shifted_butterfly(Scalar *A_RESTRICT line0,
+                                     Scalar *A_RESTRICT line1,
+                                     Scalar *A_RESTRICT buffer, int const width,
+                                     int const p, int const d1) {
+  A_NEVER(width <= 0 || p < 0 || p >= width || (d1 != 0 && d1 != 1));
+  int const d0 = 1 - d1;
+  if A_UNLIKELY (width == 1) {
+    Scalar const v0 = line0[0];
+    Scalar const v1 = line1[0];
+    line1[0] = v0 + v1;
+    if constexpr (Both) {
+      line0[0] = v0 + v1;
+    }
+    return;
+  }
+  auto const apply = [&](int j, int n, Scalar const *src) {
+    add(line1 + j, line0 + j, src + d1, n);
+    if constexpr (Both) {
+      accumulate(line0 + j, src + d0, n);
+    }
+  };
+  Scalar tile[shifted_add_tile + 1];
+  bool const ascending = p + 2 <= width - p + 1;
+  // the wrapped part starts at `wrap_begin` and is `wrap_size` long
+  int const wrap_begin = ascending ? width - p - 1 : 0;
+  int const wrap_size = ascending ? p + 1 : width - p;
+  int const first = (wrap_begin + p) % width;
+  int const head = std::min(wrap_size + 1, width - first);
+  std::memcpy(buffer, line1 + first, head * sizeof(Scalar));
+  std::memcpy(buffer + head, line1, (wrap_size + 1 - head) * sizeof(Scalar));
+
+  if (ascending) {
+    // sources are ahead of destinations by `p`
+    int const end = width - p - 1;
+    int const chunk = std::max(p, shifted_add_tile);
+    for (int j = 0; j < end; j += chunk) {
+      int const n = std::min(chunk, end - j);
+      Scalar const *src = line1 + j + p;
+      if (p < n) {
+        std::memcpy(tile, src, (n + 1) * sizeof(Scalar));
+        src = tile;
+      }
+      apply(j, n, src);
+    }
+  } else {
+    // sources are behind destinations by `width - p`
+    int const q = width - p - 1;
+    int const chunk = std::max(q, shifted_add_tile);
+    for (int end = width; end > q + 1;) {
+      int const n = std::min(chunk, end - (q + 1));
+      int const j = end - n;
+      Scalar const *src = line1 + j - q - 1;
+      if (q < n) {
+        std::memcpy(tile, src, (n + 1) * sizeof(Scalar));
+        src = tile;
+      }
+      apply(j, n, src);
+      end = j;
+    }
+  }
+  apply(wrap_begin, wrap_size, buffer);
+}
+
+// `buffer` must hold at least width / 2 + 2 elements
 template <typename Scalar>
 static inline void ProcessPair(Scalar *A_RESTRICT line0,
                                Scalar *A_RESTRICT line1,
                                Scalar *A_RESTRICT buffer, int width, Sign sign,
                                int shift1) {
   A_NEVER(width <= 0 || shift1 < 0);
-  rotate(buffer, line1, width, shift1);
-  add(line1, line0, buffer, width);
-
+  int const s = shift1 % width;
   if (sign == Sign::Positive) {
-    // do shift -1
-    add(line0, line0, buffer + 1, width - 1);
-    add(line0 + width - 1, line0 + width - 1, buffer, 1);
+    // line1 += line0 shifted by shift1, line0 by shift1 - 1
+    shifted_butterfly<Scalar, true>(line0, line1, buffer, width,
+                                    (width - s) % width, 0);
   } else {
-    // do shift +1
-    add(line0, line0, buffer + width - 1, 1);
-    add(line0 + 1, line0 + 1, buffer, width - 1);
+    // line1 += line0 shifted by shift1, line0 by shift1 + 1
+    shifted_butterfly<Scalar, true>(line0, line1, buffer, width,
+                                    width - s - 1, 1);
   }
 }
 
@@ -58,19 +198,23 @@ template <typename Scalar>
 static inline void ProcessLineAndSaveT(Scalar *A_RESTRICT line0,
                                        Scalar const *A_RESTRICT line1,
                                        int const width, int const shift) {
-  add_with_2nd_shifted(line0, line0, line1, width, shift);
+  accumulate_shifted(line0, line1, width, shift);
 }
 
 template <typename Scalar>
-static inline void ProcessLineWithoutSavingT(Scalar const *A_RESTRICT line0,
+static inline void ProcessLineWithoutSavingT(Scalar *A_RESTRICT line0,
                                              Scalar *A_RESTRICT line1,
                                              Scalar *A_RESTRICT buffer,
                                              int const width, int const shift) {
-  rotate(buffer, line1, width, shift);
-  add(line1, line0, buffer, width);
+  A_NEVER(width <= 0 || shift < 0);
+  shifted_butterfly<Scalar, false>(line0, line1, buffer, width,
+                                   (width - shift % width) % width, 0);
 }
 
+// cyclic shift by `value` in direction `sign` as a shift in [0, width)
 static inline int apply_sign(Sign sign, int value, int width) {
+  A_NEVER(value < 0 || width <= 0);
+  value %= width;
   return (sign == Sign::Positive || value == 0) ? (value) : (width - value);
 }
 
@@ -80,6 +224,12 @@ static inline double round05(double value) {
   return value - int_value > 0.5 ? (int_value + 1.0) : int_value;
 };
 
+// `round` of python rounds half to even, as `rint` does in the default
+// rounding mode
+static inline int round_half_even(double value) {
+  return static_cast<int>(std::rint(value));
+}
+
 static inline uint32_t div_by_pow2(uint32_t n) {
   if ((n & (n - 1)) == 0) {
     return n >> 1;
@@ -1,8 +1,14 @@
-#include <cmath>   // round
-#include <memory>  // std::unique_ptr
+#pragma once
+#include <algorithm>  // std::push_heap, std::pop_heap, std::sort_heap
+#include <cmath>      // round
+#include <memory>     // std::unique_ptr
+#include <mutex>
+#include <type_traits>
+#include <vector>
 
 #include "common_algorithms.hpp"
 #include "non_recursive.hpp"
+#include "thread_pool.hpp"
 
 namespace adrt {
 
@@ -23,12 +29,14 @@ struct Slice {
   uint_fast32_t height() const { return this->end - this->begin; }
 };
 
+// computes output rows [t_begin, t_end) of the merge step
 template <typename Scalar>
 static inline void fht2ds_core(Tensor2DTyped<Scalar> const &dst,
                                Tensor2DTyped<Scalar> const &src, int const h,
                                Sign sign, Slice const &slice_T,
-                               Slice const &slice_B) {
-  A_NEVER(h < 2);
+                               Slice const &slice_B, int const t_begin,
+                               int const t_end) {
+  A_NEVER(h < 2 || t_begin < 0 || t_end > h);
   int const width = src.width;
   double const h_double = static_cast<double>(h);
   double const r0 =
@@ -36,7 +44,7 @@ static inline void fht2ds_core(Tensor2DTyped<Scalar> const &dst,
   double const r1 =
       (static_cast<double>(slice_B.height()) - 1.0) / (h_double - 1.0);
 
-  for (int t = 0; t != h; ++t) {
+  for (int t = t_begin; t < t_end; ++t) {
     double const t0 = round05(t * r0);
     double const t1 = round05(t * r1);
     int const shift = apply_sign(sign, t - t1, width);
@@ -46,6 +54,14 @@ static inline void fht2ds_core(Tensor2DTyped<Scalar> const &dst,
   }
 }
 
+template <typename Scalar>
+static inline void fht2ds_core(Tensor2DTyped<Scalar> const &dst,
+                               Tensor2DTyped<Scalar> const &src, int const h,
+                               Sign sign, Slice const &slice_T,
+                               Slice const &slice_B) {
+  fht2ds_core(dst, src, h, sign, slice_T, slice_B, 0, h);
+}
+
 template <typename Scalar, typename MidCallback>
 void fht2ds_recursive_(Tensor2DTyped<Scalar> const &dst,
                        Tensor2DTyped<Scalar> const &src, Slice const &slice,
@@ -68,7 +84,14 @@ void fht2ds_recursive_(Tensor2DTyped<Scalar> const &dst,
   }
 }
 
-template <typename Scalar, typename MidCallback>
+// `MidCallback` overloads are only picked for callables, a `MergePlan` goes
+// to the tabulated ones, which may also widen their input
+template <typename MidCallback>
+using if_mid_callback =
+    std::enable_if_t<std::is_invocable_v<MidCallback, uint_fast32_t>, int>;
+
+template <typename Scalar, typename MidCallback,
+          if_mid_callback<MidCallback> = 0>
 void fht2d_recursive(Tensor2DTyped<Scalar> const &dst,
                      Tensor2DTyped<Scalar> const &src,
                      Tensor2DTyped<Scalar> const &buffer, Sign sign,
@@ -81,7 +104,8 @@ void fht2d_recursive(Tensor2DTyped<Scalar> const &dst,
                     mid_callback);
 }
 
-template <typename Scalar, typename MidCallback>
+template <typename Scalar, typename MidCallback,
+          if_mid_callback<MidCallback> = 0>
 static inline void fht2d_non_recursive(Tensor2DTyped<Scalar> const &dst,
                                        Tensor2DTyped<Scalar> const &src,
                                        Tensor2DTyped<Scalar> const &buffer,
@@ -113,47 +137,1021 @@ static inline void fht2d_non_recursive(Tensor2DTyped<Scalar> const &dst,
       mid_callback);
 }
 
+// One output row of a merge step: `dst[row] = src[src_T] + shifted
+// src[src_B]`, shifts are already reduced for both signs
+struct MergeRow {
+  int row;
+  int src_T;
+  int src_B;
+  int shift_positive;
+  int shift_negative;
+};
+
+struct MergeStep {
+  int rows_begin;  // [rows_begin, rows_end) in `MergePlan::rows`
+  int rows_end;
+  int level;    // parity selects the direction of the merge
+  int child_T;  // index of the step producing the top half, -1 for none
+  int child_B;
+};
+
+// Mid rules of `ds` and `dt`: the top half of `val` rows is `val / 2` rows
+// for `ds` and the largest power of two below `val` for `dt`
+static constexpr auto ds_mid = [](auto val) { return val / 2; };
+static constexpr auto dt_mid = [](auto val) {
+  return static_cast<int>(div_by_pow2(static_cast<uint32_t>(val)));
+};
+
+//
+// Execution plan of the merge tree for one image shape and one mid rule.
+// `round05` and `apply_sign` results do not depend on pixel data, so they
+// are tabulated once. Steps are stored in post-order: executing them one by
+// one is the non-recursive transform, following `child_T` and `child_B` from
+// the last step is the recursive one.
+//
+struct MergePlan {
+  int height{};
+  int width{};
+  std::vector<MergeRow> rows;
+  std::vector<MergeStep> steps;
+
+  template <typename MidCallback>
+  static MergePlan create(int height, int width, MidCallback mid_callback) {
+    MergePlan plan;
+    plan.height = height;
+    plan.width = width;
+    if (height > 1 && width > 0) {
+      plan.add_steps(Slice{0, static_cast<uint_fast32_t>(height)}, 0,
+                     mid_callback);
+    }
+    return plan;
+  }
+
+  int root() const { return static_cast<int>(this->steps.size()) - 1; }
+
+  bool matches(int height, int width) const {
+    return this->height == height && this->width == width;
+  }
+
+  // first step of the subtree of `step_idx`, its steps are
+  // [subtree_begin(step_idx), step_idx]
+  int subtree_begin(int step_idx) const {
+    for (;;) {
+      MergeStep const &step = this->steps[step_idx];
+      if (step.child_T >= 0) {
+        step_idx = step.child_T;
+      } else if (step.child_B >= 0) {
+        step_idx = step.child_B;
+      } else {
+        return step_idx;
+      }
+    }
+  }
+
+ private:
+  template <typename MidCallback>
+  int add_steps(Slice const &slice, int level, MidCallback mid_callback) {
+    auto const height = slice.height();
+    if (height <= 1) {
+      return -1;
+    }
+    auto const h_T = mid_callback(height);
+    Slice const slice_T{slice.top(h_T)};
+    Slice const slice_B{slice.bottom(h_T)};
+    MergeStep step;
+    step.child_T = this->add_steps(slice_T, level + 1, mid_callback);
+    step.child_B = this->add_steps(slice_B, level + 1, mid_callback);
+    step.level = level;
+    step.rows_begin = static_cast<int>(this->rows.size());
+
+    int const h = static_cast<int>(height);
+    double const h_double = static_cast<double>(h);
+    double const r0 =
+        (static_cast<double>(slice_T.height()) - 1.0) / (h_double - 1.0);
+    double const r1 =
+        (static_cast<double>(slice_B.height()) - 1.0) / (h_double - 1.0);
+    for (int t = 0; t < h; ++t) {
+      int const t0 = static_cast<int>(round05(t * r0));
+      int const t1 = static_cast<int>(round05(t * r1));
+      this->rows.push_back(MergeRow{
+          static_cast<int>(slice_T.begin) + t,
+          static_cast<int>(slice_T.begin) + t0,
+          static_cast<int>(slice_B.begin) + t1,
+          apply_sign(Sign::Positive, t - t1, this->width),
+          apply_sign(Sign::Negative, t - t1, this->width)});
+    }
+    step.rows_end = static_cast<int>(this->rows.size());
+    this->steps.push_back(step);
+    return static_cast<int>(this->steps.size()) - 1;
+  }
+};
+
+// `fht2ds_core` on tabulated rows
+template <typename Scalar>
+static inline void fht2ds_core(Tensor2DTyped<Scalar> const &dst,
+                               Tensor2DTyped<Scalar> const &src,
+                               MergeRow const *begin, MergeRow const *end,
+                               Sign sign) {
+  int const width = src.width;
+  if (sign == Sign::Positive) {
+    for (MergeRow const *row = begin; row != end; ++row) {
+      add_with_2nd_shifted(A_LINE(dst, row->row), A_LINE(src, row->src_T),
+                           A_LINE(src, row->src_B), width,
+                           row->shift_positive);
+    }
+  } else {
+    for (MergeRow const *row = begin; row != end; ++row) {
+      add_with_2nd_shifted(A_LINE(dst, row->row), A_LINE(src, row->src_T),
+                           A_LINE(src, row->src_B), width,
+                           row->shift_negative);
+    }
+  }
+}
+
+template <typename Scalar>
+static inline void fht2ds_step(Tensor2DTyped<Scalar> const &dst,
+                               Tensor2DTyped<Scalar> const &buffer,
+                               MergePlan const &plan, MergeStep const &step,
+                               Sign sign) {
+  MergeRow const *rows = plan.rows.data();
+  if ((step.level & 1) == 0) {
+    fht2ds_core(dst, buffer, rows + step.rows_begin, rows + step.rows_end,
+                sign);
+  } else {
+    fht2ds_core(buffer, dst, rows + step.rows_begin, rows + step.rows_end,
+                sign);
+  }
+}
+
+template <typename Scalar>
+void fht2ds_recursive_(Tensor2DTyped<Scalar> const &dst,
+                       Tensor2DTyped<Scalar> const &buffer,
+                       MergePlan const &plan, int step_idx, Sign sign) {
+  MergeStep const &step = plan.steps[step_idx];
+  if (step.child_T >= 0) {
+    fht2ds_recursive_(dst, buffer, plan, step.child_T, sign);
+  }
+  if (step.child_B >= 0) {
+    fht2ds_recursive_(dst, buffer, plan, step.child_B, sign);
+  }
+  fht2ds_step(dst, buffer, plan, step, sign);
+}
+
+// leaf rows of `step` from `src`, into the tensor the step reads
+template <typename Scalar, typename Input>
+static inline void fht2d_load_step_leaves(Tensor2DTyped<Scalar> const &dst,
+                                          Tensor2DTyped<Scalar> const &buffer,
+                                          Tensor2DTyped<Input> const &src,
+                                          MergePlan const &plan,
+                                          MergeStep const &step) {
+  int const width = src.width;
+  Tensor2DTyped<Scalar> const &in = (step.level & 1) == 0 ? buffer : dst;
+  MergeRow const &first = plan.rows[step.rows_begin];
+  if (step.child_T < 0) {
+    widen_row(A_LINE(in, first.src_T), A_LINE(src, first.src_T), width);
+  }
+  if (step.child_B < 0) {
+    widen_row(A_LINE(in, first.src_B), A_LINE(src, first.src_B), width);
+  }
+}
+
+//
+// Every row of `src` is a leaf of the merge tree and is read by one step
+// only, from `buffer` when the step is at an even level and from `dst`
+// otherwise. Rows are converted to `Scalar` straight into that tensor, so a
+// narrow input is read once and never stored widened in full.
+//
+template <typename Scalar, typename Input>
+static inline void fht2d_load_leaves(Tensor2DTyped<Scalar> const &dst,
+                                     Tensor2DTyped<Scalar> const &buffer,
+                                     Tensor2DTyped<Input> const &src,
+                                     MergePlan const &plan) {
+  int const width = src.width;
+  if A_UNLIKELY (plan.root() < 0) {
+    for (int y = 0; y != src.height; ++y) {
+      widen_row(A_LINE(dst, y), A_LINE(src, y), width);
+    }
+    return;
+  }
+  for (MergeStep const &step : plan.steps) {
+    fht2d_load_step_leaves(dst, buffer, src, plan, step);
+  }
+}
+
+template <typename Scalar, typename Input>
+void fht2d_recursive(Tensor2DTyped<Scalar> const &dst,
+                     Tensor2DTyped<Input> const &src,
+                     Tensor2DTyped<Scalar> const &buffer, Sign sign,
+                     MergePlan const &plan) {
+  A_NEVER(!plan.matches(src.height, src.width));
+  fht2d_load_leaves(dst, buffer, src, plan);
+  if (plan.root() >= 0) {
+    fht2ds_recursive_(dst, buffer, plan, plan.root(), sign);
+  }
+}
+
+template <typename Scalar, typename Input>
+static inline void fht2d_non_recursive(Tensor2DTyped<Scalar> const &dst,
+                                       Tensor2DTyped<Input> const &src,
+                                       Tensor2DTyped<Scalar> const &buffer,
+                                       Sign sign, MergePlan const &plan) {
+  A_NEVER(!plan.matches(src.height, src.width));
+  fht2d_load_leaves(dst, buffer, src, plan);
+  for (MergeStep const &step : plan.steps) {
+    fht2ds_step(dst, buffer, plan, step, sign);
+  }
+}
+
+// `fht2d_load_leaves` with steps split between threads, a step has at most
+// two leaves
+template <typename Scalar, typename Input>
+static inline void fht2d_load_leaves(Tensor2DTyped<Scalar> const &dst,
+                                     Tensor2DTyped<Scalar> const &buffer,
+                                     Tensor2DTyped<Input> const &src,
+                                     MergePlan const &plan,
+                                     Parallel const &parallel) {
+  if A_UNLIKELY (plan.root() < 0) {
+    fht2d_load_leaves(dst, buffer, src, plan);
+    return;
+  }
+  int const num_steps = static_cast<int>(plan.steps.size());
+  parallel_for(*parallel.pool, 0, num_steps,
+               std::max(1, parallel.rows_grain(src.width) / 2),
+               [&](int begin, int end) {
+                 for (int idx = begin; idx != end; ++idx) {
+                   fht2d_load_step_leaves(dst, buffer, src, plan,
+                                          plan.steps[idx]);
+                 }
+               });
+}
+
+// `fht2ds_step` split between threads by ranges of `t`
+template <typename Scalar>
+static inline void fht2ds_step(Tensor2DTyped<Scalar> const &dst,
+                               Tensor2DTyped<Scalar> const &buffer,
+                               MergePlan const &plan, MergeStep const &step,
+                               Sign sign, Parallel const &parallel) {
+  MergeRow const *rows = plan.rows.data() + step.rows_begin;
+  auto const &merge_dst = (step.level & 1) == 0 ? dst : buffer;
+  auto const &merge_src = (step.level & 1) == 0 ? buffer : dst;
+  parallel_for(*parallel.pool, 0, step.rows_end - step.rows_begin,
+               parallel.rows_grain(dst.width), [&](int t_begin, int t_end) {
+                 fht2ds_core(merge_dst, merge_src, rows + t_begin,
+                             rows + t_end, sign);
+               });
+}
+
+// Same as `fht2ds_recursive_`, but subtrees higher than
+// `parallel.cutoff_height` run as pool tasks and their merge steps are
+// split between threads by ranges of `t`
+template <typename Scalar>
+void fht2ds_parallel_(Tensor2DTyped<Scalar> const &dst,
+                      Tensor2DTyped<Scalar> const &buffer,
+                      MergePlan const &plan, int step_idx, Sign sign,
+                      Parallel const &parallel) {
+  MergeStep const &step = plan.steps[step_idx];
+  if (step.rows_end - step.rows_begin <= std::max(parallel.cutoff_height, 1)) {
+    fht2ds_recursive_(dst, buffer, plan, step_idx, sign);
+    return;
+  }
+  {
+    TaskGroup group{*parallel.pool};
+    if (step.child_T >= 0) {
+      group.run([&] {
+        fht2ds_parallel_(dst, buffer, plan, step.child_T, sign, parallel);
+      });
+    }
+    if (step.child_B >= 0) {
+      fht2ds_parallel_(dst, buffer, plan, step.child_B, sign, parallel);
+    }
+    group.wait();
+  }
+  fht2ds_step(dst, buffer, plan, step, sign, parallel);
+}
+
+template <typename Scalar, typename Input>
+void fht2d_parallel(Tensor2DTyped<Scalar> const &dst,
+                    Tensor2DTyped<Input> const &src,
+                    Tensor2DTyped<Scalar> const &buffer, Sign sign,
+                    MergePlan const &plan, Parallel const &parallel) {
+  A_NEVER(!plan.matches(src.height, src.width));
+  fht2d_load_leaves(dst, buffer, src, plan, parallel);
+  if (plan.root() >= 0) {
+    fht2ds_parallel_(dst, buffer, plan, plan.root(), sign, parallel);
+  }
+}
+
+//
+// Steps of a merge plan grouped by level, deepest first. Steps of one level
+// write disjoint rows of one tensor, so they may run concurrently once every
+// deeper step is done.
+//
+struct MergeLevels {
+  std::vector<int> steps;    // deepest level first, post-order inside
+  std::vector<int> offsets;  // level `idx` is [offsets[idx], offsets[idx+1])
+
+  static MergeLevels create(MergePlan const &plan) {
+    int depth = 0;
+    for (MergeStep const &step : plan.steps) {
+      depth = std::max(depth, step.level + 1);
+    }
+    MergeLevels levels;
+    levels.offsets.emplace_back(0);
+    for (int level = depth - 1; level >= 0; --level) {
+      for (int idx = 0; idx != static_cast<int>(plan.steps.size()); ++idx) {
+        if (plan.steps[idx].level == level) {
+          levels.steps.emplace_back(idx);
+        }
+      }
+      levels.offsets.emplace_back(static_cast<int>(levels.steps.size()));
+    }
+    return levels;
+  }
+
+  int num_levels() const { return static_cast<int>(this->offsets.size()) - 1; }
+};
+
+// Level-synchronous version of `fht2d_non_recursive`: steps of one level run
+// concurrently and every step is split by ranges of `t`. `levels` are those
+// of `plan`.
+template <typename Scalar, typename Input>
+static inline void fht2d_non_recursive_parallel(
+    Tensor2DTyped<Scalar> const &dst, Tensor2DTyped<Input> const &src,
+    Tensor2DTyped<Scalar> const &buffer, Sign sign, MergePlan const &plan,
+    MergeLevels const &levels, Parallel const &parallel) {
+  A_NEVER(!plan.matches(src.height, src.width) ||
+          levels.steps.size() != plan.steps.size());
+  fht2d_load_leaves(dst, buffer, src, plan, parallel);
+  for (int level = 0; level != levels.num_levels(); ++level) {
+    parallel_for(*parallel.pool, levels.offsets[level],
+                 levels.offsets[level + 1], 1, [&](int begin, int end) {
+                   for (int idx = begin; idx != end; ++idx) {
+                     fht2ds_step(dst, buffer, plan,
+                                 plan.steps[levels.steps[idx]], sign,
+                                 parallel);
+                   }
+                 });
+  }
+}
+
+//
+// Transpose of a merge step: `fht2ds_core` adds a top row and a shifted
+// bottom row into every row of the step, here every row of the step is split
+// back into both of them. Consecutive rows of the step hit the same child
+// rows, so the first hit writes a child row and the others add to it. Shifts
+// are those of the opposite sign. Row `r` of the step is read from row
+// `src_rows[r]` of `src` when `src_rows` is given.
+//
+template <typename Scalar>
+static inline void fht2ds_adjoint_core(Tensor2DTyped<Scalar> const &dst,
+                                       Tensor2DTyped<Scalar> const &src,
+                                       int const src_rows[],
+                                       MergeRow const *begin,
+                                       MergeRow const *end, Sign sign) {
+  int const width = src.width;
+  int last_T = -1, last_B = -1;
+  for (MergeRow const *row = begin; row != end; ++row) {
+    Scalar *line =
+        A_LINE(src, src_rows == nullptr ? row->row : src_rows[row->row]);
+    int const shift =
+        sign == Sign::Positive ? row->shift_negative : row->shift_positive;
+    Scalar *line_T = A_LINE(dst, row->src_T);
+    Scalar *line_B = A_LINE(dst, row->src_B);
+    if (row->src_T != last_T) {
+      std::memcpy(line_T, line, width * sizeof(Scalar));
+      last_T = row->src_T;
+    } else {
+      accumulate(line_T, line, width);
+    }
+    if (row->src_B != last_B) {
+      rotate(line_B, line, width, shift);
+      last_B = row->src_B;
+    } else {
+      accumulate_shifted(line_B, line, width, shift);
+    }
+  }
+}
+
+//
+// Transpose of `fht2d_non_recursive`: steps run in reverse, so every step
+// runs before the steps of its children and moves data one level down. The
+// root reads `src` directly, a row that is a leaf below an even level lands
+// in `buffer` and is moved to `dst`.
+//
+template <typename Scalar>
+static inline void fht2d_adjoint(Tensor2DTyped<Scalar> const &dst,
+                                 Tensor2DTyped<Scalar> const &src,
+                                 Tensor2DTyped<Scalar> const &buffer,
+                                 Sign sign, MergePlan const &plan,
+                                 int const src_rows[]) {
+  A_NEVER(!plan.matches(src.height, src.width));
+  if A_UNLIKELY (plan.root() < 0) {
+    copy_tensor(dst, src, sizeof(Scalar));
+    return;
+  }
+  MergeRow const *rows = plan.rows.data();
+  size_t const line_size = src.width * sizeof(Scalar);
+  for (int step_idx = plan.root(); step_idx >= 0; --step_idx) {
+    MergeStep const &step = plan.steps[step_idx];
+    bool const even = (step.level & 1) == 0;
+    Tensor2DTyped<Scalar> const &out = even ? buffer : dst;
+    if (step_idx == plan.root()) {
+      fht2ds_adjoint_core(out, src, src_rows, rows + step.rows_begin,
+                          rows + step.rows_end, sign);
+    } else {
+      fht2ds_adjoint_core(out, even ? dst : buffer, nullptr,
+                          rows + step.rows_begin, rows + step.rows_end, sign);
+    }
+    if (even) {
+      MergeRow const &first = rows[step.rows_begin];
+      if (step.child_T < 0) {
+        std::memcpy(A_LINE(dst, first.src_T), A_LINE(buffer, first.src_T),
+                    line_size);
+      }
+      if (step.child_B < 0) {
+        std::memcpy(A_LINE(dst, first.src_B), A_LINE(buffer, first.src_B),
+                    line_size);
+      }
+    }
+  }
+}
+
+// cell (t, x) of a transform
+template <typename Scalar>
+struct HoughPeak {
+  Scalar value;
+  int t;
+  int x;
+};
+
+// greater values first, then lower rows and columns
+template <typename Scalar>
+static inline bool stronger(HoughPeak<Scalar> const &a,
+                            HoughPeak<Scalar> const &b) {
+  if (a.value != b.value) {
+    return a.value > b.value;
+  }
+  return a.t != b.t ? a.t < b.t : a.x < b.x;
+}
+
+//
+// Steps of the subtree of `step_idx`, a child of the root, whose rows start
+// at `row0`. Rows of odd levels are in `buffer` as usual, those of even
+// levels in `scratch` from its first row, so both children of the root
+// share `scratch` when they run one after the other.
+//
+template <typename Scalar, typename Input>
+static inline void fht2ds_root_child_(Tensor2DTyped<Scalar> const &buffer,
+                                      Tensor2DTyped<Scalar> const &scratch,
+                                      Tensor2DTyped<Input> const &src,
+                                      Sign sign, MergePlan const &plan,
+                                      int step_idx, int row0) {
+  int const width = src.width;
+  auto const line = [&](int level, int row) {
+    return (level & 1) == 0 ? A_LINE(scratch, row - row0)
+                            : A_LINE(buffer, row);
+  };
+  for (int idx = plan.subtree_begin(step_idx); idx <= step_idx; ++idx) {
+    MergeStep const &step = plan.steps[idx];
+    MergeRow const *const begin = plan.rows.data() + step.rows_begin;
+    MergeRow const *const end = plan.rows.data() + step.rows_end;
+    if (step.child_T < 0) {
+      widen_row(line(step.level + 1, begin->src_T), A_LINE(src, begin->src_T),
+                width);
+    }
+    if (step.child_B < 0) {
+      widen_row(line(step.level + 1, begin->src_B), A_LINE(src, begin->src_B),
+                width);
+    }
+    for (MergeRow const *row = begin; row != end; ++row) {
+      add_with_2nd_shifted(
+          line(step.level, row->row), line(step.level + 1, row->src_T),
+          line(step.level + 1, row->src_B), width,
+          sign == Sign::Positive ? row->shift_positive : row->shift_negative);
+    }
+  }
+}
+
+//
+// Cells of root rows [t_begin, t_end) into the bounded heap `peaks`. Root
+// rows from `radius` rows before to `radius` rows after the range are
+// merged from `buffer` into a ring of the last `ring.height` of them, a
+// row leaves the ring through the heap once its neighbourhood is complete.
+// Without a root `ring` holds the single row of the image.
+//
+template <typename Scalar>
+static inline void fht2d_top_k_rows_(std::vector<HoughPeak<Scalar>> &peaks,
+                                     Tensor2DTyped<Scalar> const &buffer,
+                                     Tensor2DTyped<Scalar> const &ring,
+                                     Sign sign, MergePlan const &plan,
+                                     size_t k, int radius, int t_begin,
+                                     int t_end) {
+  int const height = plan.height;
+  int const width = plan.width;
+  auto const line = [&](int t) { return A_LINE(ring, t % ring.height); };
+  MergeRow const *root_rows = nullptr;
+  if (plan.root() >= 0) {
+    root_rows = plan.rows.data() + plan.steps[plan.root()].rows_begin;
+  }
+  int const columns = std::min(2 * radius + 1, width);
+  auto const push = [&](int t) {
+    Scalar const *row = line(t);
+    bool full = peaks.size() == k;
+    Scalar threshold = full ? peaks.front().value : Scalar{};
+    for (int x = 0;; ++x) {
+      if (full) {
+        // the usual case, cells weaker than the weakest of a full heap
+        while (x != width && row[x] < threshold) {
+          ++x;
+        }
+      }
+      if (x == width) {
+        break;
+      }
+      HoughPeak<Scalar> const peak{row[x], t, x};
+      if (full && !stronger(peak, peaks.front())) {
+        continue;
+      }
+      bool is_peak = true;
+      for (int y = std::max(0, t - radius);
+           is_peak && y <= std::min(height - 1, t + radius); ++y) {
+        Scalar const *neighbours = line(y);
+        for (int dx = -(columns / 2); dx != columns - columns / 2; ++dx) {
+          int const nx = ((x + dx) % width + width) % width;
+          if ((y != t || nx != x) &&
+              stronger(HoughPeak<Scalar>{neighbours[nx], y, nx}, peak)) {
+            is_peak = false;
+            break;
+          }
+        }
+      }
+      if (!is_peak) {
+        continue;
+      }
+      if (peaks.size() == k) {
+        std::pop_heap(peaks.begin(), peaks.end(), stronger<Scalar>);
+        peaks.back() = peak;
+      } else {
+        peaks.push_back(peak);
+      }
+      std::push_heap(peaks.begin(), peaks.end(), stronger<Scalar>);
+      full = peaks.size() == k;
+      threshold = peaks.front().value;
+    }
+  };
+  int const merge_end = std::min(height, t_end + radius);
+  for (int t = std::max(0, t_begin - radius); t != merge_end; ++t) {
+    if (root_rows != nullptr) {
+      MergeRow const &row = root_rows[t];
+      add_with_2nd_shifted(line(t), A_LINE(buffer, row.src_T),
+                           A_LINE(buffer, row.src_B), width,
+                           sign == Sign::Positive ? row.shift_positive
+                                                  : row.shift_negative);
+    }
+    if (t - radius >= t_begin) {
+      push(t - radius);
+    }
+  }
+  // rows whose neighbourhood ends at the last row
+  for (int t = std::max(t_begin, merge_end - radius); t < t_end; ++t) {
+    push(t);
+  }
+}
+
+// rows of the `scratch` of `fht2d_top_k`: the larger child of the root, or
+// the ring when it is larger
+static inline int fht2d_top_k_rows(MergePlan const &plan, int radius) {
+  int rows = std::min(2 * radius + 1, std::max(plan.height, 1));
+  if (plan.root() >= 0) {
+    MergeStep const &root = plan.steps[plan.root()];
+    for (int child : {root.child_T, root.child_B}) {
+      if (child >= 0) {
+        MergeStep const &step = plan.steps[child];
+        rows = std::max(rows, step.rows_end - step.rows_begin);
+      }
+    }
+  }
+  return rows;
+}
+
+//
+// `k` strongest cells of the transform, strongest first, without the
+// transform image. The two children of the root run one after the other
+// and leave their rows in `buffer`, their even levels share `scratch` of
+// `fht2d_top_k_rows` rows. Then every root row is merged into a ring of
+// the last `2 * radius + 1` root rows, which takes the first rows of
+// `scratch`, and leaves it through a bounded heap of `k` cells.
+//
+// With `radius > 0` a cell is kept only if it is stronger than every cell
+// within `radius` rows and cyclic columns, which is non-maximum suppression
+// over the neighbourhood. Cells that can't enter the full heap are dropped
+// before their neighbourhood is read.
+//
+// With `parallel` root rows are split into chunks, each with its own ring
+// and heap, and the heaps are merged at the end. A chunk merges `radius`
+// rows on both sides of it again for the suppression, so chunks have at
+// least `4 * radius` rows.
+//
+template <typename Scalar, typename Input>
+static inline void fht2d_top_k(std::vector<HoughPeak<Scalar>> &peaks,
+                               Tensor2DTyped<Input> const &src,
+                               Tensor2DTyped<Scalar> const &scratch,
+                               Tensor2DTyped<Scalar> const &buffer,
+                               Sign sign, MergePlan const &plan, size_t k,
+                               int radius,
+                               Parallel const *parallel = nullptr) {
+  A_NEVER(!plan.matches(src.height, src.width) || radius < 0 ||
+          scratch.height < fht2d_top_k_rows(plan, radius));
+  peaks.clear();
+  int const height = src.height;
+  int const width = src.width;
+  if A_UNLIKELY (k == 0 || height == 0 || width == 0) {
+    return;
+  }
+  int const ring_rows = std::min(2 * radius + 1, height);
+  if (plan.root() >= 0) {
+    MergeStep const &root = plan.steps[plan.root()];
+    MergeRow const &first = plan.rows[root.rows_begin];
+    if (root.child_T >= 0) {
+      fht2ds_root_child_(buffer, scratch, src, sign, plan, root.child_T,
+                         first.src_T);
+    } else {
+      widen_row(A_LINE(buffer, first.src_T), A_LINE(src, first.src_T),
+                width);
+    }
+    if (root.child_B >= 0) {
+      fht2ds_root_child_(buffer, scratch, src, sign, plan, root.child_B,
+                         first.src_B);
+    } else {
+      widen_row(A_LINE(buffer, first.src_B), A_LINE(src, first.src_B),
+                width);
+    }
+  } else {
+    widen_row(A_LINE(scratch, 0), A_LINE(src, 0), width);
+  }
+  if (parallel == nullptr || plan.root() < 0) {
+    Tensor2D ring{scratch};
+    ring.height = ring_rows;
+    fht2d_top_k_rows_(peaks, buffer, ring.as<Scalar>(), sign, plan, k,
+                      radius, 0, height);
+  } else {
+    std::mutex mutex;
+    int const grain = std::max(4 * radius, parallel->rows_grain(width));
+    auto const chunk = [&](int t_begin, int t_end) {
+      std::unique_ptr<Scalar[]> ring_data{
+          new Scalar[static_cast<size_t>(ring_rows) * width]};
+      Tensor2D const ring{
+          ring_rows, width,
+          static_cast<Tensor2D::stride_t>(width * sizeof(Scalar)),
+          reinterpret_cast<uint8_t *>(ring_data.get())};
+      std::vector<HoughPeak<Scalar>> chunk_peaks;
+      fht2d_top_k_rows_(chunk_peaks, buffer, ring.as<Scalar>(), sign, plan,
+                        k, radius, t_begin, t_end);
+      std::lock_guard<std::mutex> lock{mutex};
+      peaks.insert(peaks.end(), chunk_peaks.begin(), chunk_peaks.end());
+    };
+    parallel_for(*parallel->pool, 0, height, grain, chunk);
+    // strongest `k` of the chunk heaps
+    if (peaks.size() > k) {
+      std::nth_element(peaks.begin(), peaks.begin() + k, peaks.end(),
+                       stronger<Scalar>);
+      peaks.resize(k);
+    }
+    std::make_heap(peaks.begin(), peaks.end(), stronger<Scalar>);
+  }
+  std::sort_heap(peaks.begin(), peaks.end(), stronger<Scalar>);
+}
+
+// Cache blocking parameters of `fht2d_tiled`
+struct Tiling {
+  int strip_width{512};  // output columns computed per strip
+  int levels{6};         // bottom tree levels computed per strip
+
+  Tiling() = default;
+  Tiling(int strip_width, int levels)
+      : strip_width{strip_width}, levels{levels} {}
+
+  bool valid() const { return this->strip_width >= 1 && this->levels >= 1; }
+
+  // height of the subtrees run per strip, at most `height`
+  int fuse_height(int height) const {
+    A_NEVER(this->levels < 1);
+    return this->levels >= 30 ? height : std::min(height, 1 << this->levels);
+  }
+};
+
+//
+// Runs the subtree of step `root` strip by strip. A strip of columns is
+// gathered from the leaf rows of `src` once, together with a halo of
+// `height - 1` columns (line shifts in a subtree never exceed that) and
+// with cyclic wrap-around at image edges, into the local row the merge
+// tables read it from. Steps of the subtree are contiguous in post-order
+// and run on the local rows while they are cache resident. Columns that
+// wrapped inside the window land in the halo and are dropped, the root of
+// the subtree writes the kept columns straight to `dst` or `buffer`.
+//
+template <typename Scalar, typename Input>
+static inline void fht2ds_strips_(Tensor2DTyped<Scalar> const &dst,
+                                  Tensor2DTyped<Scalar> const &buffer,
+                                  Tensor2DTyped<Input> const &src,
+                                  Sign sign, MergePlan const &plan, int root,
+                                  int strip_width, Scalar *local_data) {
+  MergeStep const &root_step = plan.steps[root];
+  int const first = plan.subtree_begin(root);
+  MergeRow const *const rows = plan.rows.data();
+  int const row0 = rows[root_step.rows_begin].row;
+  int const height = root_step.rows_end - root_step.rows_begin;
+  int const width = src.width;
+  int const halo = height - 1;
+  size_t const window = static_cast<size_t>(strip_width) + halo;
+  Tensor2D::stride_t const local_stride = window * sizeof(Scalar);
+  Tensor2D const local_dst{height, static_cast<int>(window), local_stride,
+                           reinterpret_cast<uint8_t *>(local_data)};
+  Tensor2D const local_buffer{
+      height, static_cast<int>(window), local_stride,
+      reinterpret_cast<uint8_t *>(local_data + height * window)};
+  auto const local = [&](int level) -> Tensor2DTyped<Scalar> const & {
+    return ((level & 1) == 0 ? local_dst : local_buffer).as<Scalar>();
+  };
+  // output column `c0` is local column `offset`
+  int const offset = sign == Sign::Positive ? halo : 0;
+
+  for (int c0 = 0; c0 < width; c0 += strip_width) {
+    int const columns = std::min(strip_width, width - c0) + halo;
+    int const begin = ((c0 - offset) % width + width) % width;
+    auto const gather = [&](Tensor2DTyped<Scalar> const &in, int row) {
+      Scalar *line = A_LINE(in, row - row0);
+      for (int k = 0, x = begin; k != columns; x = 0) {
+        int const count = std::min(columns - k, width - x);
+        widen_row(line + k, A_LINE(src, row) + x, count);
+        k += count;
+      }
+    };
+    for (int step_idx = first; step_idx <= root; ++step_idx) {
+      MergeStep const &step = plan.steps[step_idx];
+      Tensor2DTyped<Scalar> const &in = local(step.level + 1);
+      MergeRow const &first_row = rows[step.rows_begin];
+      if (step.child_T < 0) {
+        gather(in, first_row.src_T);
+      }
+      if (step.child_B < 0) {
+        gather(in, first_row.src_B);
+      }
+    }
+    Tensor2DTyped<Scalar> const &result =
+        (root_step.level & 1) == 0 ? dst : buffer;
+    int const n = columns - halo;
+    for (int step_idx = first; step_idx <= root; ++step_idx) {
+      MergeStep const &step = plan.steps[step_idx];
+      Tensor2DTyped<Scalar> const &out = local(step.level);
+      Tensor2DTyped<Scalar> const &in = local(step.level + 1);
+      MergeRow const &first_row = rows[step.rows_begin];
+      MergeRow const *const end = rows + step.rows_end;
+      for (MergeRow const *row = rows + step.rows_begin; row != end; ++row) {
+        // `t - t1` of the merge, unreduced by the image width
+        int const shift =
+            (row->row - first_row.row) - (row->src_B - first_row.src_B);
+        Scalar const *line_T = A_LINE(in, row->src_T - row0);
+        Scalar const *line_B = A_LINE(in, row->src_B - row0);
+        if (step_idx == root) {
+          // the kept columns read inside the window, no wrap-around
+          add(A_LINE(result, row->row) + c0, line_T + offset,
+              line_B + offset + (sign == Sign::Positive ? -shift : shift), n);
+        } else {
+          add_with_2nd_shifted(
+              A_LINE(out, row->row - row0), line_T, line_B, columns,
+              sign == Sign::Positive || shift == 0 ? shift : columns - shift);
+        }
+      }
+    }
+  }
+}
+
+template <typename Scalar, typename Input>
+void fht2ds_tiled_(Tensor2DTyped<Scalar> const &dst,
+                   Tensor2DTyped<Scalar> const &buffer,
+                   Tensor2DTyped<Input> const &src, Sign sign,
+                   MergePlan const &plan, int step_idx, int fuse_height,
+                   int strip_width, Scalar *local_data) {
+  MergeStep const &step = plan.steps[step_idx];
+  if (step.rows_end - step.rows_begin <= fuse_height) {
+    fht2ds_strips_(dst, buffer, src, sign, plan, step_idx, strip_width,
+                   local_data);
+    return;
+  }
+  // leaf children of a step above the strips are loaded as they are
+  Tensor2DTyped<Scalar> const &in = (step.level & 1) == 0 ? buffer : dst;
+  MergeRow const &first = plan.rows[step.rows_begin];
+  if (step.child_T >= 0) {
+    fht2ds_tiled_(dst, buffer, src, sign, plan, step.child_T, fuse_height,
+                  strip_width, local_data);
+  } else {
+    widen_row(A_LINE(in, first.src_T), A_LINE(src, first.src_T), src.width);
+  }
+  if (step.child_B >= 0) {
+    fht2ds_tiled_(dst, buffer, src, sign, plan, step.child_B, fuse_height,
+                  strip_width, local_data);
+  } else {
+    widen_row(A_LINE(in, first.src_B), A_LINE(src, first.src_B), src.width);
+  }
+  fht2ds_step(dst, buffer, plan, step, sign);
+}
+
+// Same as `fht2d_recursive`, but subtrees of up to `tiling.levels` levels
+// run strip by strip. Rows of `src` are read straight into the strips, so
+// no initial copies of the image are made.
+template <typename Scalar, typename Input>
+void fht2d_tiled(Tensor2DTyped<Scalar> const &dst,
+                 Tensor2DTyped<Input> const &src,
+                 Tensor2DTyped<Scalar> const &buffer, Sign sign,
+                 MergePlan const &plan, Tiling const &tiling) {
+  A_NEVER(!plan.matches(src.height, src.width));
+  if (!tiling.valid() || src.width <= tiling.strip_width ||
+      plan.root() < 0) {
+    fht2d_recursive(dst, src, buffer, sign, plan);
+    return;
+  }
+  int const fuse_height = tiling.fuse_height(src.height);
+  std::unique_ptr<Scalar[]> local_data{
+      new Scalar[2 * static_cast<size_t>(fuse_height) *
+                 (static_cast<size_t>(tiling.strip_width) + fuse_height - 1)]};
+  fht2ds_tiled_(dst, buffer, src, sign, plan, plan.root(), fuse_height,
+                tiling.strip_width, local_data.get());
+}
+
 template <typename Scalar>
 class d {
   Tensor2DTyped<Scalar> buffer;
   std::unique_ptr<uint8_t[]> buffer_data;
+  MergePlan ds_plan;
+  MergePlan dt_plan;
+  // level schedules of the plans for the level-synchronous overloads
+  MergeLevels ds_levels;
+  MergeLevels dt_levels;
 
  public:
-  d(Tensor2DTyped<Scalar> &&buffer, std::unique_ptr<uint8_t[]> &&buffer_data)
-      : buffer(std::move(buffer)), buffer_data{std::move(buffer_data)} {}
+  d(Tensor2DTyped<Scalar> &&buffer, std::unique_ptr<uint8_t[]> &&buffer_data,
+    MergePlan &&ds_plan, MergePlan &&dt_plan)
+      : buffer(std::move(buffer)),
+        buffer_data{std::move(buffer_data)},
+        ds_plan{std::move(ds_plan)},
+        dt_plan{std::move(dt_plan)},
+        ds_levels{MergeLevels::create(this->ds_plan)},
+        dt_levels{MergeLevels::create(this->dt_plan)} {}
 
   static d<Scalar> create(Tensor2DTyped<Scalar> const &prototype) {
     std::unique_ptr<uint8_t[]> buffer_data{
-        new uint8_t[prototype.height * prototype.width * sizeof(Scalar)]};
+        new uint8_t[static_cast<size_t>(prototype.height) * prototype.width *
+                    sizeof(Scalar)]};
     Tensor2DTyped<Scalar> buffer = prototype;
     buffer.data = buffer_data.get();
-    return d{std::move(buffer), std::move(buffer_data)};
+    buffer.stride = prototype.width * sizeof(Scalar);
+    MergePlan ds_plan{
+        MergePlan::create(prototype.height, prototype.width, ds_mid)};
+    MergePlan dt_plan{
+        MergePlan::create(prototype.height, prototype.width, dt_mid)};
+    return d{std::move(buffer), std::move(buffer_data), std::move(ds_plan),
+             std::move(dt_plan)};
+  }
+
+  // `src` may hold a narrower `Input` type (`uint8_t`, `half`, ...), its
+  // rows are widened to `Scalar` as they are loaded into the merge tree
+  template <typename Input>
+  void ds_recursive(Tensor2DTyped<Scalar> const &dst,
+                    Tensor2DTyped<Input> const &src, Sign sign) const {
+    fht2d_recursive(dst, src, this->buffer, sign, this->ds_plan);
+  }
+
+  template <typename Input>
+  void dt_recursive(Tensor2DTyped<Scalar> const &dst,
+                    Tensor2DTyped<Input> const &src, Sign sign) const {
+    fht2d_recursive(dst, src, this->buffer, sign, this->dt_plan);
+  }
+
+  template <typename Input>
+  void ds_recursive(Tensor2DTyped<Scalar> const &dst,
+                    Tensor2DTyped<Input> const &src, Sign sign,
+                    Parallel const &parallel) const {
+    fht2d_parallel(dst, src, this->buffer, sign, this->ds_plan, parallel);
+  }
+
+  template <typename Input>
+  void dt_recursive(Tensor2DTyped<Scalar> const &dst,
+                    Tensor2DTyped<Input> const &src, Sign sign,
+                    Parallel const &parallel) const {
+    fht2d_parallel(dst, src, this->buffer, sign, this->dt_plan, parallel);
   }
 
+  template <typename Input>
   void ds_recursive(Tensor2DTyped<Scalar> const &dst,
-                    Tensor2DTyped<Scalar> const &src, Sign sign) const {
-    fht2d_recursive(dst, src, this->buffer, sign,
-                    [](auto val) { return val / 2; });
+                    Tensor2DTyped<Input> const &src, Sign sign,
+                    Tiling const &tiling) const {
+    fht2d_tiled(dst, src, this->buffer, sign, this->ds_plan, tiling);
   }
 
+  template <typename Input>
   void dt_recursive(Tensor2DTyped<Scalar> const &dst,
-                    Tensor2DTyped<Scalar> const &src, Sign sign) const {
-    fht2d_recursive(dst, src, this->buffer, sign, [](auto val) {
-      return static_cast<int>(div_by_pow2(static_cast<uint32_t>(val)));
-    });
+                    Tensor2DTyped<Input> const &src, Sign sign,
+                    Tiling const &tiling) const {
+    fht2d_tiled(dst, src, this->buffer, sign, this->dt_plan, tiling);
+  }
+
+  template <typename Input>
+  void ds_non_recursive(Tensor2DTyped<Scalar> const &dst,
+                        Tensor2DTyped<Input> const &src, Sign sign) const {
+    fht2d_non_recursive(dst, src, this->buffer, sign, this->ds_plan);
+  }
+
+  template <typename Input>
+  void dt_non_recursive(Tensor2DTyped<Scalar> const &dst,
+                        Tensor2DTyped<Input> const &src, Sign sign) const {
+    fht2d_non_recursive(dst, src, this->buffer, sign, this->dt_plan);
+  }
+
+  // Transposes of `ds` and `dt`. With the `swaps` of `ids` or `idt`, row
+  // `t` is read from row `swaps[t]` of `src`, which makes them transposes of
+  // the in-place transforms.
+  void ds_adjoint(Tensor2DTyped<Scalar> const &dst,
+                  Tensor2DTyped<Scalar> const &src, Sign sign,
+                  int const swaps[] = nullptr) const {
+    fht2d_adjoint(dst, src, this->buffer, sign, this->ds_plan, swaps);
+  }
+
+  void dt_adjoint(Tensor2DTyped<Scalar> const &dst,
+                  Tensor2DTyped<Scalar> const &src, Sign sign,
+                  int const swaps[] = nullptr) const {
+    fht2d_adjoint(dst, src, this->buffer, sign, this->dt_plan, swaps);
+  }
+
+  // `k` strongest cells of `ds` or `dt`, see `fht2d_top_k`. `scratch` has
+  // the width of `src` and `ds_top_k_rows(radius)` or `dt_top_k_rows`
+  // rows, about half of its height.
+  template <typename Input>
+  std::vector<HoughPeak<Scalar>> ds_top_k(Tensor2DTyped<Input> const &src,
+                                          Tensor2DTyped<Scalar> const &scratch,
+                                          Sign sign, size_t k,
+                                          int radius = 0) const {
+    std::vector<HoughPeak<Scalar>> peaks;
+    fht2d_top_k(peaks, src, scratch, this->buffer, sign, this->ds_plan, k,
+                radius);
+    return peaks;
+  }
+
+  template <typename Input>
+  std::vector<HoughPeak<Scalar>> ds_top_k(Tensor2DTyped<Input> const &src,
+                                          Tensor2DTyped<Scalar> const &scratch,
+                                          Sign sign, size_t k, int radius,
+                                          Parallel const &parallel) const {
+    std::vector<HoughPeak<Scalar>> peaks;
+    fht2d_top_k(peaks, src, scratch, this->buffer, sign, this->ds_plan, k,
+                radius, &parallel);
+    return peaks;
+  }
+
+  template <typename Input>
+  std::vector<HoughPeak<Scalar>> dt_top_k(Tensor2DTyped<Input> const &src,
+                                          Tensor2DTyped<Scalar> const &scratch,
+                                          Sign sign, size_t k,
+                                          int radius = 0) const {
+    std::vector<HoughPeak<Scalar>> peaks;
+    fht2d_top_k(peaks, src, scratch, this->buffer, sign, this->dt_plan, k,
+                radius);
+    return peaks;
+  }
+
+  template <typename Input>
+  std::vector<HoughPeak<Scalar>> dt_top_k(Tensor2DTyped<Input> const &src,
+                                          Tensor2DTyped<Scalar> const &scratch,
+                                          Sign sign, size_t k, int radius,
+                                          Parallel const &parallel) const {
+    std::vector<HoughPeak<Scalar>> peaks;
+    fht2d_top_k(peaks, src, scratch, this->buffer, sign, this->dt_plan, k,
+                radius, &parallel);
+    return peaks;
+  }
+
+  int ds_top_k_rows(int radius) const {
+    return fht2d_top_k_rows(this->ds_plan, radius);
+  }
+
+  int dt_top_k_rows(int radius) const {
+    return fht2d_top_k_rows(this->dt_plan, radius);
   }
 
+  template <typename Input>
   void ds_non_recursive(Tensor2DTyped<Scalar> const &dst,
-                        Tensor2DTyped<Scalar> const &src, Sign sign) const {
-    fht2d_non_recursive(dst, src, this->buffer, sign,
-                        [](auto val) { return val / 2; });
+                        Tensor2DTyped<Input> const &src, Sign sign,
+                        Parallel const &parallel) const {
+    fht2d_non_recursive_parallel(dst, src, this->buffer, sign, this->ds_plan,
+                                 this->ds_levels, parallel);
   }
 
+  template <typename Input>
   void dt_non_recursive(Tensor2DTyped<Scalar> const &dst,
-                        Tensor2DTyped<Scalar> const &src, Sign sign) const {
-    fht2d_non_recursive(dst, src, this->buffer, sign, [](auto val) {
-      return static_cast<int>(div_by_pow2(static_cast<uint32_t>(val)));
-    });
+                        Tensor2DTyped<Input> const &src, Sign sign,
+                        Parallel const &parallel) const {
+    fht2d_non_recursive_parallel(dst, src, this->buffer, sign, this->dt_plan,
+                                 this->dt_levels, parallel);
   }
 };
 
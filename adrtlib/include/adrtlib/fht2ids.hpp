@@ -1,30 +1,37 @@
+#pragma once
 #include <cmath>  // round
 #include <vector>
 
 #include "common_algorithms.hpp"
+#include "level_schedule.hpp"
 #include "non_recursive.hpp"
 
 namespace adrt {
 
-template <typename Scalar>
+// `run_pairs(count, callback)` calls `callback(pair, line_buffer)` for every
+// pair in [0, count), the pairs touch disjoint rows and may run in any order
+template <typename Scalar, typename RunPairs>
 static inline void fht2ids_core(int const h, Sign sign, int K[],
                                 int const K_T[], int const K_B[],
                                 Scalar buffer[],
                                 Tensor2DTyped<Scalar> const &I_T,
-                                Tensor2DTyped<Scalar> const &I_B) {
+                                Tensor2DTyped<Scalar> const &I_B,
+                                RunPairs const &run_pairs) {
   A_NEVER(h < 2);
   int t_B, t_T, k_T, k_B, t;
   int const width = I_T.width;
+  auto const process_pair = [&](int pair, Scalar line_buffer[]) {
+    int const t = 2 * pair;
+    int const t_B = pair;
+    int const k_T = K_T[pair];
+    int const k_B = K_B[pair];
+    ProcessPair(A_LINE(I_T, k_T), A_LINE(I_B, k_B), line_buffer, width, sign,
+                apply_sign(sign, (t - t_B + 1), width));
+    K[t] = k_T;
+    K[t + 1] = I_T.height + k_B;
+  };
   if (h % 2 == 0) {
-    for (t = 0; t < h; t += 2) {
-      t_B = t_T = t / 2;
-      k_T = K_T[t_T];
-      k_B = K_B[t_B];
-      ProcessPair(A_LINE(I_T, k_T), A_LINE(I_B, k_B), buffer, width, sign,
-                  apply_sign(sign, (t - t_B + 1), width));
-      K[t] = k_T;
-      K[t + 1] = I_T.height + k_B;
-    }
+    run_pairs(h / 2, process_pair);
   } else {
     int const t_L_3deg_plus_one = round(static_cast<double>(h) / 4.0);
     int const num_t_to_preprocess = h - 2 * t_L_3deg_plus_one;
@@ -46,18 +53,20 @@ static inline void fht2ids_core(int const h, Sign sign, int K[],
         t_T -= 1;
       }
     }
-    for (t = 0; t != 2 * t_L_3deg_plus_one; t += 2) {
-      t_B = t_T = t / 2;
-      k_T = K_T[t_T];
-      k_B = K_B[t_B];
-      ProcessPair(A_LINE(I_T, k_T), A_LINE(I_B, k_B), buffer, width, sign,
-                  apply_sign(sign, (t - t_B + 1), width));
-      K[t] = k_T;
-      K[t + 1] = I_T.height + k_B;
-    }
+    run_pairs(t_L_3deg_plus_one, process_pair);
   }
 }
 
+template <typename Scalar>
+static inline void fht2ids_core(int const h, Sign sign, int K[],
+                                int const K_T[], int const K_B[],
+                                Scalar buffer[],
+                                Tensor2DTyped<Scalar> const &I_T,
+                                Tensor2DTyped<Scalar> const &I_B) {
+  fht2ids_core(h, sign, K, K_T, K_B, buffer, I_T, I_B,
+               SerialPairs<Scalar>{buffer});
+}
+
 template <typename Scalar>
 void _fht2ids_recursive(Tensor2DTyped<Scalar> const &src, Sign sign,
                         int swaps[], int swaps_buffer[], Scalar line_buffer[]) {
@@ -110,6 +119,47 @@ void _fht2ids_non_recursive(Tensor2DTyped<Scalar> const &src, Sign sign,
   }
 }
 
+template <typename Scalar>
+struct ids_workspace {
+  std::unique_ptr<Scalar[]> line_buffer;
+  static ids_workspace<Scalar> create(Tensor2DTyped<Scalar> const &prototype) {
+    return ids_workspace<Scalar>{
+        std::unique_ptr<Scalar[]>{new Scalar[prototype.width]}};
+  }
+};
+
+// Level-synchronous version of `_fht2ids_non_recursive`: tasks of a level run
+// concurrently, merges of the top levels are split by pairs of rows
+template <typename Scalar>
+void _fht2ids_parallel(Tensor2DTyped<Scalar> const &src, Sign sign,
+                       int swaps[], int swaps_buffer[],
+                       LevelSchedule const &schedule,
+                       WorkspacePool<ids_workspace<Scalar>> &workspaces,
+                       Parallel const &parallel) {
+  auto const height = src.height;
+  if A_UNLIKELY (height <= 1) {
+    return;
+  }
+  std::memset(swaps, 0, height * sizeof(int));
+  ParallelPairs<Scalar, ids_workspace<Scalar>> const run_pairs{
+      *parallel.pool, workspaces,
+      std::max(1, parallel.rows_grain(src.width) / 2)};
+
+  run_levels(*parallel.pool, schedule, [&](ADRTTask const &task, int) {
+    A_NEVER(task.size < 2);
+    Tensor2D const I_T{slice_no_checks(src, task.start, task.mid)};
+    Tensor2D const I_B{slice_no_checks(src, task.mid, task.stop)};
+    int *cur_swaps_buffer = swaps_buffer + task.start;
+    int *cur_swaps = swaps + task.start;
+    std::memcpy(cur_swaps_buffer, cur_swaps,
+                task.size * sizeof(swaps_buffer[0]));
+    auto const workspace = workspaces.acquire();
+    fht2ids_core(task.size, sign, cur_swaps, cur_swaps_buffer,
+                 swaps_buffer + task.mid, workspace->line_buffer.get(),
+                 I_T.as<Scalar>(), I_B.as<Scalar>(), run_pairs);
+  });
+}
+
 template <typename Scalar>
 class ids_recursive {
   std::unique_ptr<Scalar[]> line_buffer;
@@ -143,14 +193,21 @@ class ids_non_recursive {
   std::unique_ptr<Scalar[]> line_buffer;
   std::unique_ptr<int[]> swaps_buffer;
   std::vector<ADRTTask> tasks;
+  LevelSchedule schedule;
+  std::unique_ptr<WorkspacePool<ids_workspace<Scalar>>> workspaces;
   ids_non_recursive(std::unique_ptr<Scalar[]> &&line_buffer,
                     std::unique_ptr<int[]> &&swaps,
                     std::unique_ptr<int[]> &&swaps_buffer,
-                    std::vector<ADRTTask> &&tasks)
+                    std::vector<ADRTTask> &&tasks, LevelSchedule &&schedule,
+                    Tensor2DTyped<Scalar> const &prototype)
       : line_buffer{std::move(line_buffer)},
         swaps_buffer{std::move(swaps_buffer)},
-        swaps{std::move(swaps)},
-        tasks{std::move(tasks)} {}
+        tasks{std::move(tasks)},
+        schedule{std::move(schedule)},
+        workspaces{new WorkspacePool<ids_workspace<Scalar>>{[prototype] {
+          return ids_workspace<Scalar>::create(prototype);
+        }}},
+        swaps{std::move(swaps)} {}
 
  public:
   std::unique_ptr<int[]> swaps;
@@ -160,13 +217,18 @@ class ids_non_recursive {
     std::unique_ptr<int[]> swaps{new int[prototype.height]};
     std::unique_ptr<int[]> swaps_buffer{new int[prototype.height]};
     std::vector<ADRTTask> tasks;
+    auto const mid_callback = [](auto val) { return val / 2; };
     adrt::non_recursive(
         prototype.height,
         [&](ADRTTask const &task) { tasks.emplace_back(task); },
-        [](auto val) { return val / 2; });
-    return ids_non_recursive<Scalar>{std::move(line_buffer),
-                                     std::move(swaps_buffer), std::move(swaps),
-                                     std::move(tasks)};
+        mid_callback);
+    return ids_non_recursive<Scalar>{
+        std::move(line_buffer),
+        std::move(swaps_buffer),
+        std::move(swaps),
+        std::move(tasks),
+        LevelSchedule::create(prototype.height, mid_callback),
+        prototype};
   }
 
   void operator()(Tensor2DTyped<Scalar> const &src, Sign sign) const {
@@ -174,6 +236,13 @@ class ids_non_recursive {
                            this->swaps_buffer.get(), this->line_buffer.get(),
                            this->tasks);
   }
+
+  // bit-identical to the serial call
+  void operator()(Tensor2DTyped<Scalar> const &src, Sign sign,
+                  Parallel const &parallel) const {
+    _fht2ids_parallel(src, sign, this->swaps.get(), this->swaps_buffer.get(),
+                      this->schedule, *this->workspaces, parallel);
+  }
 };
 
 template <typename Scalar>
@@ -4,6 +4,7 @@
 #include <vector>
 
 #include "common_algorithms.hpp"
+#include "level_schedule.hpp"
 #include "non_recursive.hpp"
 
 namespace adrt {
@@ -39,17 +40,22 @@ static inline void outteg(OutDegree* v_T, OutDegree* v_B, int height, int h_T,
   }
 }
 
-template <typename Scalar>
-static inline void fht2idt_core(
-    int const h, Sign sign, int K[], int const K_T[], int const K_B[],
-    Scalar buffer[], Tensor2DTyped<Scalar> const& I_T,
-    Tensor2DTyped<Scalar> const& I_B, OutDegree* out_degrees,
-    std::vector<int>& t_B_to_check, std::vector<int>& t_T_to_check,
-    std::vector<bool>& t_processed) {
+//
+// Walks the dependency graph of one merge step. Rows that can be computed
+// in place are reported in order: `save_t(t, t_T, t_B)` for rows written
+// over their T line, `without_saving_t(t, t_T, t_B)` for rows written over
+// their B line. Starts of the remaining independent pairs (t, t + 1) are
+// left in `t_B_to_check`. Depends on the heights only.
+//
+template <typename SaveT, typename WithoutSavingT>
+static inline void fht2idt_walk(int const h, int const h_T, int const h_B,
+                                OutDegree* out_degrees,
+                                std::vector<int>& t_B_to_check,
+                                std::vector<int>& t_T_to_check,
+                                std::vector<bool>& t_processed,
+                                SaveT const& save_t,
+                                WithoutSavingT const& without_saving_t) {
   A_NEVER(h < 2);
-  auto const h_T = I_T.height;
-  auto const h_B = I_B.height;
-  auto const width = I_B.width;
   t_T_to_check.resize(h_T);
   std::iota(t_T_to_check.begin(), t_T_to_check.end(), 0);
   t_processed.resize(h);
@@ -76,11 +82,7 @@ static inline void fht2idt_core(
         int32_t const end_T = v_T[t_T].b;
         int32_t const t = !t_processed[end_T] ? end_T : start_T;
         int32_t const t_B = round05(k_B * t);
-        int const k_T = K_T[t_T];
-        int const k_B = K_B[t_B];
-        int const shift = apply_sign(sign, t - t_B, width);
-        ProcessLineAndSaveT(A_LINE(I_T, k_T), A_LINE(I_B, k_B), width, shift);
-        K[t] = k_T;
+        save_t(t, t_T, t_B);
         t_processed[t] = true;
 
         if (t_B != t_B_prev) {
@@ -102,12 +104,7 @@ static inline void fht2idt_core(
         int32_t const end_B = v_B[t_B].b;
         int32_t const t = !t_processed[start_B] ? start_B : end_B;
         int32_t const t_T = round05(k_T * t);
-        int const k_T = K_T[t_T];
-        int const k_B = K_B[t_B];
-        int const shift = apply_sign(sign, t - t_B, width);
-        ProcessLineWithoutSavingT(A_LINE(I_T, k_T), A_LINE(I_B, k_B), buffer,
-                                  width, shift);
-        K[t] = h_T + k_B;
+        without_saving_t(t, t_T, t_B);
 
         t_processed[t] = true;
 
@@ -118,26 +115,80 @@ static inline void fht2idt_core(
     }
   }
 
-  int32_t t{};
-  for (auto const is_processed : t_processed) {
-    if (!is_processed) {
-      int32_t const t_T = round05(k_T * t);
-      int32_t const t_B = round05(k_B * t);
-
-      int32_t const k_T = K_T[t_T];
-      int32_t const k_B = K_B[t_B];
-      ProcessPair(A_LINE(I_T, k_T), A_LINE(I_B, k_B), buffer, width, sign,
-                  apply_sign(sign, (t - t_B + 1), width));
-
-      K[t] = k_T;
-      K[t + 1] = h_T + k_B;
+  // the rest are independent pairs (t, t + 1), `t_B_to_check` is reused
+  // for their first rows
+  t_B_to_check.clear();
+  for (int32_t t{}; t != h; ++t) {
+    if (!t_processed[t]) {
+      t_B_to_check.emplace_back(t);
       t_processed[t] = true;
       t_processed[t + 1] = true;
     }
-    ++t;
   }
 }
 
+// `run_pairs` is the same as in `fht2ids_core`
+template <typename Scalar, typename RunPairs>
+static inline void fht2idt_core(
+    int const h, Sign sign, int K[], int const K_T[], int const K_B[],
+    Scalar buffer[], Tensor2DTyped<Scalar> const& I_T,
+    Tensor2DTyped<Scalar> const& I_B, OutDegree* out_degrees,
+    std::vector<int>& t_B_to_check, std::vector<int>& t_T_to_check,
+    std::vector<bool>& t_processed, RunPairs const& run_pairs) {
+  A_NEVER(h < 2);
+  auto const h_T = I_T.height;
+  auto const h_B = I_B.height;
+  auto const width = I_B.width;
+  double const k_T = static_cast<double>(h_T - 1) / static_cast<double>(h - 1);
+  double const k_B = static_cast<double>(h_B - 1) / static_cast<double>(h - 1);
+
+  fht2idt_walk(
+      h, h_T, h_B, out_degrees, t_B_to_check, t_T_to_check, t_processed,
+      [&](int32_t t, int32_t t_T, int32_t t_B) {
+        int const k_T = K_T[t_T];
+        int const k_B = K_B[t_B];
+        int const shift = apply_sign(sign, t - t_B, width);
+        ProcessLineAndSaveT(A_LINE(I_T, k_T), A_LINE(I_B, k_B), width, shift);
+        K[t] = k_T;
+      },
+      [&](int32_t t, int32_t t_T, int32_t t_B) {
+        int const k_T = K_T[t_T];
+        int const k_B = K_B[t_B];
+        int const shift = apply_sign(sign, t - t_B, width);
+        ProcessLineWithoutSavingT(A_LINE(I_T, k_T), A_LINE(I_B, k_B), buffer,
+                                  width, shift);
+        K[t] = h_T + k_B;
+      });
+
+  int const* pairs = t_B_to_check.data();
+  run_pairs(static_cast<int>(t_B_to_check.size()),
+            [&](int pair, Scalar line_buffer[]) {
+              int32_t const t = pairs[pair];
+              int32_t const t_T = round05(k_T * t);
+              int32_t const t_B = round05(k_B * t);
+
+              int32_t const k_T = K_T[t_T];
+              int32_t const k_B = K_B[t_B];
+              ProcessPair(A_LINE(I_T, k_T), A_LINE(I_B, k_B), line_buffer,
+                          width, sign, apply_sign(sign, (t - t_B + 1), width));
+
+              K[t] = k_T;
+              K[t + 1] = h_T + k_B;
+            });
+}
+
+template <typename Scalar>
+static inline void fht2idt_core(
+    int const h, Sign sign, int K[], int const K_T[], int const K_B[],
+    Scalar buffer[], Tensor2DTyped<Scalar> const& I_T,
+    Tensor2DTyped<Scalar> const& I_B, OutDegree* out_degrees,
+    std::vector<int>& t_B_to_check, std::vector<int>& t_T_to_check,
+    std::vector<bool>& t_processed) {
+  fht2idt_core(h, sign, K, K_T, K_B, buffer, I_T, I_B, out_degrees,
+               t_B_to_check, t_T_to_check, t_processed,
+               SerialPairs<Scalar>{buffer});
+}
+
 template <typename Scalar>
 void _fht2idt_recursive(Tensor2DTyped<Scalar> const& src, Sign sign,
                         int swaps[], int swaps_buffer[], Scalar line_buffer[],
@@ -196,6 +247,124 @@ void _fht2idt_non_recursive(Tensor2DTyped<Scalar> const& src, Sign sign,
   }
 }
 
+enum class IDTOp : int_fast8_t {
+  SaveT,           // ProcessLineAndSaveT
+  WithoutSavingT,  // ProcessLineWithoutSavingT
+  Pair,            // ProcessPair
+};
+
+struct IDTStep {
+  IDTOp op;
+  int row_T;  // absolute rows of the image
+  int row_B;
+  int shift_positive;
+  int shift_negative;
+};
+
+//
+// Recorded sequence of line operations of the whole transform for one
+// image shape, together with the resulting `swaps`. The degree graph of a
+// merge step depends on heights only, so it is walked once at `record` and
+// replaying it runs the additions and nothing else.
+//
+struct IDTSchedule {
+  int height{};
+  int width{};
+  std::vector<IDTStep> steps;
+  std::vector<int> swaps;
+
+  static IDTSchedule record(int height, int width,
+                            std::vector<ADRTTask> const& tasks) {
+    IDTSchedule schedule;
+    schedule.height = height;
+    schedule.width = width;
+    schedule.swaps.assign(height, 0);
+    if (height <= 1 || width <= 0) {
+      return schedule;
+    }
+    std::vector<int> swaps_buffer(height);
+    std::unique_ptr<OutDegree[]> out_degrees(new OutDegree[height]);
+    std::vector<int> t_B_to_check, t_T_to_check;
+    std::vector<bool> t_processed;
+
+    for (ADRTTask const& task : tasks) {
+      A_NEVER(task.size < 2);
+      int const h = task.size;
+      int const h_T = task.mid - task.start;
+      int const h_B = task.stop - task.mid;
+      int* K = schedule.swaps.data() + task.start;
+      int const* K_T = swaps_buffer.data() + task.start;
+      int const* K_B = swaps_buffer.data() + task.mid;
+      std::memcpy(swaps_buffer.data() + task.start, K, h * sizeof(K[0]));
+      auto const add_step = [&](IDTOp op, int k_T, int k_B, int shift) {
+        schedule.steps.push_back(
+            IDTStep{op, task.start + k_T, task.mid + k_B,
+                    apply_sign(Sign::Positive, shift, width),
+                    apply_sign(Sign::Negative, shift, width)});
+      };
+      fht2idt_walk(
+          h, h_T, h_B, out_degrees.get(), t_B_to_check, t_T_to_check,
+          t_processed,
+          [&](int32_t t, int32_t t_T, int32_t t_B) {
+            add_step(IDTOp::SaveT, K_T[t_T], K_B[t_B], t - t_B);
+            K[t] = K_T[t_T];
+          },
+          [&](int32_t t, int32_t t_T, int32_t t_B) {
+            add_step(IDTOp::WithoutSavingT, K_T[t_T], K_B[t_B], t - t_B);
+            K[t] = h_T + K_B[t_B];
+          });
+      double const k_T =
+          static_cast<double>(h_T - 1) / static_cast<double>(h - 1);
+      double const k_B =
+          static_cast<double>(h_B - 1) / static_cast<double>(h - 1);
+      for (int32_t const t : t_B_to_check) {
+        int32_t const t_T = round05(k_T * t);
+        int32_t const t_B = round05(k_B * t);
+        add_step(IDTOp::Pair, K_T[t_T], K_B[t_B], t - t_B + 1);
+        K[t] = K_T[t_T];
+        K[t + 1] = h_T + K_B[t_B];
+      }
+    }
+    return schedule;
+  }
+
+  bool matches(int height, int width) const {
+    return this->height == height && this->width == width;
+  }
+};
+
+template <typename Scalar>
+void _fht2idt_replay(Tensor2DTyped<Scalar> const& src, Sign sign, int swaps[],
+                     Scalar line_buffer[], IDTSchedule const& schedule) {
+  A_NEVER(!schedule.matches(src.height, src.width));
+  int const width = src.width;
+  bool const positive = sign == Sign::Positive;
+  for (IDTStep const& step : schedule.steps) {
+    Scalar* line_T = A_LINE(src, step.row_T);
+    Scalar* line_B = A_LINE(src, step.row_B);
+    int const shift = positive ? step.shift_positive : step.shift_negative;
+    switch (step.op) {
+      case IDTOp::SaveT:
+        ProcessLineAndSaveT(line_T, line_B, width, shift);
+        break;
+      case IDTOp::WithoutSavingT:
+        ProcessLineWithoutSavingT(line_T, line_B, line_buffer, width, shift);
+        break;
+      case IDTOp::Pair:
+        ProcessPair(line_T, line_B, line_buffer, width, sign, shift);
+        break;
+    }
+  }
+  std::copy(schedule.swaps.begin(), schedule.swaps.end(), swaps);
+}
+
+// `ScheduleMode::Compiled` records the line operations at `create` and
+// replays them, the image must have the shape of the prototype
+enum class ScheduleMode : int_fast8_t {
+  Dynamic,
+  Compiled,
+};
+
 template <typename Scalar>
 struct idt_base {
   std::unique_ptr<int[]> swaps_buffer;
@@ -213,7 +382,7 @@ struct idt_base {
 
   static idt_base<Scalar> create(Tensor2DTyped<Scalar> const& prototype) {
     std::unique_ptr<int[]> swaps_buffer(new int[prototype.height]);
-    std::unique_ptr<Scalar[]> line_buffer(new Scalar[prototype.height]);
+    std::unique_ptr<Scalar[]> line_buffer(new Scalar[prototype.width]);
     std::unique_ptr<adrt::OutDegree[]> out_degrees(
         new adrt::OutDegree[prototype.height]);
     return idt_base(std::move(swaps_buffer), std::move(line_buffer),
@@ -221,20 +390,85 @@ struct idt_base {
   }
 };
 
+// Level-synchronous version of `_fht2idt_non_recursive`,
+// see `_fht2ids_parallel`
+template <typename Scalar>
+void _fht2idt_parallel(Tensor2DTyped<Scalar> const& src, Sign sign,
+                       int swaps[], int swaps_buffer[],
+                       LevelSchedule const& schedule,
+                       WorkspacePool<idt_base<Scalar>>& workspaces,
+                       Parallel const& parallel) {
+  auto const height = src.height;
+  if A_UNLIKELY (height <= 1) {
+    return;
+  }
+  ParallelPairs<Scalar, idt_base<Scalar>> const run_pairs{
+      *parallel.pool, workspaces,
+      std::max(1, parallel.rows_grain(src.width) / 2)};
+
+  run_levels(*parallel.pool, schedule, [&](ADRTTask const& task, int) {
+    A_NEVER(task.size < 2);
+    Tensor2D const I_T{slice_no_checks(src, task.start, task.mid)};
+    Tensor2D const I_B{slice_no_checks(src, task.mid, task.stop)};
+    int* cur_swaps_buffer = swaps_buffer + task.start;
+    int* cur_swaps = swaps + task.start;
+    std::memcpy(cur_swaps_buffer, cur_swaps,
+                task.size * sizeof(swaps_buffer[0]));
+    auto const workspace = workspaces.acquire();
+    fht2idt_core(task.size, sign, cur_swaps, cur_swaps_buffer,
+                 swaps_buffer + task.mid, workspace->line_buffer.get(),
+                 I_T.as<Scalar>(), I_B.as<Scalar>(),
+                 workspace->out_degrees.get(), workspace->t_B_to_check,
+                 workspace->t_T_to_check, workspace->t_processed, run_pairs);
+  });
+}
+
+static inline std::vector<ADRTTask> idt_tasks(int height) {
+  std::vector<ADRTTask> tasks;
+  non_recursive(
+      height, [&](ADRTTask const& task) { tasks.emplace_back(task); },
+      [](int val) {
+        return static_cast<int>(div_by_pow2(static_cast<uint32_t>(val)));
+      });
+  return tasks;
+}
+
+template <typename Scalar>
+static inline std::unique_ptr<IDTSchedule> idt_compile(
+    Tensor2DTyped<Scalar> const& prototype, ScheduleMode mode) {
+  if (mode != ScheduleMode::Compiled) {
+    return nullptr;
+  }
+  return std::unique_ptr<IDTSchedule>{new IDTSchedule{IDTSchedule::record(
+      prototype.height, prototype.width, idt_tasks(prototype.height))}};
+}
+
 template <typename Scalar>
 class idt_recursive {
   idt_base<Scalar> base;
+  std::unique_ptr<IDTSchedule> compiled;
 
  public:
   std::unique_ptr<int[]> swaps;
 
-  idt_recursive(idt_base<Scalar>&& base, std::unique_ptr<int[]>&& swaps)
-      : base{std::move(base)}, swaps{std::move(swaps)} {}
-  static idt_recursive<Scalar> create(Tensor2DTyped<Scalar> const& prototype) {
+  idt_recursive(idt_base<Scalar>&& base, std::unique_ptr<int[]>&& swaps,
+                std::unique_ptr<IDTSchedule>&& compiled = nullptr)
+      : base{std::move(base)},
+        compiled{std::move(compiled)},
+        swaps{std::move(swaps)} {}
+  static idt_recursive<Scalar> create(
+      Tensor2DTyped<Scalar> const& prototype,
+      ScheduleMode mode = ScheduleMode::Dynamic) {
     std::unique_ptr<int[]> swaps(new int[prototype.height]);
-    return idt_recursive(idt_base<Scalar>::create(prototype), std::move(swaps));
+    return idt_recursive(idt_base<Scalar>::create(prototype), std::move(swaps),
+                         idt_compile(prototype, mode));
   }
   void operator()(Tensor2DTyped<Scalar> const& src, Sign sign) {
+    if (this->compiled) {
+      _fht2idt_replay(src, sign, this->swaps.get(),
+                      this->base.line_buffer.get(), *this->compiled);
+      return;
+    }
     std::fill(this->swaps.get(), this->swaps.get() + src.height, 0);
     _fht2idt_recursive(src, sign, this->swaps.get(),
                        this->base.swaps_buffer.get(),
@@ -248,30 +482,48 @@ template <typename Scalar>
 class idt_non_recursive {
   idt_base<Scalar> base;
   std::vector<ADRTTask> tasks;
+  LevelSchedule schedule;
+  std::unique_ptr<WorkspacePool<idt_base<Scalar>>> workspaces;
+  std::unique_ptr<IDTSchedule> compiled;
 
  public:
   std::unique_ptr<int[]> swaps;
   idt_non_recursive(idt_base<Scalar>&& base, std::unique_ptr<int[]>&& swaps,
-                    std::vector<ADRTTask>&& tasks)
+                    std::vector<ADRTTask>&& tasks, LevelSchedule&& schedule,
+                    Tensor2DTyped<Scalar> const& prototype,
+                    std::unique_ptr<IDTSchedule>&& compiled = nullptr)
       : base{std::move(base)},
-        swaps{std::move(swaps)},
-        tasks{std::move(tasks)} {}
+        tasks{std::move(tasks)},
+        schedule{std::move(schedule)},
+        workspaces{new WorkspacePool<idt_base<Scalar>>{
+            [prototype] { return idt_base<Scalar>::create(prototype); }}},
+        compiled{std::move(compiled)},
+        swaps{std::move(swaps)} {}
   static idt_non_recursive<Scalar> create(
-      Tensor2DTyped<Scalar> const& prototype) {
+      Tensor2DTyped<Scalar> const& prototype,
+      ScheduleMode mode = ScheduleMode::Dynamic) {
     std::unique_ptr<int[]> swaps(new int[prototype.height]);
-    std::vector<ADRTTask> tasks;
-
-    non_recursive(
-        prototype.height,
-        [&](ADRTTask const& task) { tasks.emplace_back(task); },
-        [](int val) {
-          return static_cast<int>(div_by_pow2(static_cast<uint32_t>(val)));
-        });
+    auto const mid_callback = [](int val) {
+      return static_cast<int>(div_by_pow2(static_cast<uint32_t>(val)));
+    };
+    std::vector<ADRTTask> tasks{idt_tasks(prototype.height)};
+    std::unique_ptr<IDTSchedule> compiled;
+    if (mode == ScheduleMode::Compiled) {
+      compiled.reset(new IDTSchedule{
+          IDTSchedule::record(prototype.height, prototype.width, tasks)});
+    }
 
-    return idt_non_recursive(idt_base<Scalar>::create(prototype),
-                             std::move(swaps), std::move(tasks));
+    return idt_non_recursive(
+        idt_base<Scalar>::create(prototype), std::move(swaps), std::move(tasks),
+        LevelSchedule::create(prototype.height, mid_callback), prototype,
+        std::move(compiled));
   }
   void operator()(Tensor2DTyped<Scalar> const& src, Sign sign) {
+    if (this->compiled) {
+      _fht2idt_replay(src, sign, this->swaps.get(),
+                      this->base.line_buffer.get(), *this->compiled);
+      return;
+    }
     std::fill(this->swaps.get(), this->swaps.get() + src.height, 0);
     _fht2idt_non_recursive(
         src, sign, this->swaps.get(), this->base.swaps_buffer.get(),
@@ -279,6 +531,14 @@ class idt_non_recursive {
         this->base.t_B_to_check, this->base.t_T_to_check,
         this->base.t_processed, this->tasks);
   }
+  // bit-identical to the serial call
+  void operator()(Tensor2DTyped<Scalar> const& src, Sign sign,
+                  Parallel const& parallel) {
+    std::fill(this->swaps.get(), this->swaps.get() + src.height, 0);
+    _fht2idt_parallel(src, sign, this->swaps.get(),
+                      this->base.swaps_buffer.get(), this->schedule,
+                      *this->workspaces, parallel);
+  }
 };
 
 template <typename Scalar>
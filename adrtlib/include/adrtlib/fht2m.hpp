@@ -0,0 +1,236 @@
+#pragma once
+#include <algorithm>  // std::sort, std::unique, std::lower_bound
+#include <cmath>      // std::abs
+#include <memory>     // std::unique_ptr
+#include <vector>
+
+#include "fht2d.hpp"
+
+namespace adrt {
+
+//
+// Pattern-hash multi-scale transforms `fht2ms` and `fht2mt` (see
+// `ref/fht2ms.py` and `ref/fht2mt.py`). The image is split at the lower
+// power of two of its height; every output row takes the dyadic pattern
+// that deviates least from the ideal line of its slope. Of the hash
+// (s, t, h) of a pattern section only `t` affects pixel values, `h` is the
+// upper power of two of the section height and `s` only orders sections, so
+// the plan keeps one row per distinct `t` in every section.
+//
+
+enum class PatternRule : int_fast8_t {
+  MS,  // slope is the end point of the pattern
+  MT,  // slope is the pattern index scaled to the image height
+};
+
+static inline uint32_t upper_power_of_two(uint32_t n) {
+  return (n & (n - 1)) == 0 ? std::max(n, 1u) : div_by_pow2(n) << 1;
+}
+
+// The dyadic pattern of slope `t` of power of two height `height`
+static inline void dyadic_pattern(int t, int height, int pattern[]) {
+  pattern[0] = 0;
+  for (int size = 1; size < height; size *= 2) {
+    int const t_size = t / (height / (2 * size));
+    int const shift = t_size - t_size / 2;
+    for (int idx = 0; idx != size; ++idx) {
+      pattern[size + idx] = pattern[idx] + shift;
+    }
+  }
+}
+
+// Slope `t` of the hash of the best pattern for every output row, rows
+// without a pattern sum vertical lines
+static inline std::vector<int> pattern_slopes(int height, int width,
+                                              PatternRule rule) {
+  A_NEVER(height < 2 || width < 1);
+  int const h_m = static_cast<int>(upper_power_of_two(height));
+  int const l_m = h_m / 2;
+  int const rows = std::min(height, width);
+  std::vector<int> pattern(h_m);
+  std::vector<double> deviations(rows, -1.0);
+  std::vector<int> slopes(rows, 0);
+  for (int t_m = 0; t_m != h_m; ++t_m) {
+    dyadic_pattern(t_m, h_m, pattern.data());
+    int const t =
+        rule == PatternRule::MS
+            ? pattern[height - 1]
+            : static_cast<int>(round05(static_cast<double>(t_m) *
+                                       (height - 1) / (h_m - 1)));
+    if (t >= rows) {
+      continue;
+    }
+    double deviation = 0.0;
+    for (int idx = 0; idx != height; ++idx) {
+      double const ideal =
+          static_cast<double>(int64_t{idx} * t) / (height - 1);
+      deviation = std::max(deviation, std::abs(pattern[idx] - ideal));
+    }
+    if (deviations[t] == -1.0 || deviations[t] > deviation) {
+      deviations[t] = deviation;
+      slopes[t] = pattern[l_m] + pattern[l_m - 1];
+    }
+  }
+  return slopes;
+}
+
+// distinct values of `slopes`, in increasing order
+static inline std::vector<int> distinct_slopes(std::vector<int> slopes) {
+  std::sort(slopes.begin(), slopes.end());
+  slopes.erase(std::unique(slopes.begin(), slopes.end()), slopes.end());
+  return slopes;
+}
+
+static inline int slope_index(std::vector<int> const &slopes, int t) {
+  return static_cast<int>(
+      std::lower_bound(slopes.begin(), slopes.end(), t) - slopes.begin());
+}
+
+//
+// Adds merge steps of the section of image rows [begin, begin + height)
+// with output slopes `slopes`. Sections of depth > 0 keep their rows in
+// [region, region + upper_power_of_two(height)) of the buffer of their
+// depth parity, sections of height 1 are image rows.
+//
+static inline int pattern_add_steps(MergePlan &plan, int begin, int height,
+                                    std::vector<int> const &slopes,
+                                    int level, int region) {
+  if (height <= 1) {
+    return -1;
+  }
+  int const h_T = static_cast<int>(div_by_pow2(height));
+  int const h_B = height - h_T;
+  int64_t const hash_height = 2 * h_T;
+  int64_t const hash_height_B = upper_power_of_two(h_B);
+  std::vector<int> slopes_T, slopes_B;
+  for (int t : slopes) {
+    slopes_T.emplace_back(t / 2);
+    slopes_B.emplace_back(
+        static_cast<int>(t * hash_height_B / hash_height));
+  }
+  slopes_T = distinct_slopes(std::move(slopes_T));
+  slopes_B = distinct_slopes(std::move(slopes_B));
+
+  MergeStep step;
+  step.child_T =
+      pattern_add_steps(plan, begin, h_T, slopes_T, level + 1, region);
+  step.child_B = pattern_add_steps(plan, begin + h_T, h_B, slopes_B,
+                                   level + 1, region + h_T);
+  step.level = level;
+  step.rows_begin = static_cast<int>(plan.rows.size());
+  for (int k = 0; k != static_cast<int>(slopes.size()); ++k) {
+    int const t = slopes[k];
+    int const t_B = static_cast<int>(t * hash_height_B / hash_height);
+    int const shift = (t + 1) / 2;
+    plan.rows.push_back(MergeRow{
+        level == 0 ? k : region + k,
+        step.child_T < 0 ? begin : region + slope_index(slopes_T, t / 2),
+        step.child_B < 0 ? begin + h_T
+                         : region + h_T + slope_index(slopes_B, t_B),
+        apply_sign(Sign::Positive, shift, plan.width),
+        apply_sign(Sign::Negative, shift, plan.width)});
+  }
+  step.rows_end = static_cast<int>(plan.rows.size());
+  plan.steps.push_back(step);
+  return static_cast<int>(plan.steps.size()) - 1;
+}
+
+// `MergePlan` of `fht2ms` or `fht2mt`, the output has min(height, width)
+// rows. Rows of the root step are output rows, `src_T` and `src_B` of steps
+// with a missing child are image rows.
+static inline MergePlan pattern_plan(int height, int width,
+                                     PatternRule rule) {
+  MergePlan plan;
+  plan.height = height;
+  plan.width = width;
+  if (height > 1 && width > 0) {
+    pattern_add_steps(plan, 0, height, pattern_slopes(height, width, rule),
+                      0, 0);
+  }
+  return plan;
+}
+
+// Runs steps of `pattern_plan` (or `ASD2Plan`) in post-order: depth 0
+// writes `dst`, odd depths write `buffer_odd`, even depths write
+// `buffer_even`
+template <typename Scalar>
+static inline void fht2m(Tensor2DTyped<Scalar> const &dst,
+                         Tensor2DTyped<Scalar> const &src,
+                         Tensor2DTyped<Scalar> const &buffer_odd,
+                         Tensor2DTyped<Scalar> const &buffer_even, Sign sign,
+                         MergePlan const &plan) {
+  A_NEVER(!plan.matches(src.height, src.width) || dst.width != src.width ||
+          dst.height != std::min(src.height, src.width));
+  if A_UNLIKELY (plan.root() < 0) {
+    copy_tensor(dst, src, sizeof(Scalar));
+    return;
+  }
+  int const width = src.width;
+  for (MergeStep const &step : plan.steps) {
+    Tensor2DTyped<Scalar> const &children =
+        (step.level & 1) == 0 ? buffer_odd : buffer_even;
+    Tensor2DTyped<Scalar> const &out =
+        step.level == 0 ? dst : (step.level & 1) == 0 ? buffer_even
+                                                      : buffer_odd;
+    Tensor2DTyped<Scalar> const &in_T = step.child_T < 0 ? src : children;
+    Tensor2DTyped<Scalar> const &in_B = step.child_B < 0 ? src : children;
+    MergeRow const *const end = plan.rows.data() + step.rows_end;
+    for (MergeRow const *row = plan.rows.data() + step.rows_begin;
+         row != end; ++row) {
+      add_with_2nd_shifted(A_LINE(out, row->row), A_LINE(in_T, row->src_T),
+                           A_LINE(in_B, row->src_B), width,
+                           sign == Sign::Positive ? row->shift_positive
+                                                  : row->shift_negative);
+    }
+  }
+}
+
+//
+// `fht2ms` and `fht2mt` for one image shape. Patterns are searched and
+// tabulated once in `create`; `dst` has min(height, width) rows.
+//
+template <typename Scalar>
+class m {
+  std::unique_ptr<Scalar[]> buffer_data;
+  Tensor2D buffer_odd;
+  Tensor2D buffer_even;
+  MergePlan ms_plan;
+  MergePlan mt_plan;
+
+ public:
+  m(int height, int width, MergePlan &&ms_plan, MergePlan &&mt_plan)
+      : buffer_data{new Scalar[2 * static_cast<size_t>(
+                                       upper_power_of_two(height)) *
+                               width]},
+        buffer_odd{static_cast<int32_t>(upper_power_of_two(height)), width,
+                   static_cast<Tensor2D::stride_t>(width * sizeof(Scalar)),
+                   reinterpret_cast<uint8_t *>(this->buffer_data.get())},
+        buffer_even{this->buffer_odd},
+        ms_plan{std::move(ms_plan)},
+        mt_plan{std::move(mt_plan)} {
+    this->buffer_even.data = reinterpret_cast<uint8_t *>(
+        this->buffer_data.get() +
+        static_cast<size_t>(this->buffer_odd.height) * width);
+  }
+
+  static m<Scalar> create(Tensor2DTyped<Scalar> const &prototype) {
+    return m<Scalar>{
+        prototype.height, prototype.width,
+        pattern_plan(prototype.height, prototype.width, PatternRule::MS),
+        pattern_plan(prototype.height, prototype.width, PatternRule::MT)};
+  }
+
+  void ms(Tensor2DTyped<Scalar> const &dst, Tensor2DTyped<Scalar> const &src,
+          Sign sign) const {
+    fht2m(dst, src, this->buffer_odd.as<Scalar>(),
+          this->buffer_even.as<Scalar>(), sign, this->ms_plan);
+  }
+
+  void mt(Tensor2DTyped<Scalar> const &dst, Tensor2DTyped<Scalar> const &src,
+          Sign sign) const {
+    fht2m(dst, src, this->buffer_odd.as<Scalar>(),
+          this->buffer_even.as<Scalar>(), sign, this->mt_plan);
+  }
+};
+
+}  // namespace adrt
@@ -0,0 +1,274 @@
+#pragma once
+#include <cmath>   // std::log2
+#include <memory>  // std::unique_ptr
+#include <vector>
+
+#include "fht2d.hpp"
+#include "fht2m.hpp"
+#include "thread_pool.hpp"
+
+namespace adrt {
+
+//
+// Strip transforms `fht2ss` and `fht2st` (see `ref/fht2ss.py` and
+// `ref/fht2st.py`) for any height: the image is cut into power of two
+// strips, largest first, every strip is transformed by `fht2ds` and output
+// row `t` adds one shifted row of every strip transform. The strips differ
+// in how that row and shift are chosen:
+//   SS: the row joins the rounded ends of the ideal line over the strip,
+//   ST: the strip pattern nearest to the ideal line, searched around it.
+//
+enum class StripRule : int_fast8_t { SS, ST };
+
+// Heights of the power of two strips of `height`, largest first
+static inline std::vector<int> strip_heights(int height) {
+  std::vector<int> heights;
+  while (height > 0) {
+    int const strip = static_cast<int>(upper_power_of_two(height + 1)) / 2;
+    heights.emplace_back(strip);
+    height -= strip;
+  }
+  return heights;
+}
+
+struct StripRow {
+  int row;  // row of the strip transforms, strip offset included
+  int shift_positive;
+  int shift_negative;
+};
+
+//
+// Rows and shifts of every (output row, strip) pair, the rows of output
+// row `t` are [t * num_strips, (t + 1) * num_strips)
+//
+struct StripPlan {
+  int height{};
+  int width{};
+  std::vector<int> strips;    // heights, `strip_heights`
+  std::vector<int> offsets;   // first image row of every strip
+  std::vector<StripRow> rows;
+
+  static StripPlan create(int height, int width, StripRule rule) {
+    StripPlan plan;
+    plan.height = height;
+    plan.width = width;
+    plan.strips = strip_heights(height);
+    int offset = 0;
+    for (int strip : plan.strips) {
+      plan.offsets.emplace_back(offset);
+      offset += strip;
+    }
+    if (height > 1 && width > 0) {
+      if (rule == StripRule::SS) {
+        plan.add_ss_rows();
+      } else {
+        plan.add_st_rows();
+      }
+    }
+    return plan;
+  }
+
+  int num_strips() const { return static_cast<int>(this->strips.size()); }
+
+  bool matches(int height, int width) const {
+    return this->height == height && this->width == width;
+  }
+
+ private:
+  void add_row(int strip, int t, int shift) {
+    A_NEVER(t < 0 || t >= this->strips[strip] || shift < 0);
+    this->rows.push_back(
+        StripRow{this->offsets[strip] + t,
+                 apply_sign(Sign::Positive, shift, this->width),
+                 apply_sign(Sign::Negative, shift, this->width)});
+  }
+
+  // The reference takes the shift modulo the height, which is the same
+  // for square images; here it is taken modulo the width as in `fht2d`
+  void add_ss_rows() {
+    int const n = this->height;
+    for (int t = 0; t != n; ++t) {
+      for (int strip = 0; strip != this->num_strips(); ++strip) {
+        int const x_L = this->offsets[strip];
+        int const x_R = x_L + this->strips[strip] - 1;
+        int const y_L =
+            round_half_even(static_cast<double>(int64_t{t} * x_L) / (n - 1));
+        int const y_R =
+            round_half_even(static_cast<double>(int64_t{t} * x_R) / (n - 1));
+        this->add_row(strip, y_R - y_L, y_L);
+      }
+    }
+  }
+
+  // `st_patterns_keys`: for every strip, the dyadic pattern of slope near
+  // the ideal one and the start near the ideal one with the least
+  // `deviation`, pattern values are taken modulo the width
+  void add_st_rows() {
+    int const n = this->height;
+    int const width = this->width;
+    std::vector<int> pattern, shifted;
+    for (int tau = 0; tau != n; ++tau) {
+      for (int strip = 0; strip != this->num_strips(); ++strip) {
+        int const size = this->strips[strip];
+        int const x_L = this->offsets[strip];
+        int const x_R = x_L + size - 1;
+        double const y_L = static_cast<double>(int64_t{tau} * x_L) / (n - 1);
+        double const y_R = static_cast<double>(int64_t{tau} * x_R) / (n - 1);
+        double const slope = y_R - y_L;
+        int const t_S = round_half_even(y_R) - round_half_even(y_L);
+        int const e =
+            1 + static_cast<int>(std::log2(static_cast<double>(size))) / 6;
+        int const t_min = std::max(0, t_S - e);
+        int const t_max = std::min(size - 1, t_S + e);
+        int const s_min = round_half_even(y_L) - e;
+        int const s_max = round_half_even(y_L) + e;
+        pattern.resize(size);
+        shifted.resize(size);
+        double best = -1.0;
+        int best_begin = 0, best_end = 0;
+        for (int t = t_min; t <= t_max; ++t) {
+          dyadic_pattern(t, size, pattern.data());
+          for (int s = s_min; s <= s_max; ++s) {
+            for (int idx = 0; idx != size; ++idx) {
+              shifted[idx] = ((pattern[idx] + s) % width + width) % width;
+            }
+            double deviation;
+            if (size == 1) {
+              deviation = std::abs(shifted[0] - y_L);
+            } else {
+              deviation = 0.0;
+              for (int idx = 0; idx != size; ++idx) {
+                double const ideal = y_L + idx * slope / (size - 1);
+                deviation = std::max(deviation, std::abs(shifted[idx] - ideal));
+              }
+            }
+            if (best < 0.0 || best > deviation) {
+              best = deviation;
+              best_begin = shifted[0];
+              best_end = shifted[size - 1];
+            }
+          }
+        }
+        this->add_row(strip, ((best_end - best_begin) % width + width) % width,
+                      best_begin);
+      }
+    }
+  }
+};
+
+// out[t] = sum of rows of `strips_out` shifted by `plan`, for t in
+// [t_begin, t_end)
+template <typename Scalar>
+static inline void fht2s_combine(Tensor2DTyped<Scalar> const &dst,
+                                 Tensor2DTyped<Scalar> const &strips_out,
+                                 Sign sign, StripPlan const &plan,
+                                 int t_begin, int t_end) {
+  int const width = plan.width;
+  int const num_strips = plan.num_strips();
+  for (int t = t_begin; t != t_end; ++t) {
+    Scalar *line = A_LINE(dst, t);
+    StripRow const *row = plan.rows.data() + static_cast<size_t>(t) *
+                                                 num_strips;
+    for (int strip = 0; strip != num_strips; ++strip, ++row) {
+      int const shift =
+          sign == Sign::Positive ? row->shift_positive : row->shift_negative;
+      if (strip == 0) {
+        rotate(line, A_LINE(strips_out, row->row), width, shift);
+      } else {
+        accumulate_shifted(line, A_LINE(strips_out, row->row), width, shift);
+      }
+    }
+  }
+}
+
+//
+// `fht2ss` and `fht2st` for one image shape. Every strip has its own `d`,
+// strip transforms are stacked in one buffer of the image shape. With a
+// pool the strips are transformed concurrently and output rows are
+// combined in parallel chunks.
+//
+template <typename Scalar>
+class s {
+  std::vector<d<Scalar>> strip_transforms;
+  std::unique_ptr<Scalar[]> buffer_data;
+  Tensor2D buffer;
+  StripPlan ss_plan;
+  StripPlan st_plan;
+
+  void run(Tensor2DTyped<Scalar> const &dst, Tensor2DTyped<Scalar> const &src,
+           Sign sign, StripPlan const &plan, ThreadPool *pool) const {
+    A_NEVER(!plan.matches(src.height, src.width) ||
+            dst.height != src.height || dst.width != src.width);
+    if A_UNLIKELY (src.height <= 1) {
+      copy_tensor(dst, src, sizeof(Scalar));
+      return;
+    }
+    auto const transform_strip = [&](int strip) {
+      int const begin = plan.offsets[strip];
+      int const end = begin + plan.strips[strip];
+      this->strip_transforms[strip].ds_recursive(
+          slice_no_checks(this->buffer, begin, end).template as<Scalar>(),
+          slice_no_checks(src, begin, end).template as<Scalar>(), sign);
+    };
+    auto const &strips_out = this->buffer.template as<Scalar>();
+    if (pool == nullptr) {
+      for (int strip = 0; strip != plan.num_strips(); ++strip) {
+        transform_strip(strip);
+      }
+      fht2s_combine(dst, strips_out, sign, plan, 0, src.height);
+      return;
+    }
+    {
+      TaskGroup group{*pool};
+      for (int strip = 1; strip < plan.num_strips(); ++strip) {
+        group.run([&transform_strip, strip] { transform_strip(strip); });
+      }
+      transform_strip(0);
+      group.wait();
+    }
+    Parallel const parallel{*pool};
+    parallel_for(*pool, 0, src.height, parallel.rows_grain(src.width),
+                 [&](int begin, int end) {
+                   fht2s_combine(dst, strips_out, sign, plan, begin, end);
+                 });
+  }
+
+ public:
+  s(std::vector<d<Scalar>> &&strip_transforms, int height, int width,
+    StripPlan &&ss_plan, StripPlan &&st_plan)
+      : strip_transforms{std::move(strip_transforms)},
+        buffer_data{new Scalar[static_cast<size_t>(height) * width]},
+        buffer{height, width,
+               static_cast<Tensor2D::stride_t>(width * sizeof(Scalar)),
+               reinterpret_cast<uint8_t *>(this->buffer_data.get())},
+        ss_plan{std::move(ss_plan)},
+        st_plan{std::move(st_plan)} {}
+
+  static s<Scalar> create(Tensor2DTyped<Scalar> const &prototype) {
+    std::vector<d<Scalar>> strip_transforms;
+    int begin = 0;
+    for (int strip : strip_heights(prototype.height)) {
+      Tensor2D const strip_prototype{
+          slice_no_checks(prototype, begin, begin + strip)};
+      strip_transforms.emplace_back(
+          d<Scalar>::create(strip_prototype.as<Scalar>()));
+      begin += strip;
+    }
+    return s<Scalar>{
+        std::move(strip_transforms), prototype.height, prototype.width,
+        StripPlan::create(prototype.height, prototype.width, StripRule::SS),
+        StripPlan::create(prototype.height, prototype.width, StripRule::ST)};
+  }
+
+  void ss(Tensor2DTyped<Scalar> const &dst, Tensor2DTyped<Scalar> const &src,
+          Sign sign, ThreadPool *pool = nullptr) const {
+    this->run(dst, src, sign, this->ss_plan, pool);
+  }
+
+  void st(Tensor2DTyped<Scalar> const &dst, Tensor2DTyped<Scalar> const &src,
+          Sign sign, ThreadPool *pool = nullptr) const {
+    this->run(dst, src, sign, this->st_plan, pool);
+  }
+};
+
+}  // namespace adrt
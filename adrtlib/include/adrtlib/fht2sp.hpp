@@ -0,0 +1,644 @@
+#pragma once
+#include <algorithm>  // std::fill, std::max
+#include <memory>     // std::unique_ptr
+#include <vector>
+
+#include "fht2d.hpp"
+
+namespace adrt {
+
+//
+// Superpixel transform `fht2sp` (see `ref/fht2sp.py`). Every pixel becomes
+// a `hs` x `ws` superpixel: its row `ns` is the pixel repeated `ws` times,
+// the other rows are zero. The result is `fht2dt` of that superpixel image
+// sampled along one line per pixel.
+//
+// The superpixel image is never built. A subtree without nonzero rows is
+// zero, a subtree with one nonzero row is a rotation of a repeated image
+// row. Merges are stored from the first one that adds two nonzero terms
+// upwards, up to a frontier level. Merges above the frontier are not stored,
+// each sample adds the rows of the frontier that its root row sums.
+//
+// Merges mix rotations of repeated rows with different phases, so stored
+// rows keep all superpixel columns. The subtrees of the frontier run one
+// after the other on the same buffers instead, each adds its term to the
+// samples. The frontier is the shallowest one whose buffers are no larger
+// than the output. Every subtree costs a pass over the samples, so memory
+// is traded for time: 1024 x 1024 with 3 x 3 superpixels takes 32 passes.
+//
+
+// Where a term of a merge row comes from
+enum class SuperpixelTerm : int_fast8_t {
+  Zero,    // subtree without image rows
+  Source,  // image row `src`, pixels repeated `ws` times, then rotated
+  Buffer,  // row `src` of the level below, rotated
+};
+
+struct SuperpixelRow {
+  int row;
+  int src[2];  // top and bottom terms
+  int shift_positive[2];
+  int shift_negative[2];
+};
+
+struct SuperpixelStep {
+  int rows_begin;  // [rows_begin, rows_end) in `SuperpixelPlan::rows`
+  int rows_end;
+  int level;
+  SuperpixelTerm term[2];
+  int child[2];  // steps of `Buffer` terms, before pruning
+};
+
+// A row of the frontier or of the image that a root row sums, rotated
+struct SuperpixelRootTerm {
+  int row;
+  int shift_positive;
+  int shift_negative;
+};
+
+//
+// `MergePlan` of `fht2dt` over the superpixel image with virtual subtrees
+// folded into the terms of the merges above them. Steps are in post-order.
+// Those of subtree `g` of the frontier end at `group_ends[g]`, the merges
+// above them are folded into the terms of the root rows: `root_terms` holds
+// the frontier row of every subtree for every root row, `sources` the
+// image rows folded above the frontier.
+//
+// Only rows that the sampled lines reach are kept, top-down from the
+// frontier rows they hit. Kept rows of the levels of one parity are
+// renumbered to consecutive rows of the buffer of that parity, from 0 for
+// every subtree of the frontier.
+//
+struct SuperpixelPlan {
+  int height{};  // image shape
+  int width{};
+  int hs{1};  // superpixel shape and its nonzero row
+  int ws{1};
+  int ns{};
+  int frontier{};  // level of the last stored merges
+  // Samples of the positive and the negative sign. For output pixel (y, x)
+  // the line starts at column `ws` * x + `sample_columns[y]` of the first
+  // root row and crosses root row `sample_rows[y]`, both give or take the
+  // deltas of `sample_deltas[y * width + x]`.
+  std::vector<int> sample_columns[2];
+  std::vector<int> sample_rows[2];
+  std::vector<uint8_t> sample_deltas[2];
+  int buffer_rows[2]{};  // of the buffers of even and odd levels
+  std::vector<SuperpixelRow> rows;
+  std::vector<SuperpixelStep> steps;
+  std::vector<int> group_ends;
+  std::vector<SuperpixelRootTerm> root_terms;  // `groups()` per root row
+  std::vector<int> sources_begin;  // per root row, in `sources`
+  std::vector<SuperpixelRootTerm> sources;
+
+  static SuperpixelPlan create(int height, int width, int hs, int ws,
+                               int ns) {
+    A_NEVER(hs < 1 || ws < 1 || ns < 0 || ns >= hs);
+    SuperpixelPlan plan;
+    plan.height = height;
+    plan.width = width;
+    plan.hs = hs;
+    plan.ws = ws;
+    plan.ns = ns;
+    if (height > 1 && width > 0) {
+      MergePlan const merge{
+          MergePlan::create(plan.super_height(), plan.super_width(), dt_mid)};
+      plan.add_steps(merge, merge.root());
+      plan.add_samples();
+      // root rows that the samples hit
+      std::vector<uint8_t> sampled(plan.super_height());
+      for (Sign sign : {Sign::Positive, Sign::Negative}) {
+        for (int y = 0; y != height; ++y) {
+          for (int x = 0, xs, ys; x != width; ++x) {
+            plan.sample_point(y, x, sign, xs, ys);
+            sampled[ys] = 1;
+          }
+        }
+      }
+      int depth = 0;
+      for (SuperpixelStep const &step : plan.steps) {
+        depth = std::max(depth, step.level);
+      }
+      SuperpixelPlan const full{plan};
+      for (int frontier = 1;; ++frontier) {
+        plan.prune(frontier, sampled);
+        if (frontier >= depth ||
+            plan.buffer_size() <= static_cast<size_t>(height) * width) {
+          break;
+        }
+        plan = full;
+      }
+    }
+    return plan;
+  }
+
+  int groups() const { return static_cast<int>(this->group_ends.size()); }
+
+  // elements of both buffers
+  size_t buffer_size() const {
+    return (static_cast<size_t>(this->buffer_rows[0]) +
+            this->buffer_rows[1]) *
+           this->super_width();
+  }
+
+  int super_height() const { return this->height * this->hs; }
+  int super_width() const { return this->width * this->ws; }
+
+  // column `xs` at the first root row and root row `ys` of the line of
+  // output pixel (`y`, `x`)
+  void sample_point(int y, int x, Sign sign, int &xs, int &ys) const {
+    int const s = sign == Sign::Positive ? 0 : 1;
+    int const super_height = this->super_height();
+    int const super_width = this->super_width();
+    int const delta =
+        this->sample_deltas[s][static_cast<size_t>(y) * this->width + x];
+    int const l = this->ws * x + this->sample_columns[s][y] + (delta >> 3) - 1;
+    // `l` is within `ws` of [0, super_width)
+    xs = l < 0 ? l + super_width : l >= super_width ? l - super_width : l;
+    ys = this->sample_rows[s][y] + (delta & 7) - 2;
+    ys = ys < 0               ? ys + super_height
+         : ys >= super_height ? ys - super_height
+                              : ys;
+  }
+
+  bool matches(int height, int width) const {
+    return this->height == height && this->width == width;
+  }
+
+ private:
+  // slope of the lines of output row `y`
+  double slope(int y, Sign sign) const {
+    int const sign_value = sign == Sign::Positive ? 1 : -1;
+    return static_cast<double>(this->ws) / this->hs *
+           (static_cast<double>(sign_value * y) / (this->height - 1));
+  }
+
+  // columns `l` and `r` of the line of output pixel `x` with `slope` at the
+  // first and the last root row
+  void line_ends(double slope, int x, int &l, int &r) const {
+    double const b = this->ws * (x + 0.5) - 0.5;
+    l = round_half_even(slope * (0.5 - this->hs / 2.0) + b);
+    r = round_half_even(
+        slope * (this->super_height() - 0.5 - this->hs / 2.0) + b);
+  }
+
+  // Lines of a row of output pixels are `ws` columns apart, up to rounding:
+  // `l` moves by -1, 0 or 1 more and `r` - `l` by -2 to 2. These moves are
+  // the deltas, computing them once keeps rounding out of the samples.
+  void add_samples() {
+    int const super_height = this->super_height();
+    for (Sign sign : {Sign::Positive, Sign::Negative}) {
+      int const s = sign == Sign::Positive ? 0 : 1;
+      this->sample_columns[s].resize(this->height);
+      this->sample_rows[s].resize(this->height);
+      this->sample_deltas[s].resize(static_cast<size_t>(this->height) *
+                                    this->width);
+      for (int y = 0; y != this->height; ++y) {
+        double const slope = this->slope(y, sign);
+        int l0, r0;
+        this->line_ends(slope, 0, l0, r0);
+        int const rows0 = sign == Sign::Positive ? r0 - l0 : l0 - r0;
+        this->sample_columns[s][y] = l0;
+        this->sample_rows[s][y] =
+            (rows0 % super_height + super_height) % super_height;
+        uint8_t *deltas = this->sample_deltas[s].data() +
+                          static_cast<size_t>(y) * this->width;
+        for (int x = 0, l, r; x != this->width; ++x) {
+          this->line_ends(slope, x, l, r);
+          int const column = l - this->ws * x - l0;
+          int const rows = (sign == Sign::Positive ? r - l : l - r) - rows0;
+          A_NEVER(column < -1 || column > 1 || rows < -2 || rows > 2);
+          deltas[x] = static_cast<uint8_t>((column + 1) << 3 | (rows + 2));
+        }
+      }
+    }
+  }
+
+  struct Node {
+    SuperpixelTerm term;
+    int begin;  // first superpixel row of the subtree
+    int src;    // image row of `Source`
+    std::vector<int> shift_positive;  // rotation of `Source` for every line
+    std::vector<int> shift_negative;
+    int step = -1;  // of `Buffer`
+  };
+
+  Node leaf(int row) const {
+    if (row % this->hs != this->ns) {
+      return Node{SuperpixelTerm::Zero, row, 0, {}, {}};
+    }
+    return Node{SuperpixelTerm::Source, row, row / this->hs, {0}, {0}};
+  }
+
+  // rotation of `node` in line `t` of the merge, `shift` is that of the
+  // merge row for the bottom term
+  int term_shift(Node const &node, int t, int shift, Sign sign) const {
+    if (node.term != SuperpixelTerm::Source) {
+      return node.term == SuperpixelTerm::Buffer ? shift : 0;
+    }
+    auto const &shifts =
+        sign == Sign::Positive ? node.shift_positive : node.shift_negative;
+    return (shifts[t - node.begin] + shift) % this->super_width();
+  }
+
+  Node add_steps(MergePlan const &merge, int step_idx) {
+    MergeStep const &step = merge.steps[step_idx];
+    MergeRow const *const begin = merge.rows.data() + step.rows_begin;
+    MergeRow const *const end = merge.rows.data() + step.rows_end;
+    Node const node_T = step.child_T < 0 ? this->leaf(begin->src_T)
+                                         : this->add_steps(merge, step.child_T);
+    Node const node_B = step.child_B < 0 ? this->leaf(begin->src_B)
+                                         : this->add_steps(merge, step.child_B);
+    bool const has_T = node_T.term != SuperpixelTerm::Zero;
+    bool const has_B = node_B.term != SuperpixelTerm::Zero;
+    // a stored child stays in the buffer of its level, so it is rotated
+    // into the buffer of this one even without a second term
+    bool const stored = node_T.term == SuperpixelTerm::Buffer ||
+                        node_B.term == SuperpixelTerm::Buffer;
+    if (step.level != 0 && !stored && !(has_T && has_B)) {
+      if (!has_T && !has_B) {
+        return Node{SuperpixelTerm::Zero, begin->row, 0, {}, {}};
+      }
+      // a single nonzero row, rotations compose
+      Node node{SuperpixelTerm::Source, begin->row,
+                has_T ? node_T.src : node_B.src, {}, {}};
+      for (MergeRow const *row = begin; row != end; ++row) {
+        for (Sign sign : {Sign::Positive, Sign::Negative}) {
+          int const shift =
+              has_T ? this->term_shift(node_T, row->src_T, 0, sign)
+                    : this->term_shift(node_B, row->src_B,
+                                       sign == Sign::Positive
+                                           ? row->shift_positive
+                                           : row->shift_negative,
+                                       sign);
+          (sign == Sign::Positive ? node.shift_positive : node.shift_negative)
+              .emplace_back(shift);
+        }
+      }
+      return node;
+    }
+    SuperpixelStep out_step{static_cast<int>(this->rows.size()), 0,
+                            step.level,
+                            {node_T.term, node_B.term},
+                            {node_T.step, node_B.step}};
+    for (MergeRow const *row = begin; row != end; ++row) {
+      SuperpixelRow out_row{row->row, {}, {}, {}};
+      Node const *const nodes[2]{&node_T, &node_B};
+      int const src[2]{row->src_T, row->src_B};
+      for (int k = 0; k != 2; ++k) {
+        Node const &node = *nodes[k];
+        out_row.src[k] =
+            node.term == SuperpixelTerm::Source ? node.src : src[k];
+        out_row.shift_positive[k] = this->term_shift(
+            node, src[k], k == 0 ? 0 : row->shift_positive, Sign::Positive);
+        out_row.shift_negative[k] = this->term_shift(
+            node, src[k], k == 0 ? 0 : row->shift_negative, Sign::Negative);
+      }
+      this->rows.push_back(out_row);
+    }
+    out_step.rows_end = static_cast<int>(this->rows.size());
+    this->steps.push_back(out_step);
+    return Node{SuperpixelTerm::Buffer, begin->row, 0, {}, {},
+                static_cast<int>(this->steps.size()) - 1};
+  }
+
+  // Terms of row `row` of step `step_idx` rotated by `shift_positive` and
+  // `shift_negative`: the frontier rows go to `terms`, one per subtree of
+  // the frontier, image rows to `sources`
+  void add_root_terms(int step_idx, int row, int shift_positive,
+                      int shift_negative, std::vector<int> const &group,
+                      SuperpixelRootTerm *terms) {
+    SuperpixelStep const &step = this->steps[step_idx];
+    SuperpixelRow const &merge_row =
+        this->rows[step.rows_begin + row - this->rows[step.rows_begin].row];
+    int const super_width = this->super_width();
+    for (int k = 0; k != 2; ++k) {
+      SuperpixelRootTerm const term{
+          merge_row.src[k],
+          (shift_positive + merge_row.shift_positive[k]) % super_width,
+          (shift_negative + merge_row.shift_negative[k]) % super_width};
+      if (step.term[k] == SuperpixelTerm::Source) {
+        this->sources.push_back(term);
+      } else if (step.term[k] == SuperpixelTerm::Buffer) {
+        int const child = step.child[k];
+        if (group[child] >= 0) {
+          terms[group[child]] = term;
+        } else {
+          this->add_root_terms(child, term.row, term.shift_positive,
+                               term.shift_negative, group, terms);
+        }
+      }
+    }
+  }
+
+  void prune(int frontier, std::vector<uint8_t> const &sampled) {
+    int const super_height = this->super_height();
+    int depth = frontier;
+    for (SuperpixelStep const &step : this->steps) {
+      depth = std::max(depth, step.level);
+    }
+    this->frontier = frontier;
+    // subtrees of the frontier and the terms of the root rows
+    std::vector<int> group(this->steps.size(), -1);
+    int groups = 0;
+    for (size_t idx = 0; idx != this->steps.size(); ++idx) {
+      if (this->steps[idx].level == frontier) {
+        group[idx] = groups++;
+      }
+    }
+    this->root_terms.assign(static_cast<size_t>(super_height) * groups,
+                            SuperpixelRootTerm{});
+    this->sources_begin.assign(1, 0);
+    for (int row = 0; row != super_height; ++row) {
+      this->add_root_terms(static_cast<int>(this->steps.size()) - 1, row, 0,
+                           0, group,
+                           this->root_terms.data() +
+                               static_cast<size_t>(row) * groups);
+      this->sources_begin.push_back(static_cast<int>(this->sources.size()));
+    }
+    // rows of every level that are read, the frontier ones by the samples
+    std::vector<std::vector<uint8_t>> marked(
+        depth + 1, std::vector<uint8_t>(super_height));
+    for (int row = 0; row != super_height; ++row) {
+      if (!sampled[row]) {
+        continue;
+      }
+      for (int g = 0; g != groups; ++g) {
+        marked[frontier]
+              [this->root_terms[static_cast<size_t>(row) * groups + g].row] =
+            1;
+      }
+    }
+    // top-down: steps follow their children
+    for (auto step = this->steps.rbegin(); step != this->steps.rend();
+         ++step) {
+      if (step->level < frontier) {
+        continue;
+      }
+      for (int idx = step->rows_begin; idx != step->rows_end; ++idx) {
+        SuperpixelRow const &row = this->rows[idx];
+        if (!marked[step->level][row.row]) {
+          continue;
+        }
+        for (int k = 0; k != 2; ++k) {
+          if (step->term[k] == SuperpixelTerm::Buffer) {
+            marked[step->level + 1][row.src[k]] = 1;
+          }
+        }
+      }
+    }
+    // Bottom-up: every row of the image that a level of a parity keeps gets
+    // one buffer row, so rows alias as they did before the renumbering.
+    // Every subtree of the frontier numbers its rows from 0, the samples
+    // read it before the next one runs.
+    std::vector<int> buffer_row[2]{std::vector<int>(super_height, -1),
+                                   std::vector<int>(super_height, -1)};
+    int count[2]{};
+    std::vector<SuperpixelRow> rows;
+    std::vector<SuperpixelStep> steps;
+    for (SuperpixelStep step : this->steps) {
+      if (step.level < frontier) {
+        continue;
+      }
+      int const rows_begin = static_cast<int>(rows.size());
+      int const parity = step.level & 1;
+      for (int idx = step.rows_begin; idx != step.rows_end; ++idx) {
+        SuperpixelRow row = this->rows[idx];
+        if (!marked[step.level][row.row]) {
+          continue;
+        }
+        for (int k = 0; k != 2; ++k) {
+          if (step.term[k] == SuperpixelTerm::Buffer) {
+            row.src[k] = buffer_row[parity ^ 1][row.src[k]];
+          }
+        }
+        int &out = buffer_row[parity][row.row];
+        if (out < 0) {
+          out = count[parity]++;
+          this->buffer_rows[parity] =
+              std::max(this->buffer_rows[parity], count[parity]);
+        }
+        row.row = out;
+        rows.push_back(row);
+      }
+      if (static_cast<int>(rows.size()) != rows_begin) {
+        step.rows_begin = rows_begin;
+        step.rows_end = static_cast<int>(rows.size());
+        steps.push_back(step);
+      }
+      if (step.level == frontier) {
+        this->group_ends.push_back(static_cast<int>(steps.size()));
+        count[0] = count[1] = 0;
+      }
+    }
+    for (SuperpixelRootTerm &term : this->root_terms) {
+      term.row = buffer_row[frontier & 1][term.row];
+    }
+    this->rows = std::move(rows);
+    this->steps = std::move(steps);
+  }
+};
+
+// dst[x * ws + k] = src[x] for k < ws
+template <typename Scalar>
+static inline void repeat_pixels(Scalar *A_RESTRICT dst,
+                                 Scalar const *A_RESTRICT src, int width,
+                                 int ws) {
+  for (int x = 0; x != width; ++x, dst += ws) {
+    std::fill(dst, dst + ws, src[x]);
+  }
+}
+
+//
+// One stored merge. Rows of a step share their `Source` image rows, so each
+// is repeated once into `expanded` and then rotated and added with the same
+// kernels as buffer rows.
+//
+template <typename Scalar>
+static inline void fht2sp_step(Tensor2DTyped<Scalar> const &out,
+                               Tensor2DTyped<Scalar> const &children,
+                               Tensor2DTyped<Scalar> const &src, Sign sign,
+                               SuperpixelPlan const &plan,
+                               SuperpixelStep const &step,
+                               Scalar *const expanded[2]) {
+  int const super_width = plan.super_width();
+  int expanded_row[2]{-1, -1};
+  SuperpixelRow const *const end = plan.rows.data() + step.rows_end;
+  for (SuperpixelRow const *row = plan.rows.data() + step.rows_begin;
+       row != end; ++row) {
+    Scalar *terms[2]{};
+    for (int k = 0; k != 2; ++k) {
+      if (step.term[k] == SuperpixelTerm::Buffer) {
+        terms[k] = A_LINE(children, row->src[k]);
+      } else if (step.term[k] == SuperpixelTerm::Source) {
+        if (expanded_row[k] != row->src[k]) {
+          repeat_pixels(expanded[k], A_LINE(src, row->src[k]), plan.width,
+                        plan.ws);
+          expanded_row[k] = row->src[k];
+        }
+        terms[k] = expanded[k];
+      }
+    }
+    Scalar *line = A_LINE(out, row->row);
+    int const *shift =
+        sign == Sign::Positive ? row->shift_positive : row->shift_negative;
+    if (terms[0] != nullptr && terms[1] != nullptr) {
+      if (shift[0] != 0) {
+        rotate(line, terms[0], super_width, shift[0]);
+        terms[0] = line;
+      }
+      add_with_2nd_shifted(line, terms[0], terms[1], super_width, shift[1]);
+    } else if (terms[0] != nullptr || terms[1] != nullptr) {
+      int const k = terms[0] != nullptr ? 0 : 1;
+      rotate(line, terms[k], super_width, shift[k]);
+    } else {
+      std::fill(line, line + super_width, Scalar{});
+    }
+  }
+}
+
+//
+// Samples the terms of the root rows that subtree `group` of the frontier
+// computed into `frontier` along the line of every pixel. The first pass
+// sets `dst` and adds the image rows folded above the frontier, the others
+// add to it.
+//
+template <typename Scalar>
+static inline void fht2sp_sample(Tensor2DTyped<Scalar> const &dst,
+                                 Tensor2DTyped<Scalar> const &frontier,
+                                 Tensor2DTyped<Scalar> const &src, Sign sign,
+                                 SuperpixelPlan const &plan, int group) {
+  int const ws = plan.ws;
+  int const super_width = plan.super_width();
+  int const groups = plan.groups();
+  auto const position = [&](SuperpixelRootTerm const &term, int xs) {
+    int const shift =
+        sign == Sign::Positive ? term.shift_positive : term.shift_negative;
+    return xs >= shift ? xs - shift : xs - shift + super_width;
+  };
+  int const super_height = plan.super_height();
+  int const s = sign == Sign::Positive ? 0 : 1;
+  for (int y = 0; y != plan.height; ++y) {
+    Scalar *A_RESTRICT out = A_LINE(dst, y);
+    uint8_t const *deltas =
+        plan.sample_deltas[s].data() + static_cast<size_t>(y) * plan.width;
+    int const column0 = plan.sample_columns[s][y] - 1;
+    int const row0 = plan.sample_rows[s][y] - 2;
+    // consecutive samples mostly share their root row
+    int last_ys = -1;
+    Scalar const *line = nullptr;
+    int shift = 0;
+    for (int x = 0; x != plan.width; ++x) {
+      int const delta = deltas[x];
+      int l = ws * x + column0 + (delta >> 3);
+      int const xs =
+          l < 0 ? l + super_width : l >= super_width ? l - super_width : l;
+      int ys = row0 + (delta & 7);
+      ys = ys < 0               ? ys + super_height
+           : ys >= super_height ? ys - super_height
+                                : ys;
+      if (A_UNLIKELY(ys != last_ys)) {
+        last_ys = ys;
+        if (group < groups) {
+          SuperpixelRootTerm const &term =
+              plan.root_terms[static_cast<size_t>(ys) * groups + group];
+          line = A_LINE(frontier, term.row);
+          shift = sign == Sign::Positive ? term.shift_positive
+                                         : term.shift_negative;
+        }
+      }
+      Scalar value{};
+      if (group == 0) {
+        int const end = plan.sources_begin[ys + 1];
+        for (int idx = plan.sources_begin[ys]; idx != end; ++idx) {
+          SuperpixelRootTerm const &term = plan.sources[idx];
+          value += A_LINE(src, term.row)[position(term, xs) / ws];
+        }
+      } else {
+        value = out[x];
+      }
+      if (group < groups) {
+        value += line[xs >= shift ? xs - shift : xs - shift + super_width];
+      }
+      out[x] = value;
+    }
+  }
+}
+
+//
+// `fht2sp` for one image shape and superpixel. Merges run on two buffers of
+// the superpixel width, one per depth parity, with the rows that the samples
+// reach only; no copy of the superpixel image and no transform of it are
+// made. The buffers hold the rows of one subtree of the frontier at a time.
+//
+template <typename Scalar>
+class sp {
+  SuperpixelPlan plan;
+  std::unique_ptr<Scalar[]> buffer_data;
+  std::unique_ptr<Scalar[]> expanded_data;  // two repeated image rows
+  Tensor2D buffer_odd;
+  Tensor2D buffer_even;
+
+ public:
+  explicit sp(SuperpixelPlan &&plan)
+      : plan{std::move(plan)},
+        buffer_data{new Scalar[this->buffer_size()]},
+        expanded_data{new Scalar[2 * static_cast<size_t>(
+                                         this->plan.super_width())]},
+        buffer_odd{this->plan.buffer_rows[1], this->plan.super_width(),
+                   static_cast<Tensor2D::stride_t>(this->plan.super_width() *
+                                                   sizeof(Scalar)),
+                   reinterpret_cast<uint8_t *>(this->buffer_data.get())},
+        buffer_even{this->buffer_odd} {
+    this->buffer_even.height = this->plan.buffer_rows[0];
+    this->buffer_even.data = reinterpret_cast<uint8_t *>(
+        this->buffer_data.get() +
+        static_cast<size_t>(this->plan.buffer_rows[1]) *
+            this->plan.super_width());
+  }
+
+  // `ns` < 0 is the middle row, `hs` / 2
+  static sp<Scalar> create(Tensor2DTyped<Scalar> const &prototype,
+                           int hs = 3, int ws = 3, int ns = -1) {
+    return sp<Scalar>{SuperpixelPlan::create(prototype.height,
+                                             prototype.width, hs, ws,
+                                             ns < 0 ? hs / 2 : ns)};
+  }
+
+  // elements of both buffers
+  size_t buffer_size() const { return this->plan.buffer_size(); }
+
+  void operator()(Tensor2DTyped<Scalar> const &dst,
+                  Tensor2DTyped<Scalar> const &src, Sign sign) const {
+    A_NEVER(!this->plan.matches(src.height, src.width) ||
+            dst.height != src.height || dst.width != src.width);
+    if A_UNLIKELY (this->plan.sources_begin.empty()) {
+      copy_tensor(dst, src, sizeof(Scalar));
+      return;
+    }
+    auto const &buffer_odd = this->buffer_odd.template as<Scalar>();
+    auto const &buffer_even = this->buffer_even.template as<Scalar>();
+    auto const &frontier =
+        (this->plan.frontier & 1) != 0 ? buffer_odd : buffer_even;
+    Scalar *const expanded[2]{this->expanded_data.get(),
+                              this->expanded_data.get() +
+                                  this->plan.super_width()};
+    // subtrees of the frontier one after the other on the same buffers
+    auto step = this->plan.steps.begin();
+    int const groups = this->plan.groups();
+    for (int group = 0; group != std::max(groups, 1); ++group) {
+      auto const end = group < groups ? this->plan.steps.begin() +
+                                            this->plan.group_ends[group]
+                                      : step;
+      for (; step != end; ++step) {
+        bool const odd = (step->level & 1) != 0;
+        fht2sp_step(odd ? buffer_odd : buffer_even,
+                    odd ? buffer_even : buffer_odd, src, sign, this->plan,
+                    *step, expanded);
+      }
+      fht2sp_sample(dst, frontier, src, sign, this->plan, group);
+    }
+  }
+};
+
+}  // namespace adrt
@@ -0,0 +1,190 @@
+#pragma once
+#include <memory>  // std::unique_ptr
+#include <vector>
+
+#include "batch.hpp"
+#include "common_algorithms.hpp"
+#include "thread_pool.hpp"
+
+namespace adrt {
+
+enum class FullTransform : int_fast8_t { DS, DT, IDS, IDT };
+
+//
+// Hough transform of a `height` x `width` image over all line slopes, as
+// two quadrants of `out` and two of `out_T` (Tensor3Ds with batch 2):
+//   out[0][t][x]:   lines from (x, 0) to (x + t, height - 1),
+//                   `Sign::Positive`
+//   out[1][t][x]:   lines from (x, 0) to (x - t, height - 1),
+//                   `Sign::Negative`
+//   out_T[0][t][y]: lines from (0, y) to (width - 1, y + t), transposed
+//                   image, `Sign::Positive`
+//   out_T[1][t][y]: lines from (0, y) to (width - 1, y - t), transposed
+//                   image, `Sign::Negative`
+// `out` has the shape of the image and `out_T` that of its transpose.
+// Points are (column, row), coordinates wrap cyclically. For `IDS` and
+// `IDT` rows of a quadrant are permuted: row `k` of quadrant `q` holds the
+// slope `swaps[swaps_offset(q) + k]`, `height` swaps for each quadrant of
+// `out` followed by `width` for each of `out_T`.
+//
+// The image is transposed once and the four quadrants run as independent
+// tasks, each with its own buffers.
+//
+template <typename Scalar>
+class fht2_full {
+  FullTransform transform;
+  int height;
+  int width;
+  // of the image, then of its transpose
+  MergePlan plans[2];                      // DS, DT
+  std::vector<ADRTTask> tasks[2];          // IDS
+  IDTSchedule schedules[2];                // IDT
+  std::unique_ptr<Scalar[]> buffers_data;  // transposed image, then buffers
+  std::vector<Tensor2D> buffers;
+  std::unique_ptr<inplace_batch_workspace<Scalar>[]> workspaces;
+
+  // the transposed image, and a buffer per quadrant for `DS` and `DT`
+  static int num_buffers(FullTransform transform) {
+    return transform == FullTransform::DS || transform == FullTransform::DT
+               ? 5
+               : 1;
+  }
+
+  Tensor2D const &transposed() const { return this->buffers[0]; }
+
+  // height of the images of `quadrant`, their width is the other side
+  int quadrant_height(int quadrant) const {
+    return quadrant < 2 ? this->height : this->width;
+  }
+
+  void run_quadrant(int quadrant, Tensor3D const &out, Tensor3D const &out_T,
+                    Tensor2DTyped<Scalar> const &src, int swaps[]) const {
+    Sign const sign = quadrant % 2 == 0 ? Sign::Positive : Sign::Negative;
+    int const side = quadrant / 2;
+    Tensor2DTyped<Scalar> const &image =
+        side == 0 ? src : this->transposed().template as<Scalar>();
+    Tensor2D const dst{side == 0 ? out.image(quadrant)
+                                 : out_T.image(quadrant - 2)};
+    int const rows = this->quadrant_height(quadrant);
+    switch (this->transform) {
+      case FullTransform::DS:
+      case FullTransform::DT:
+        fht2d_recursive(dst.as<Scalar>(), image,
+                        this->buffers[1 + quadrant].template as<Scalar>(),
+                        sign, this->plans[side]);
+        break;
+      case FullTransform::IDS: {
+        copy_tensor(dst, image, sizeof(Scalar));
+        int *quadrant_swaps = swaps + this->swaps_offset(quadrant);
+        if A_UNLIKELY (rows <= 1) {
+          std::fill(quadrant_swaps, quadrant_swaps + rows, 0);
+          break;
+        }
+        auto const &workspace = this->workspaces[quadrant];
+        _fht2ids_non_recursive(dst.as<Scalar>(), sign, quadrant_swaps,
+                               workspace.swaps_buffer.get(),
+                               workspace.line_buffer.get(),
+                               this->tasks[side]);
+        break;
+      }
+      case FullTransform::IDT:
+        copy_tensor(dst, image, sizeof(Scalar));
+        _fht2idt_replay(dst.as<Scalar>(), sign,
+                        swaps + this->swaps_offset(quadrant),
+                        this->workspaces[quadrant].line_buffer.get(),
+                        this->schedules[side]);
+        break;
+    }
+  }
+
+ public:
+  fht2_full(FullTransform transform, int height, int width)
+      : transform{transform},
+        height{height},
+        width{width},
+        buffers_data{new Scalar[static_cast<size_t>(height) * width *
+                                num_buffers(transform)]},
+        workspaces{new inplace_batch_workspace<Scalar>[4]} {
+    size_t const area = static_cast<size_t>(height) * width;
+    for (int idx = 0; idx != num_buffers(transform); ++idx) {
+      // the transposed image and buffers of `out_T` have `width` rows
+      int const rows = idx == 0 || idx >= 3 ? width : height;
+      int const columns = idx == 0 || idx >= 3 ? height : width;
+      this->buffers.emplace_back(
+          rows, columns,
+          static_cast<Tensor2D::stride_t>(columns * sizeof(Scalar)),
+          reinterpret_cast<uint8_t *>(this->buffers_data.get() + idx * area));
+    }
+    int const sides[2][2] = {{height, width}, {width, height}};
+    for (int side = 0; side != 2; ++side) {
+      int const rows = sides[side][0];
+      int const columns = sides[side][1];
+      switch (transform) {
+        case FullTransform::DS:
+          this->plans[side] = MergePlan::create(rows, columns, ds_mid);
+          break;
+        case FullTransform::DT:
+          this->plans[side] = MergePlan::create(rows, columns, dt_mid);
+          break;
+        case FullTransform::IDS:
+          non_recursive(
+              rows,
+              [&](ADRTTask const &task) {
+                this->tasks[side].emplace_back(task);
+              },
+              ds_mid);
+          break;
+        case FullTransform::IDT:
+          this->schedules[side] =
+              IDTSchedule::record(rows, columns, idt_tasks(rows));
+          break;
+      }
+    }
+    if (transform == FullTransform::IDS || transform == FullTransform::IDT) {
+      for (int quadrant = 0; quadrant != 4; ++quadrant) {
+        this->workspaces[quadrant] = inplace_batch_workspace<Scalar>::create(
+            sides[quadrant / 2][0], sides[quadrant / 2][1]);
+      }
+    }
+  }
+
+  static fht2_full<Scalar> create(FullTransform transform, int height,
+                                  int width) {
+    return fht2_full<Scalar>{transform, height, width};
+  }
+
+  // first swap of `quadrant`
+  int swaps_offset(int quadrant) const {
+    return quadrant < 2 ? quadrant * this->height
+                        : 2 * this->height + (quadrant - 2) * this->width;
+  }
+
+  // `out` has batch 2 and the shape of `src`, `out_T` has batch 2 and the
+  // shape of its transpose. `swaps` holds 2 * (height + width) elements and
+  // is only written for `IDS` and `IDT`. Without a pool the quadrants run
+  // one after another.
+  void operator()(Tensor3D const &out, Tensor3D const &out_T,
+                  Tensor2DTyped<Scalar> const &src, int swaps[],
+                  ThreadPool *pool = nullptr) const {
+    A_NEVER(out.batch != 2 || out_T.batch != 2 ||
+            src.height != this->height || src.width != this->width ||
+            out.height != this->height || out.width != this->width ||
+            out_T.height != this->width || out_T.width != this->height);
+    if (pool == nullptr) {
+      transpose_tensor(this->transposed().template as<Scalar>(), src);
+      for (int quadrant = 0; quadrant != 4; ++quadrant) {
+        this->run_quadrant(quadrant, out, out_T, src, swaps);
+      }
+      return;
+    }
+    TaskGroup group{*pool};
+    group.run([&] { this->run_quadrant(0, out, out_T, src, swaps); });
+    group.run([&] { this->run_quadrant(1, out, out_T, src, swaps); });
+    transpose_tensor(this->transposed().template as<Scalar>(), src);
+    group.run([&] { this->run_quadrant(2, out, out_T, src, swaps); });
+    this->run_quadrant(3, out, out_T, src, swaps);
+    group.wait();
+  }
+};
+
+}  // namespace adrt
@@ -0,0 +1,138 @@
+#pragma once
+#include <algorithm>  // std::max, std::fill
+#include <memory>     // std::unique_ptr
+#include <vector>
+
+#include "fht2d.hpp"
+
+namespace adrt {
+
+// work of one frame of `d_incremental`, a row is `width` additions
+struct IncrementalStats {
+  int64_t merged_rows{};
+  int64_t skipped_rows{};
+};
+
+//
+// `ds` or `dt` of a sequence of frames that differ in a few rows, like the
+// frames of a static camera. Outputs of every merge step are retained, one
+// tensor per level of the merge tree, since steps of a level cover disjoint
+// rows. A frame recomputes only the steps whose slices intersect the changed
+// rows, which are the changed subtrees and their ancestors, the other steps
+// keep their outputs of the previous frames. The root always runs and writes
+// `dst`, it costs as much as a copy of a retained result.
+//
+// A band of changed rows still costs about 2 * height * width additions, as
+// steps near the root cover most of the image, against height * width *
+// log2(height) for the whole transform.
+//
+template <typename Scalar>
+class d_incremental {
+  MergePlan plan;
+  Sign sign;
+  std::unique_ptr<Scalar[]> data;
+  std::vector<Tensor2D> levels;      // outputs of levels 1, 2, ...
+  std::vector<int> changed_before;   // changed rows above row `y`
+  bool primed{};
+
+  Tensor2DTyped<Scalar> const &level(int level) const {
+    return this->levels[level - 1].template as<Scalar>();
+  }
+
+ public:
+  d_incremental(MergePlan &&plan, Sign sign)
+      : plan{std::move(plan)},
+        sign{sign},
+        changed_before(static_cast<size_t>(this->plan.height) + 1) {
+    int depth = 0;
+    for (MergeStep const &step : this->plan.steps) {
+      depth = std::max(depth, step.level);
+    }
+    size_t const image_size =
+        static_cast<size_t>(this->plan.height) * this->plan.width;
+    this->data.reset(new Scalar[depth * image_size]);
+    for (int level = 1; level <= depth; ++level) {
+      this->levels.push_back(Tensor2D{
+          this->plan.height, this->plan.width,
+          static_cast<Tensor2D::stride_t>(this->plan.width * sizeof(Scalar)),
+          reinterpret_cast<uint8_t *>(this->data.get() +
+                                      (level - 1) * image_size)});
+    }
+  }
+
+  // `mid_callback` of `ds` or `dt`, as in `MergePlan::create`
+  template <typename MidCallback>
+  static d_incremental<Scalar> create(Tensor2DTyped<Scalar> const &prototype,
+                                      Sign sign, MidCallback mid_callback) {
+    return d_incremental<Scalar>{
+        MergePlan::create(prototype.height, prototype.width, mid_callback),
+        sign};
+  }
+
+  // the next frame is transformed in full
+  void reset() { this->primed = false; }
+
+  //
+  // `src` is the complete current frame, which must differ from the
+  // previous one in the rows of `changed` only. Unchanged rows are still
+  // read: a recomputed step whose child is a leaf reads that row of `src`,
+  // changed or not. The first frame and the frame after `reset` are
+  // transformed in full.
+  //
+  IncrementalStats operator()(Tensor2DTyped<Scalar> const &dst,
+                              Tensor2DTyped<Scalar> const &src,
+                              std::vector<Slice> const &changed) {
+    A_NEVER(!this->plan.matches(src.height, src.width) ||
+            dst.height != src.height || dst.width != src.width);
+    IncrementalStats stats;
+    if A_UNLIKELY (this->plan.root() < 0) {
+      copy_tensor(dst, src, sizeof(Scalar));
+      return stats;
+    }
+    int const height = src.height;
+    int const width = src.width;
+    std::vector<int> &before = this->changed_before;
+    std::fill(before.begin(), before.end(), 0);
+    for (Slice const &slice : changed) {
+      A_NEVER(slice.end > static_cast<uint_fast32_t>(height));
+      before[slice.begin] += 1;
+      before[slice.end] -= 1;
+    }
+    // coverage of every row, then the number of covered rows above it
+    for (int y = 0, covered = 0, count = 0; y <= height; ++y) {
+      covered += before[y];
+      before[y] = count;
+      count += covered > 0;
+    }
+
+    MergeRow const *rows = this->plan.rows.data();
+    for (MergeStep const &step : this->plan.steps) {
+      int const count = step.rows_end - step.rows_begin;
+      int const begin = rows[step.rows_begin].row;
+      if (this->primed && step.level != 0 &&
+          before[begin + count] == before[begin]) {
+        stats.skipped_rows += count;
+        continue;
+      }
+      Tensor2DTyped<Scalar> const &out =
+          step.level == 0 ? dst : this->level(step.level);
+      Tensor2DTyped<Scalar> const &in_T =
+          step.child_T < 0 ? src : this->level(step.level + 1);
+      Tensor2DTyped<Scalar> const &in_B =
+          step.child_B < 0 ? src : this->level(step.level + 1);
+      MergeRow const *const end = rows + step.rows_end;
+      for (MergeRow const *row = rows + step.rows_begin; row != end; ++row) {
+        add_with_2nd_shifted(A_LINE(out, row->row), A_LINE(in_T, row->src_T),
+                             A_LINE(in_B, row->src_B), width,
+                             this->sign == Sign::Positive
+                                 ? row->shift_positive
+                                 : row->shift_negative);
+      }
+      stats.merged_rows += count;
+    }
+    this->primed = true;
+    return stats;
+  }
+};
+
+}  // namespace adrt
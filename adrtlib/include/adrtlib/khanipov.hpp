@@ -0,0 +1,385 @@
+#pragma once
+#include <algorithm>  // std::stable_sort, std::max
+#include <memory>     // std::unique_ptr
+#include <numeric>    // std::iota
+#include <vector>
+
+#include "common_algorithms.hpp"
+
+namespace adrt {
+
+//
+// Ensemble computation Hough transform (see `ref/khanipov.py`,
+// https://arxiv.org/abs/1802.06619). Output row `t` sums image row `x`
+// rotated by round(x * t / (h - 1)), every such line is a pattern of
+// (row, shift) points. Patterns of neighbouring lines are intersected
+// pairwise into ensembles of shared sub-patterns until one ensemble is
+// left; the transform sums the rows of its patterns and then rebuilds the
+// parent ensembles from shifted sub-pattern sums, level by level.
+//
+// Intersections depend on the image shape only, so they are computed once
+// in `KhanipovPlan`, execution is rotations and additions of whole rows.
+//
+
+struct KhanipovPoint {
+  int x;  // image row
+  int y;  // shift, relative to the first point of the pattern
+};
+
+// Patterns of one level, ensemble `e` is patterns
+// [ensembles[e], ensembles[e + 1]), pattern `p` is points
+// [patterns[p], patterns[p + 1])
+struct KhanipovLevel {
+  std::vector<KhanipovPoint> points;
+  std::vector<int> patterns{0};
+  std::vector<int> ensembles{0};
+
+  int num_patterns() const {
+    return static_cast<int>(this->patterns.size()) - 1;
+  }
+  int num_ensembles() const {
+    return static_cast<int>(this->ensembles.size()) - 1;
+  }
+  KhanipovPoint const *begin(int pattern) const {
+    return this->points.data() + this->patterns[pattern];
+  }
+  KhanipovPoint const *end(int pattern) const {
+    return this->points.data() + this->patterns[pattern + 1];
+  }
+  void add_pattern(KhanipovPoint const *begin, KhanipovPoint const *end) {
+    this->points.insert(this->points.end(), begin, end);
+    this->patterns.emplace_back(static_cast<int>(this->points.size()));
+  }
+  void close_ensemble() {
+    this->ensembles.emplace_back(this->num_patterns());
+  }
+};
+
+struct KhanipovTerm {
+  int src;  // row of the stage input
+  int shift_positive;
+  int shift_negative;
+};
+
+struct KhanipovStage {
+  int rows_begin;  // [rows_begin, rows_end) in `KhanipovPlan::terms_begin`
+  int rows_end;
+};
+
+//
+// Gather stages from the leaf ensemble to the output. The first stage reads
+// the image, every other one the output of the previous stage; stage row `r`
+// is the sum of terms [terms_begin[rows_begin + r], terms_begin[rows_begin +
+// r + 1]), in the summation order of the reference.
+//
+struct KhanipovPlan {
+  int height{};
+  int width{};
+  std::vector<KhanipovStage> stages;
+  std::vector<int> terms_begin{0};
+  std::vector<KhanipovTerm> terms;
+
+  static KhanipovPlan create(int height, int width) {
+    KhanipovPlan plan;
+    plan.height = height;
+    plan.width = width;
+    if (height > 1 && width > 0) {
+      plan.add_stages();
+    }
+    return plan;
+  }
+
+  // rows of the largest intermediate stage
+  int max_rows() const {
+    int rows = 0;
+    for (size_t idx = 0; idx + 1 < this->stages.size(); ++idx) {
+      KhanipovStage const &stage = this->stages[idx];
+      rows = std::max(rows, stage.rows_end - stage.rows_begin);
+    }
+    return rows;
+  }
+
+  bool matches(int height, int width) const {
+    return this->height == height && this->width == width;
+  }
+
+ private:
+  // the shared sub-pattern of patterns `i` and `j` of neighbouring
+  // ensembles, met at offsets `s_i` and `s_j` of them
+  struct Parents {
+    int i, s_i, j, s_j;
+  };
+
+  // scratch of `intersect_patterns`, indexed by the shift difference
+  struct Scratch {
+    std::vector<int> group_of_diff;
+    std::vector<int> diffs;
+    std::vector<KhanipovPoint> matches;
+    std::vector<int> match_diff;
+    std::vector<int> group_begin;
+    std::vector<KhanipovPoint> grouped;
+  };
+
+  // `_gen_dsls`
+  static void add_line(KhanipovLevel &level, int height, int t) {
+    std::vector<KhanipovPoint> line(height);
+    int64_t const denominator = 2 * int64_t{height - 1};
+    for (int x = 0; x != height; ++x) {
+      line[x] = KhanipovPoint{
+          x, static_cast<int>((height - 1 + 2 * int64_t{x} * t) / denominator)};
+    }
+    level.add_pattern(line.data(), line.data() + height);
+  }
+
+  // `_intersect_patterns`: points of `p1` also in `p2`, grouped by the
+  // difference of their shifts in the order the differences appear
+  void intersect_patterns(KhanipovLevel const &level, int p1, int p2,
+                          KhanipovLevel &next, std::vector<Parents> &parents,
+                          Scratch &scratch) const {
+    int const height = this->height;
+    scratch.diffs.clear();
+    scratch.matches.clear();
+    scratch.match_diff.clear();
+    KhanipovPoint const *pos2 = level.begin(p2);
+    KhanipovPoint const *end2 = level.end(p2);
+    for (KhanipovPoint const *pt1 = level.begin(p1); pt1 != level.end(p1);
+         ++pt1) {
+      while (pos2 != end2 && pos2->x < pt1->x) {
+        ++pos2;
+      }
+      if (pos2 == end2) {
+        break;
+      }
+      if (pos2->x == pt1->x) {
+        int const diff = pos2->y - pt1->y;
+        int &group = scratch.group_of_diff[diff + height];
+        if (group < 0) {
+          group = static_cast<int>(scratch.diffs.size());
+          scratch.diffs.emplace_back(diff);
+        }
+        scratch.matches.emplace_back(*pt1);
+        scratch.match_diff.emplace_back(group);
+      }
+    }
+    int const num_groups = static_cast<int>(scratch.diffs.size());
+    scratch.group_begin.assign(num_groups + 1, 0);
+    for (int group : scratch.match_diff) {
+      ++scratch.group_begin[group + 1];
+    }
+    for (int group = 0; group != num_groups; ++group) {
+      scratch.group_begin[group + 1] += scratch.group_begin[group];
+    }
+    scratch.grouped.resize(scratch.matches.size());
+    for (size_t idx = 0; idx != scratch.matches.size(); ++idx) {
+      scratch.grouped[scratch.group_begin[scratch.match_diff[idx]]++] =
+          scratch.matches[idx];
+    }
+    int begin = 0;
+    for (int group = 0; group != num_groups; ++group) {
+      int const end = scratch.group_begin[group];
+      KhanipovPoint *first = scratch.grouped.data() + begin;
+      int const s1 = first->y;
+      for (KhanipovPoint *pt = first; pt != scratch.grouped.data() + end;
+           ++pt) {
+        pt->y -= s1;
+      }
+      next.add_pattern(first, scratch.grouped.data() + end);
+      parents.push_back(Parents{p1, s1, p2, s1 + scratch.diffs[group]});
+      begin = end;
+      scratch.group_of_diff[scratch.diffs[group] + height] = -1;
+    }
+  }
+
+  // `_intersect_ensembles` of ensembles `e` and `e + 1`, appended to `next`
+  // as one ensemble sorted by the first row of its patterns
+  void intersect_ensembles(KhanipovLevel const &level, int e,
+                           KhanipovLevel &next, std::vector<Parents> &parents,
+                           Scratch &scratch) const {
+    KhanipovLevel found;
+    std::vector<Parents> found_parents;
+    int const end_1 = level.ensembles[e + 1];
+    int const begin_2 = end_1;
+    int const end_2 = level.ensembles[e + 2];
+    int j0 = begin_2;
+    for (int i = level.ensembles[e]; i != end_1; ++i) {
+      while (j0 != end_2 && (level.end(j0) - 1)->x < level.begin(i)->x) {
+        ++j0;
+      }
+      if (j0 == end_2) {
+        break;
+      }
+      for (int j = j0; j != end_2; ++j) {
+        if (level.begin(j)->x > (level.end(i) - 1)->x) {
+          break;
+        }
+        this->intersect_patterns(level, i, j, found, found_parents, scratch);
+      }
+    }
+    std::vector<int> order(found.num_patterns());
+    std::iota(order.begin(), order.end(), 0);
+    std::stable_sort(order.begin(), order.end(), [&](int lhs, int rhs) {
+      return found.begin(lhs)->x < found.begin(rhs)->x;
+    });
+    for (int idx : order) {
+      next.add_pattern(found.begin(idx), found.end(idx));
+      parents.emplace_back(found_parents[idx]);
+    }
+    next.close_ensemble();
+  }
+
+  KhanipovTerm term(int src, int shift) const {
+    return KhanipovTerm{src, apply_sign(Sign::Positive, shift, this->width),
+                        apply_sign(Sign::Negative, shift, this->width)};
+  }
+
+  void add_stage(std::vector<std::vector<KhanipovTerm>> const &rows) {
+    KhanipovStage stage;
+    stage.rows_begin = static_cast<int>(this->terms_begin.size()) - 1;
+    for (auto const &row : rows) {
+      this->terms.insert(this->terms.end(), row.begin(), row.end());
+      this->terms_begin.emplace_back(static_cast<int>(this->terms.size()));
+    }
+    stage.rows_end = static_cast<int>(this->terms_begin.size()) - 1;
+    this->stages.push_back(stage);
+  }
+
+  // `_khan_iter` unrolled: levels of ensembles are built from the lines
+  // down, stages are emitted from the last level up
+  void add_stages() {
+    int const height = this->height;
+    std::vector<KhanipovLevel> levels(1);
+    for (int t = 0; t != height; ++t) {
+      add_line(levels[0], height, t);
+      levels[0].close_ensemble();
+    }
+    // parents[l][p]: where pattern `p` of level `l + 1` comes from, a
+    // carried ensemble has `j` == -1
+    std::vector<std::vector<Parents>> parents;
+    Scratch scratch;
+    scratch.group_of_diff.assign(2 * static_cast<size_t>(height) + 1, -1);
+    while (levels.back().num_ensembles() > 1) {
+      KhanipovLevel const &level = levels.back();
+      KhanipovLevel next;
+      std::vector<Parents> next_parents;
+      int const pairs = level.num_ensembles() / 2;
+      for (int e = 0; e != pairs; ++e) {
+        this->intersect_ensembles(level, 2 * e, next, next_parents, scratch);
+      }
+      if (level.num_ensembles() % 2 == 1) {
+        int const e = level.num_ensembles() - 1;
+        for (int p = level.ensembles[e]; p != level.ensembles[e + 1]; ++p) {
+          next.add_pattern(level.begin(p), level.end(p));
+          next_parents.push_back(Parents{p, 0, -1, 0});
+        }
+        next.close_ensemble();
+      }
+      levels.emplace_back(std::move(next));
+      parents.emplace_back(std::move(next_parents));
+    }
+
+    KhanipovLevel const &leaf = levels.back();
+    std::vector<std::vector<KhanipovTerm>> rows(leaf.num_patterns());
+    for (int p = 0; p != leaf.num_patterns(); ++p) {
+      for (KhanipovPoint const *pt = leaf.begin(p); pt != leaf.end(p); ++pt) {
+        rows[p].emplace_back(this->term(pt->x, pt->y));
+      }
+    }
+    this->add_stage(rows);
+    for (size_t l = parents.size(); l-- != 0;) {
+      rows.assign(levels[l].num_patterns(), {});
+      auto const &from = parents[l];
+      for (int src = 0; src != static_cast<int>(from.size()); ++src) {
+        rows[from[src].i].emplace_back(this->term(src, from[src].s_i));
+        if (from[src].j >= 0) {
+          rows[from[src].j].emplace_back(this->term(src, from[src].s_j));
+        }
+      }
+      this->add_stage(rows);
+    }
+  }
+};
+
+// rows [rows_begin, rows_end) of `stage`, every one is its first term
+// rotated plus the other terms rotated and added in place
+template <typename Scalar>
+static inline void khanipov_stage(Tensor2DTyped<Scalar> const &dst,
+                                  Tensor2DTyped<Scalar> const &src, Sign sign,
+                                  KhanipovPlan const &plan,
+                                  KhanipovStage const &stage) {
+  int const width = plan.width;
+  for (int r = stage.rows_begin; r != stage.rows_end; ++r) {
+    Scalar *line = A_LINE(dst, r - stage.rows_begin);
+    KhanipovTerm const *begin = plan.terms.data() + plan.terms_begin[r];
+    KhanipovTerm const *end = plan.terms.data() + plan.terms_begin[r + 1];
+    A_NEVER(begin == end);
+    for (KhanipovTerm const *term = begin; term != end; ++term) {
+      int const shift = sign == Sign::Positive ? term->shift_positive
+                                               : term->shift_negative;
+      if (term == begin) {
+        rotate(line, A_LINE(src, term->src), width, shift);
+      } else {
+        accumulate_shifted(line, A_LINE(src, term->src), width, shift);
+      }
+    }
+  }
+}
+
+//
+// `khanipov` for one image shape. Stages alternate between two buffers of
+// the largest stage, the last one writes the output. The reference ignores
+// `sign`, `Sign::Positive` matches it and `Sign::Negative` mirrors every
+// shift as in `fht2d`.
+//
+template <typename Scalar>
+class khanipov {
+  KhanipovPlan plan;
+  std::unique_ptr<Scalar[]> buffer_data;
+  Tensor2D buffer_even;  // output of the stages an even count before last
+  Tensor2D buffer_odd;
+
+ public:
+  explicit khanipov(KhanipovPlan &&plan)
+      : plan{std::move(plan)},
+        buffer_data{new Scalar[2 * static_cast<size_t>(this->plan.max_rows()) *
+                               this->plan.width]},
+        buffer_even{this->plan.max_rows(), this->plan.width,
+                    static_cast<Tensor2D::stride_t>(this->plan.width *
+                                                    sizeof(Scalar)),
+                    reinterpret_cast<uint8_t *>(this->buffer_data.get())},
+        buffer_odd{this->buffer_even} {
+    this->buffer_odd.data = reinterpret_cast<uint8_t *>(
+        this->buffer_data.get() +
+        static_cast<size_t>(this->plan.max_rows()) * this->plan.width);
+  }
+
+  static khanipov<Scalar> create(Tensor2DTyped<Scalar> const &prototype) {
+    return khanipov<Scalar>{
+        KhanipovPlan::create(prototype.height, prototype.width)};
+  }
+
+  KhanipovPlan const &get_plan() const { return this->plan; }
+
+  void operator()(Tensor2DTyped<Scalar> const &dst,
+                  Tensor2DTyped<Scalar> const &src, Sign sign) const {
+    A_NEVER(!this->plan.matches(src.height, src.width) ||
+            dst.height != src.height || dst.width != src.width);
+    if A_UNLIKELY (this->plan.stages.empty()) {
+      copy_tensor(dst, src, sizeof(Scalar));
+      return;
+    }
+    int const last = static_cast<int>(this->plan.stages.size()) - 1;
+    Tensor2DTyped<Scalar> const *in = &src;
+    for (int idx = 0; idx <= last; ++idx) {
+      int const before_last = last - idx;
+      Tensor2DTyped<Scalar> const *out =
+          before_last == 0
+              ? &dst
+              : &((before_last & 1) ? this->buffer_odd : this->buffer_even)
+                     .template as<Scalar>();
+      khanipov_stage(*out, *in, sign, this->plan, this->plan.stages[idx]);
+      in = out;
+    }
+  }
+};
+
+}  // namespace adrt
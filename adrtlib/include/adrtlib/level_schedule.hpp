@@ -0,0 +1,149 @@
+#pragma once
+#include <functional>
+#include <memory>  // std::unique_ptr
+#include <mutex>
+#include <vector>
+
+#include "non_recursive.hpp"
+#include "thread_pool.hpp"
+
+namespace adrt {
+
+//
+// Tasks of `non_recursive` grouped by their depth in the tree. Tasks of one
+// depth cover disjoint row ranges (and disjoint parts of `swaps`), so they
+// may run concurrently once every deeper task is done.
+//
+struct LevelSchedule {
+  std::vector<ADRTTask> tasks;  // deepest level first, post-order inside
+  std::vector<int> offsets;     // level `idx` is [offsets[idx], offsets[idx+1])
+  std::vector<int> depths;      // depth of every level
+
+  template <typename MidCallback>
+  static LevelSchedule create(int height, MidCallback mid_callback) {
+    LevelSchedule schedule;
+    if (height < 2) {
+      schedule.offsets.emplace_back(0);
+      return schedule;
+    }
+    std::vector<std::vector<ADRTTask>> by_depth;
+    non_recursive(
+        height,
+        [&](ADRTTask const &task, int depth) {
+          if (by_depth.size() <= static_cast<size_t>(depth)) {
+            by_depth.resize(depth + 1);
+          }
+          by_depth[depth].emplace_back(task);
+        },
+        mid_callback);
+    schedule.offsets.emplace_back(0);
+    for (int depth = static_cast<int>(by_depth.size()) - 1; depth >= 0;
+         --depth) {
+      auto const &level = by_depth[depth];
+      if (level.empty()) {
+        continue;
+      }
+      schedule.tasks.insert(schedule.tasks.end(), level.begin(), level.end());
+      schedule.offsets.emplace_back(static_cast<int>(schedule.tasks.size()));
+      schedule.depths.emplace_back(depth);
+    }
+    return schedule;
+  }
+
+  int num_levels() const { return static_cast<int>(this->depths.size()); }
+};
+
+// Calls `callback(task, depth)` for every task, level by level, spreading the
+// tasks of a level between threads of `pool`
+template <typename Callback>
+static inline void run_levels(ThreadPool &pool, LevelSchedule const &schedule,
+                              Callback const &callback) {
+  for (int level = 0; level != schedule.num_levels(); ++level) {
+    int const depth = schedule.depths[level];
+    parallel_for(pool, schedule.offsets[level], schedule.offsets[level + 1], 1,
+                 [&](int begin, int end) {
+                   for (int idx = begin; idx != end; ++idx) {
+                     callback(schedule.tasks[idx], depth);
+                   }
+                 });
+  }
+}
+
+//
+// Per-thread scratch memory (line buffers, degree arrays) for parallel
+// execution. A workspace is leased for the duration of one task or one
+// chunk of a task and is created on first demand.
+//
+template <typename Workspace>
+class WorkspacePool {
+  std::mutex mutex;
+  std::vector<std::unique_ptr<Workspace>> free;
+  std::function<Workspace()> factory;
+
+ public:
+  explicit WorkspacePool(std::function<Workspace()> &&factory)
+      : factory{std::move(factory)} {}
+
+  class Lease {
+    WorkspacePool *pool;
+    std::unique_ptr<Workspace> workspace;
+
+   public:
+    Lease(WorkspacePool *pool, std::unique_ptr<Workspace> &&workspace)
+        : pool{pool}, workspace{std::move(workspace)} {}
+    Lease(Lease const &) = delete;
+    ~Lease() {
+      std::lock_guard<std::mutex> lock{this->pool->mutex};
+      this->pool->free.emplace_back(std::move(this->workspace));
+    }
+    Workspace *operator->() const { return this->workspace.get(); }
+    Workspace &operator*() const { return *this->workspace; }
+  };
+
+  Lease acquire() {
+    {
+      std::lock_guard<std::mutex> lock{this->mutex};
+      if (!this->free.empty()) {
+        std::unique_ptr<Workspace> workspace{std::move(this->free.back())};
+        this->free.pop_back();
+        return Lease{this, std::move(workspace)};
+      }
+    }
+    return Lease{this, std::unique_ptr<Workspace>{
+                           new Workspace(this->factory())}};
+  }
+};
+
+// Runs independent `ProcessPair` steps of a merge one after another
+template <typename Scalar>
+struct SerialPairs {
+  Scalar *buffer;
+  template <typename PairCallback>
+  void operator()(int count, PairCallback const &callback) const {
+    for (int pair = 0; pair != count; ++pair) {
+      callback(pair, this->buffer);
+    }
+  }
+};
+
+// Spreads independent `ProcessPair` steps of a merge between threads, every
+// chunk of pairs uses its own line buffer. Used for the top levels of the
+// tree, where there are fewer tasks than threads.
+template <typename Scalar, typename Workspace>
+struct ParallelPairs {
+  ThreadPool &pool;
+  WorkspacePool<Workspace> &workspaces;
+  int grain;  // pairs per chunk
+  template <typename PairCallback>
+  void operator()(int count, PairCallback const &callback) const {
+    parallel_for(this->pool, 0, count, this->grain, [&](int begin, int end) {
+      auto const workspace = this->workspaces.acquire();
+      Scalar *buffer = workspace->line_buffer.get();
+      for (int pair = begin; pair != end; ++pair) {
+        callback(pair, buffer);
+      }
+    });
+  }
+};
+
+}  // namespace adrt
@@ -0,0 +1,156 @@
+#pragma once
+#include <memory>  // std::unique_ptr
+#include <vector>
+
+#include "fht2d.hpp"
+
+namespace adrt {
+
+//
+// Rows `ts` of `ds` or `dt`, for when only a band of slopes is needed. Rows
+// of the root that are asked for mark, through the `t0` and `t1` of every
+// merge row, the rows of the children that feed them, top-down; only marked
+// rows are merged then, bottom-up. Row `i` of the output is row `ts[i]` of
+// the transform.
+//
+// A level merges about max(ts.size(), number of its steps) rows, so a band of
+// `k` slopes costs about width * (k * log2(height / k) + 2 * height)
+// additions, against width * height * log2(height) for every slope.
+//
+template <typename Scalar>
+class d_pruned {
+  MergePlan plan;  // marked rows only, the root writes rows of `ts` order
+  std::vector<int> leaves[2];  // rows of `src` read from `buffers[idx]`
+  std::unique_ptr<Scalar[]> data;
+  Tensor2D buffers[2];  // outputs of even and odd levels but the root
+  std::vector<int> ts;
+
+ public:
+  d_pruned(MergePlan const &full, std::vector<int> const &ts)
+      : data{new Scalar[2 * static_cast<size_t>(full.height) * full.width]},
+        buffers{Tensor2D{full.height, full.width,
+                         static_cast<Tensor2D::stride_t>(full.width *
+                                                         sizeof(Scalar)),
+                         reinterpret_cast<uint8_t *>(this->data.get())},
+                Tensor2D{full.height, full.width,
+                         static_cast<Tensor2D::stride_t>(full.width *
+                                                         sizeof(Scalar)),
+                         reinterpret_cast<uint8_t *>(
+                             this->data.get() +
+                             static_cast<size_t>(full.height) * full.width)}},
+        ts{ts} {
+    this->plan.height = full.height;
+    this->plan.width = full.width;
+    if (full.root() < 0) {
+      return;  // a single row
+    }
+    // top-down: steps follow their children in `full.steps`
+    std::vector<uint8_t> marked(full.rows.size());
+    for (int t : ts) {
+      A_NEVER(t < 0 || t >= full.height);
+      marked[full.steps[full.root()].rows_begin + t] = 1;
+    }
+    for (int step_idx = full.root(); step_idx >= 0; --step_idx) {
+      MergeStep const &step = full.steps[step_idx];
+      for (int idx = step.rows_begin; idx != step.rows_end; ++idx) {
+        if (!marked[idx]) {
+          continue;
+        }
+        MergeRow const &row = full.rows[idx];
+        if (step.child_T >= 0) {
+          MergeStep const &child = full.steps[step.child_T];
+          marked[child.rows_begin + row.src_T -
+                 full.rows[child.rows_begin].row] = 1;
+        }
+        if (step.child_B >= 0) {
+          MergeStep const &child = full.steps[step.child_B];
+          marked[child.rows_begin + row.src_B -
+                 full.rows[child.rows_begin].row] = 1;
+        }
+      }
+    }
+    // bottom-up: marked rows of every step, leaves its children
+    for (MergeStep step : full.steps) {
+      int const rows_begin = static_cast<int>(this->plan.rows.size());
+      if (step.level == 0) {
+        for (int i = 0; i != static_cast<int>(ts.size()); ++i) {
+          MergeRow row = full.rows[step.rows_begin + ts[i]];
+          row.row = i;
+          this->plan.rows.push_back(row);
+        }
+      } else {
+        for (int idx = step.rows_begin; idx != step.rows_end; ++idx) {
+          if (marked[idx]) {
+            this->plan.rows.push_back(full.rows[idx]);
+          }
+        }
+      }
+      if (static_cast<int>(this->plan.rows.size()) == rows_begin) {
+        continue;
+      }
+      MergeRow const &first = full.rows[step.rows_begin];
+      std::vector<int> &leaves = this->leaves[(step.level + 1) & 1];
+      if (step.child_T < 0) {
+        leaves.push_back(first.src_T);
+      }
+      if (step.child_B < 0) {
+        leaves.push_back(first.src_B);
+      }
+      step.rows_begin = rows_begin;
+      step.rows_end = static_cast<int>(this->plan.rows.size());
+      this->plan.steps.push_back(step);
+    }
+  }
+
+  // rows `ts` of the transform planned by `mid_callback`, which is that of
+  // `ds` or `dt` as in `MergePlan::create`
+  template <typename MidCallback>
+  static d_pruned<Scalar> create(Tensor2DTyped<Scalar> const &prototype,
+                                 std::vector<int> const &ts,
+                                 MidCallback mid_callback) {
+    return d_pruned<Scalar>{
+        MergePlan::create(prototype.height, prototype.width, mid_callback),
+        ts};
+  }
+
+  // rows of `dst`
+  int height() const { return static_cast<int>(this->ts.size()); }
+
+  // rows merged by a call, `width` additions each
+  int64_t merged_rows() const {
+    return static_cast<int64_t>(this->plan.rows.size());
+  }
+
+  // `src` may hold a narrower `Input` type, as in `d`
+  template <typename Input>
+  void operator()(Tensor2DTyped<Scalar> const &dst,
+                  Tensor2DTyped<Input> const &src, Sign sign) const {
+    A_NEVER(!this->plan.matches(src.height, src.width) ||
+            dst.height != this->height() || dst.width != src.width);
+    int const width = src.width;
+    if A_UNLIKELY (this->plan.steps.empty()) {
+      for (int y = 0; y != dst.height; ++y) {
+        widen_row(A_LINE(dst, y), A_LINE(src, 0), width);
+      }
+      return;
+    }
+    for (int idx : {0, 1}) {
+      auto const &buffer = this->buffers[idx].template as<Scalar>();
+      for (int y : this->leaves[idx]) {
+        widen_row(A_LINE(buffer, y), A_LINE(src, y), width);
+      }
+    }
+    MergeRow const *rows = this->plan.rows.data();
+    for (MergeStep const &step : this->plan.steps) {
+      Tensor2DTyped<Scalar> const &out =
+          step.level == 0 ? dst
+                          : this->buffers[step.level & 1].template as<Scalar>();
+      Tensor2DTyped<Scalar> const &in =
+          this->buffers[(step.level + 1) & 1].template as<Scalar>();
+      fht2ds_core(out, in, rows + step.rows_begin, rows + step.rows_end,
+                  sign);
+    }
+  }
+};
+
+}  // namespace adrt
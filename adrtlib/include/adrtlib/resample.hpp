@@ -0,0 +1,213 @@
+#pragma once
+#include <algorithm>  // std::max, std::min
+#include <cmath>      // std::floor, std::ceil
+#include <memory>     // std::unique_ptr
+#include <vector>
+
+#include "fht2d.hpp"
+
+namespace adrt {
+
+//
+// `fht2rdbu` and `fht2rubd` (see `ref/fht2resample.py`): the image is
+// resized with integral brightness to a power of two height, transformed by
+// `fht2dt` and resized back. The height is rounded down (RDBU) or up (RUBD),
+// the width is scaled in proportion.
+//
+enum class HeightRound : int_fast8_t { Floor, Ceil };
+
+static inline int round_height(int height, HeightRound round) {
+  if (height <= 1) {
+    return 1;
+  }
+  uint32_t const h = static_cast<uint32_t>(height);
+  if ((h & (h - 1)) == 0) {
+    return height;
+  }
+  uint32_t const floor = div_by_pow2(h);
+  return static_cast<int>(round == HeightRound::Floor ? floor : floor << 1);
+}
+
+//
+// Weights of `resize_with_integral_brightness` along one axis: output
+// index `i` is the sum of `taps` source samples from `first[i]`. Every
+// output has the same number of taps, padded with zero weights, so the
+// inner loop has a fixed trip count.
+//
+template <typename Scalar>
+struct ResizeAxis {
+  int taps{};
+  std::vector<int> first;
+  std::vector<Scalar> weights;  // `taps` per output index
+
+  static ResizeAxis create(int size, int new_size, double scale) {
+    ResizeAxis axis;
+    double const ratio = static_cast<double>(size) / new_size;
+    for (int i = 0; i != new_size; ++i) {
+      double const start = i * ratio;
+      double const end = (i + 1) * ratio;
+      int const i_min = std::max(0, static_cast<int>(std::floor(start)));
+      int const i_max = std::min(size, static_cast<int>(std::ceil(end)));
+      axis.taps = std::max(axis.taps, i_max - i_min);
+    }
+    axis.first.resize(new_size);
+    axis.weights.assign(static_cast<size_t>(new_size) * axis.taps, Scalar{});
+    for (int i = 0; i != new_size; ++i) {
+      double const start = i * ratio;
+      double const end = (i + 1) * ratio;
+      int const i_min = std::max(0, static_cast<int>(std::floor(start)));
+      int const i_max = std::min(size, static_cast<int>(std::ceil(end)));
+      int const first = std::min(i_min, size - axis.taps);
+      axis.first[i] = first;
+      Scalar *weights =
+          axis.weights.data() + static_cast<size_t>(i) * axis.taps;
+      for (int i0 = i_min; i0 != i_max; ++i0) {
+        double const overlap =
+            std::min(i0 + 1.0, end) - std::max(static_cast<double>(i0), start);
+        weights[i0 - first] = static_cast<Scalar>(overlap * scale);
+      }
+    }
+    return axis;
+  }
+
+  Scalar const *operator[](int i) const {
+    return this->weights.data() + static_cast<size_t>(i) * this->taps;
+  }
+};
+
+// Scales of both axes of `resize_with_integral_brightness`, the row scale
+// carries `sample_scale`
+template <typename Scalar>
+struct Resize {
+  ResizeAxis<Scalar> rows;
+  ResizeAxis<Scalar> columns;
+
+  static Resize create(int height, int width, int new_height, int new_width,
+                       bool scale_weighted_sum) {
+    double const h_ratio = static_cast<double>(height) / new_height;
+    double const w_ratio = static_cast<double>(width) / new_width;
+    double const scale_factor =
+        static_cast<double>(height) * width / (int64_t{new_height} * new_width);
+    double const sample_scale =
+        scale_weighted_sum
+            ? scale_factor / (h_ratio * h_ratio * w_ratio)
+            : scale_factor / (h_ratio * h_ratio * w_ratio * w_ratio);
+    return Resize{ResizeAxis<Scalar>::create(height, new_height, sample_scale),
+                  ResizeAxis<Scalar>::create(width, new_width, 1.0)};
+  }
+};
+
+//
+// Output row `y` of `resize`: source rows are summed into `row` with
+// vector kernels, then every output pixel gathers `columns.taps` of them
+//
+template <typename Scalar>
+static inline void resize_row(Scalar *A_RESTRICT dst,
+                              Tensor2DTyped<Scalar> const &src,
+                              Resize<Scalar> const &resize, int y,
+                              Scalar *A_RESTRICT row) {
+  int const width = src.width;
+  std::fill(row, row + width, Scalar{});
+  Scalar const *weights_y = resize.rows[y];
+  for (int k = 0; k != resize.rows.taps; ++k) {
+    if (weights_y[k] != Scalar{}) {
+      add_scaled(row, A_LINE(src, resize.rows.first[y] + k), weights_y[k],
+                 width);
+    }
+  }
+  int const taps = resize.columns.taps;
+  for (int x = 0; x != static_cast<int>(resize.columns.first.size()); ++x) {
+    Scalar const *weights_x = resize.columns[x];
+    Scalar const *samples = row + resize.columns.first[x];
+    Scalar acc{};
+    for (int k = 0; k != taps; ++k) {
+      acc += samples[k] * weights_x[k];
+    }
+    dst[x] = acc;
+  }
+}
+
+template <typename Scalar>
+static inline void resize_tensor(Tensor2DTyped<Scalar> const &dst,
+                                 Tensor2DTyped<Scalar> const &src,
+                                 Resize<Scalar> const &resize,
+                                 Scalar *row) {
+  A_NEVER(static_cast<int>(resize.rows.first.size()) != dst.height ||
+          static_cast<int>(resize.columns.first.size()) != dst.width);
+  for (int y = 0; y != dst.height; ++y) {
+    resize_row(A_LINE(dst, y), src, resize, y, row);
+  }
+}
+
+//
+// `fht2rdbu` or `fht2rubd` for one image shape. The resized image is never
+// stored on its own: its rows are written straight into the tensor that the
+// deepest merge level of `fht2dt` reads, which is `buffer` or the resized
+// output depending on the parity of the tree depth.
+//
+template <typename Scalar>
+class resample {
+  Resize<Scalar> down;  // to the power of two shape
+  Resize<Scalar> up;    // back to the image shape
+  MergePlan plan;
+  std::unique_ptr<Scalar[]> data;
+  Tensor2D out;  // transform of the resized image
+  Tensor2D buffer;
+  Scalar *row;
+
+ public:
+  resample(int height, int width, int new_height, int new_width)
+      : down{Resize<Scalar>::create(height, width, new_height, new_width,
+                                    true)},
+        up{Resize<Scalar>::create(new_height, new_width, height, width,
+                                  false)},
+        plan{MergePlan::create(new_height, new_width, dt_mid)},
+        data{new Scalar[2 * static_cast<size_t>(new_height) * new_width +
+                        std::max(width, new_width)]},
+        out{new_height, new_width,
+            static_cast<Tensor2D::stride_t>(new_width * sizeof(Scalar)),
+            reinterpret_cast<uint8_t *>(this->data.get())},
+        buffer{this->out},
+        row{this->data.get() +
+            2 * static_cast<size_t>(new_height) * new_width} {
+    this->buffer.data = reinterpret_cast<uint8_t *>(
+        this->data.get() + static_cast<size_t>(new_height) * new_width);
+  }
+
+  static resample<Scalar> create(Tensor2DTyped<Scalar> const &prototype,
+                                 HeightRound round) {
+    int const height = prototype.height;
+    int const width = prototype.width;
+    int const new_height = round_height(height, round);
+    int const new_width = std::max(
+        1, static_cast<int>(round05(static_cast<double>(width) * new_height /
+                                    std::max(height, 1))));
+    return resample<Scalar>{height, width, new_height, new_width};
+  }
+
+  // shape of the power of two image that is transformed
+  int new_height() const { return this->out.height; }
+  int new_width() const { return this->out.width; }
+
+  void operator()(Tensor2DTyped<Scalar> const &dst,
+                  Tensor2DTyped<Scalar> const &src, Sign sign) const {
+    A_NEVER(dst.height != src.height || dst.width != src.width);
+    if A_UNLIKELY (src.height == 0 || src.width == 0) {
+      return;
+    }
+    auto const &out = this->out.template as<Scalar>();
+    auto const &buffer = this->buffer.template as<Scalar>();
+    // merges of even levels read `buffer`, the first step is one of the
+    // deepest ones, right above the leaves
+    int const leaf_level =
+        this->plan.steps.empty() ? 0 : this->plan.steps.front().level + 1;
+    resize_tensor((leaf_level & 1) == 0 ? out : buffer, src, this->down,
+                  this->row);
+    if (this->plan.root() >= 0) {
+      fht2ds_recursive_(out, buffer, this->plan, this->plan.root(), sign);
+    }
+    resize_tensor(dst, out, this->up, this->row);
+  }
+};
+
+}  // namespace adrt
@@ -0,0 +1,176 @@
+#pragma once
+#include <algorithm>  // std::min, std::max
+#include <cstring>    // std::memcpy
+#include <memory>     // std::unique_ptr
+#include <vector>
+
+#include "fht2d.hpp"
+
+namespace adrt {
+
+// `count` columns from `begin`, cyclic in the width of the image
+struct ColumnWindow {
+  int begin;
+  int count;
+};
+
+//
+// dst[x] = src0[x] + src1[x - shift] for the columns `x` of `window`, cyclic
+// in `width`. `dst` holds them from its first column when `packed` and at
+// column `x` otherwise.
+//
+template <typename Scalar>
+static inline void add_with_2nd_shifted(Scalar *A_RESTRICT dst,
+                                        Scalar const *A_RESTRICT src0,
+                                        Scalar const *A_RESTRICT src1,
+                                        int const width, int const shift,
+                                        ColumnWindow const &window,
+                                        bool packed) {
+  A_NEVER(window.count <= 0 || window.count > width);
+  int x = window.begin;
+  int x1 = (x - shift + width) % width;
+  for (int done = 0; done != window.count;) {
+    int const run =
+        std::min(window.count - done, std::min(width - x, width - x1));
+    add(packed ? dst + done : dst + x, src0 + x, src1 + x1, run);
+    done += run;
+    x = (x + run) % width;
+    x1 = (x1 + run) % width;
+  }
+}
+
+//
+// Columns [column_begin, column_end) of `ds` or `dt`. A merge row reads the
+// top child at its own columns and the bottom child at columns shifted by
+// its shift, so the window of a step passes to its top child as is and to
+// its bottom child widened by the range of shifts of the step. Lower levels
+// merge their windows only, which stop growing at the full width.
+//
+// `dst` is (height, column_end - column_begin), its stride may be that of a
+// larger buffer that the window is written into. A bottom child's window
+// grows by about half the height of its parent, so windows reach about
+// `height` columns near the leaves and the savings show when `width` is
+// larger than `height`.
+//
+template <typename Scalar>
+class d_roi {
+  MergePlan plan;
+  std::vector<ColumnWindow> windows[2];  // of every step, for `Sign` 1, -1
+  int column_begin;
+  std::unique_ptr<Scalar[]> data;
+  Tensor2D buffers[2];  // outputs of even and odd levels but the root
+
+  static int sign_idx(Sign sign) { return sign == Sign::Positive ? 0 : 1; }
+
+ public:
+  d_roi(MergePlan &&plan, int column_begin, int column_end)
+      : plan{std::move(plan)},
+        column_begin{column_begin},
+        data{new Scalar[2 * static_cast<size_t>(this->plan.height) *
+                        this->plan.width]},
+        buffers{Tensor2D{this->plan.height, this->plan.width,
+                         static_cast<Tensor2D::stride_t>(this->plan.width *
+                                                         sizeof(Scalar)),
+                         reinterpret_cast<uint8_t *>(this->data.get())},
+                Tensor2D{this->plan.height, this->plan.width,
+                         static_cast<Tensor2D::stride_t>(this->plan.width *
+                                                         sizeof(Scalar)),
+                         reinterpret_cast<uint8_t *>(
+                             this->data.get() +
+                             static_cast<size_t>(this->plan.height) *
+                                 this->plan.width)}} {
+    int const width = this->plan.width;
+    A_NEVER(column_begin < 0 || column_begin >= column_end ||
+            column_end > width);
+    for (Sign sign : {Sign::Positive, Sign::Negative}) {
+      std::vector<ColumnWindow> &windows = this->windows[sign_idx(sign)];
+      windows.resize(this->plan.steps.size(),
+                     ColumnWindow{column_begin, column_end - column_begin});
+      // top-down: steps follow their children
+      for (int step_idx = this->plan.root(); step_idx >= 0; --step_idx) {
+        MergeStep const &step = this->plan.steps[step_idx];
+        MergeRow const *const rows = this->plan.rows.data();
+        MergeRow const &first = rows[step.rows_begin];
+        int min_shift = width, max_shift = 0;
+        for (int idx = step.rows_begin; idx != step.rows_end; ++idx) {
+          // `t - t1` of `MergePlan::create`
+          int const shift = (rows[idx].row - first.row) -
+                            (rows[idx].src_B - first.src_B);
+          min_shift = std::min(min_shift, shift);
+          max_shift = std::max(max_shift, shift);
+        }
+        ColumnWindow const &window = windows[step_idx];
+        if (step.child_T >= 0) {
+          windows[step.child_T] = window;
+        }
+        if (step.child_B >= 0) {
+          int const begin = sign == Sign::Positive
+                                ? window.begin - max_shift % width + width
+                                : window.begin + min_shift;
+          windows[step.child_B] = ColumnWindow{
+              begin % width,
+              std::min(width, window.count + max_shift - min_shift)};
+        }
+      }
+    }
+  }
+
+  // `mid_callback` of `ds` or `dt`, as in `MergePlan::create`
+  template <typename MidCallback>
+  static d_roi<Scalar> create(Tensor2DTyped<Scalar> const &prototype,
+                              int column_begin, int column_end,
+                              MidCallback mid_callback) {
+    return d_roi<Scalar>{
+        MergePlan::create(prototype.height, prototype.width, mid_callback),
+        column_begin, column_end};
+  }
+
+  // columns merged by a call, the full transform merges height * width per
+  // level
+  int64_t merged_columns(Sign sign) const {
+    int64_t columns = 0;
+    std::vector<ColumnWindow> const &windows = this->windows[sign_idx(sign)];
+    for (size_t idx = 0; idx != windows.size(); ++idx) {
+      MergeStep const &step = this->plan.steps[idx];
+      columns += static_cast<int64_t>(step.rows_end - step.rows_begin) *
+                 windows[idx].count;
+    }
+    return columns;
+  }
+
+  // leaves are read from `src` directly
+  void operator()(Tensor2DTyped<Scalar> const &dst,
+                  Tensor2DTyped<Scalar> const &src, Sign sign) const {
+    int const width = src.width;
+    A_NEVER(!this->plan.matches(src.height, width) ||
+            dst.height != src.height);
+    if A_UNLIKELY (this->plan.root() < 0) {
+      std::memcpy(A_LINE(dst, 0), A_LINE(src, 0) + this->column_begin,
+                  dst.width * sizeof(Scalar));
+      return;
+    }
+    A_NEVER(dst.width != this->windows[0][this->plan.root()].count);
+    std::vector<ColumnWindow> const &windows = this->windows[sign_idx(sign)];
+    MergeRow const *const rows = this->plan.rows.data();
+    for (size_t idx = 0; idx != windows.size(); ++idx) {
+      MergeStep const &step = this->plan.steps[idx];
+      bool const root = step.level == 0;
+      Tensor2DTyped<Scalar> const &out =
+          root ? dst : this->buffers[step.level & 1].template as<Scalar>();
+      Tensor2DTyped<Scalar> const &in =
+          this->buffers[(step.level + 1) & 1].template as<Scalar>();
+      Tensor2DTyped<Scalar> const &in_T = step.child_T < 0 ? src : in;
+      Tensor2DTyped<Scalar> const &in_B = step.child_B < 0 ? src : in;
+      MergeRow const *const end = rows + step.rows_end;
+      for (MergeRow const *row = rows + step.rows_begin; row != end; ++row) {
+        add_with_2nd_shifted(A_LINE(out, row->row), A_LINE(in_T, row->src_T),
+                             A_LINE(in_B, row->src_B), width,
+                             sign == Sign::Positive ? row->shift_positive
+                                                    : row->shift_negative,
+                             windows[idx], root);
+      }
+    }
+  }
+};
+
+}  // namespace adrt
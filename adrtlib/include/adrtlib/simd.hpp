@@ -0,0 +1,464 @@
+#pragma once
+#include <atomic>
+#include <cstdint>
+#include <type_traits>
+
+#include "common.hpp"
+
+#if defined(__x86_64__) || defined(__i386__) || defined(_M_X64) || \
+    (defined(_M_IX86) && _M_IX86_FP >= 2)
+#define A_SIMD_X86 1
+#include <immintrin.h>
+#if defined(_MSC_VER) && !defined(__clang__)
+#include <intrin.h>  // __cpuid, __cpuidex, _xgetbv
+#endif
+#endif
+
+#if defined(__GNUC__)
+#define A_TARGET(isa) __attribute__((target(isa)))
+#else
+#define A_TARGET(isa)
+#endif
+
+namespace adrt {
+namespace simd {
+
+// Instruction set levels, ordered. Every level implies all lower levels.
+enum class ISA : int_fast8_t {
+  Scalar = 0,
+  SSE2 = 1,
+  AVX2 = 2,
+  AVX512 = 3,
+};
+
+static inline char const *isa_name(ISA isa) {
+  switch (isa) {
+    case ISA::Scalar:
+      return "scalar";
+    case ISA::SSE2:
+      return "sse2";
+    case ISA::AVX2:
+      return "avx2";
+    case ISA::AVX512:
+      return "avx512";
+  }
+  return "unknown";
+}
+
+// Highest level supported by both this build and the CPU we are running on
+static inline ISA detect_isa() {
+#if defined(A_SIMD_X86)
+#if defined(__GNUC__)
+  __builtin_cpu_init();
+  if (__builtin_cpu_supports("avx512f")) {
+    return ISA::AVX512;
+  }
+  if (__builtin_cpu_supports("avx2")) {
+    return ISA::AVX2;
+  }
+  if (__builtin_cpu_supports("sse2")) {
+    return ISA::SSE2;
+  }
+  return ISA::Scalar;
+#elif defined(_MSC_VER)
+  int regs[4];
+  __cpuid(regs, 0);
+  int const max_leaf = regs[0];
+  __cpuid(regs, 1);
+  bool const has_sse2 = (regs[3] & (1 << 26)) != 0;
+  bool const has_osxsave = (regs[2] & (1 << 27)) != 0;
+  if (!has_sse2) {
+    return ISA::Scalar;
+  }
+  if (max_leaf < 7 || !has_osxsave) {
+    return ISA::SSE2;
+  }
+  unsigned long long const xcr0 = _xgetbv(0);
+  bool const os_avx = (xcr0 & 0x6) == 0x6;
+  bool const os_avx512 = (xcr0 & 0xE6) == 0xE6;
+  __cpuidex(regs, 7, 0);
+  if (os_avx512 && (regs[1] & (1 << 16)) != 0) {
+    return ISA::AVX512;
+  }
+  if (os_avx && (regs[1] & (1 << 5)) != 0) {
+    return ISA::AVX2;
+  }
+  return ISA::SSE2;
+#else
+  return ISA::Scalar;
+#endif
+#else
+  return ISA::Scalar;
+#endif
+}
+
+// `active` is read by every kernel call, possibly while another thread
+// calls `set_isa`. Relaxed loads are enough, nothing else is published
+// through it.
+struct ISAState {
+  ISA supported;
+  std::atomic<ISA> active;
+};
+
+inline ISAState isa_state{detect_isa(), detect_isa()};
+
+static inline ISA supported_isa() { return isa_state.supported; }
+static inline ISA active_isa() {
+  return isa_state.active.load(std::memory_order_relaxed);
+}
+
+// Force kernels of a given level. Levels above what the CPU supports are
+// clamped. Returns the level that is actually active. Transforms already
+// running may switch kernels between rows.
+static inline ISA set_isa(ISA isa) {
+  ISA const active =
+      static_cast<int>(isa) > static_cast<int>(isa_state.supported)
+          ? isa_state.supported
+          : isa;
+  isa_state.active.store(active, std::memory_order_relaxed);
+  return active;
+}
+
+// dst += src * weight. The compiler may contract it to FMA where the target
+// has it, so the last bit may depend on the active ISA.
+template <typename Scalar>
+static inline void add_scaled_scalar(Scalar *dst, Scalar const *src,
+                                     Scalar weight, int const width) {
+  for (int i = 0; i != width; ++i) {
+    dst[i] += src[i] * weight;
+  }
+}
+
+template <typename Scalar>
+static inline void add_scalar(Scalar *dst, Scalar const *src0,
+                              Scalar const *src1, int const width) {
+  for (int i = 0; i != width; ++i) {
+    dst[i] = src0[i] + src1[i];
+  }
+}
+
+#if defined(A_SIMD_X86)
+
+// Unsigned types share kernels with signed ones: addition wraps the same way
+template <typename Scalar>
+using lane_t = std::conditional_t<
+    std::is_floating_point_v<Scalar>, Scalar,
+    std::conditional_t<sizeof(Scalar) == 4, int32_t, int64_t>>;
+
+template <typename Lane>
+struct sse2_ops;
+
+template <>
+struct sse2_ops<float> {
+  static constexpr int lanes = 4;
+  A_TARGET("sse2") static inline void add(float *d, float const *a,
+                                          float const *b) {
+    _mm_storeu_ps(d, _mm_add_ps(_mm_loadu_ps(a), _mm_loadu_ps(b)));
+  }
+  A_TARGET("sse2") static inline void add_scaled(float *d, float const *a,
+                                                 float w) {
+    _mm_storeu_ps(d, _mm_add_ps(_mm_loadu_ps(d),
+                                _mm_mul_ps(_mm_loadu_ps(a), _mm_set1_ps(w))));
+  }
+};
+
+template <>
+struct sse2_ops<double> {
+  static constexpr int lanes = 2;
+  A_TARGET("sse2") static inline void add(double *d, double const *a,
+                                          double const *b) {
+    _mm_storeu_pd(d, _mm_add_pd(_mm_loadu_pd(a), _mm_loadu_pd(b)));
+  }
+  A_TARGET("sse2") static inline void add_scaled(double *d, double const *a,
+                                                 double w) {
+    _mm_storeu_pd(d, _mm_add_pd(_mm_loadu_pd(d),
+                                _mm_mul_pd(_mm_loadu_pd(a), _mm_set1_pd(w))));
+  }
+};
+
+template <>
+struct sse2_ops<int32_t> {
+  static constexpr int lanes = 4;
+  A_TARGET("sse2") static inline void add(int32_t *d, int32_t const *a,
+                                          int32_t const *b) {
+    _mm_storeu_si128(reinterpret_cast<__m128i *>(d),
+                     _mm_add_epi32(_mm_loadu_si128((__m128i const *)a),
+                                   _mm_loadu_si128((__m128i const *)b)));
+  }
+};
+
+template <>
+struct sse2_ops<int64_t> {
+  static constexpr int lanes = 2;
+  A_TARGET("sse2") static inline void add(int64_t *d, int64_t const *a,
+                                          int64_t const *b) {
+    _mm_storeu_si128(reinterpret_cast<__m128i *>(d),
+                     _mm_add_epi64(_mm_loadu_si128((__m128i const *)a),
+                                   _mm_loadu_si128((__m128i const *)b)));
+  }
+};
+
+template <typename Lane>
+struct avx2_ops;
+
+template <>
+struct avx2_ops<float> {
+  static constexpr int lanes = 8;
+  A_TARGET("avx2") static inline void add(float *d, float const *a,
+                                          float const *b) {
+    _mm256_storeu_ps(d, _mm256_add_ps(_mm256_loadu_ps(a), _mm256_loadu_ps(b)));
+  }
+  A_TARGET("avx2") static inline void add_scaled(float *d, float const *a,
+                                                 float w) {
+    _mm256_storeu_ps(d, _mm256_add_ps(_mm256_loadu_ps(d),
+                                      _mm256_mul_ps(_mm256_loadu_ps(a),
+                                                    _mm256_set1_ps(w))));
+  }
+};
+
+template <>
+struct avx2_ops<double> {
+  static constexpr int lanes = 4;
+  A_TARGET("avx2") static inline void add(double *d, double const *a,
+                                          double const *b) {
+    _mm256_storeu_pd(d, _mm256_add_pd(_mm256_loadu_pd(a), _mm256_loadu_pd(b)));
+  }
+  A_TARGET("avx2") static inline void add_scaled(double *d, double const *a,
+                                                 double w) {
+    _mm256_storeu_pd(d, _mm256_add_pd(_mm256_loadu_pd(d),
+                                      _mm256_mul_pd(_mm256_loadu_pd(a),
+                                                    _mm256_set1_pd(w))));
+  }
+};
+
+template <>
+struct avx2_ops<int32_t> {
+  static constexpr int lanes = 8;
+  A_TARGET("avx2") static inline void add(int32_t *d, int32_t const *a,
+                                          int32_t const *b) {
+    _mm256_storeu_si256(
+        reinterpret_cast<__m256i *>(d),
+        _mm256_add_epi32(_mm256_loadu_si256((__m256i const *)a),
+                         _mm256_loadu_si256((__m256i const *)b)));
+  }
+};
+
+template <>
+struct avx2_ops<int64_t> {
+  static constexpr int lanes = 4;
+  A_TARGET("avx2") static inline void add(int64_t *d, int64_t const *a,
+                                          int64_t const *b) {
+    _mm256_storeu_si256(
+        reinterpret_cast<__m256i *>(d),
+        _mm256_add_epi64(_mm256_loadu_si256((__m256i const *)a),
+                         _mm256_loadu_si256((__m256i const *)b)));
+  }
+};
+
+template <typename Lane>
+struct avx512_ops;
+
+template <>
+struct avx512_ops<float> {
+  static constexpr int lanes = 16;
+  A_TARGET("avx512f") static inline void add(float *d, float const *a,
+                                             float const *b) {
+    _mm512_storeu_ps(d, _mm512_add_ps(_mm512_loadu_ps(a), _mm512_loadu_ps(b)));
+  }
+  A_TARGET("avx512f") static inline void add_scaled(float *d, float const *a,
+                                                    float w) {
+    _mm512_storeu_ps(d, _mm512_add_ps(_mm512_loadu_ps(d),
+                                      _mm512_mul_ps(_mm512_loadu_ps(a),
+                                                    _mm512_set1_ps(w))));
+  }
+};
+
+template <>
+struct avx512_ops<double> {
+  static constexpr int lanes = 8;
+  A_TARGET("avx512f") static inline void add(double *d, double const *a,
+                                             double const *b) {
+    _mm512_storeu_pd(d, _mm512_add_pd(_mm512_loadu_pd(a), _mm512_loadu_pd(b)));
+  }
+  A_TARGET("avx512f") static inline void add_scaled(double *d, double const *a,
+                                                    double w) {
+    _mm512_storeu_pd(d, _mm512_add_pd(_mm512_loadu_pd(d),
+                                      _mm512_mul_pd(_mm512_loadu_pd(a),
+                                                    _mm512_set1_pd(w))));
+  }
+};
+
+template <>
+struct avx512_ops<int32_t> {
+  static constexpr int lanes = 16;
+  A_TARGET("avx512f") static inline void add(int32_t *d, int32_t const *a,
+                                             int32_t const *b) {
+    _mm512_storeu_si512(d, _mm512_add_epi32(_mm512_loadu_si512(a),
+                                            _mm512_loadu_si512(b)));
+  }
+};
+
+template <>
+struct avx512_ops<int64_t> {
+  static constexpr int lanes = 8;
+  A_TARGET("avx512f") static inline void add(int64_t *d, int64_t const *a,
+                                             int64_t const *b) {
+    _mm512_storeu_si512(d, _mm512_add_epi64(_mm512_loadu_si512(a),
+                                            _mm512_loadu_si512(b)));
+  }
+};
+
+// `dst` may be equal to `src0` or `src1`: every vector is loaded before it is
+// stored, so in-place accumulation is fine. Partial overlap is not allowed.
+template <typename Scalar>
+A_TARGET("sse2")
+static void add_sse2(Scalar *dst, Scalar const *src0, Scalar const *src1,
+                     int const width) {
+  using Lane = lane_t<Scalar>;
+  using ops = sse2_ops<Lane>;
+  Lane *d = reinterpret_cast<Lane *>(dst);
+  Lane const *a = reinterpret_cast<Lane const *>(src0);
+  Lane const *b = reinterpret_cast<Lane const *>(src1);
+  int i = 0;
+  for (; i + 2 * ops::lanes <= width; i += 2 * ops::lanes) {
+    ops::add(d + i, a + i, b + i);
+    ops::add(d + i + ops::lanes, a + i + ops::lanes, b + i + ops::lanes);
+  }
+  for (; i + ops::lanes <= width; i += ops::lanes) {
+    ops::add(d + i, a + i, b + i);
+  }
+  for (; i != width; ++i) {
+    dst[i] = src0[i] + src1[i];
+  }
+}
+
+template <typename Scalar>
+A_TARGET("avx2")
+static void add_avx2(Scalar *dst, Scalar const *src0, Scalar const *src1,
+                     int const width) {
+  using Lane = lane_t<Scalar>;
+  using ops = avx2_ops<Lane>;
+  Lane *d = reinterpret_cast<Lane *>(dst);
+  Lane const *a = reinterpret_cast<Lane const *>(src0);
+  Lane const *b = reinterpret_cast<Lane const *>(src1);
+  int i = 0;
+  for (; i + 2 * ops::lanes <= width; i += 2 * ops::lanes) {
+    ops::add(d + i, a + i, b + i);
+    ops::add(d + i + ops::lanes, a + i + ops::lanes, b + i + ops::lanes);
+  }
+  for (; i + ops::lanes <= width; i += ops::lanes) {
+    ops::add(d + i, a + i, b + i);
+  }
+  for (; i != width; ++i) {
+    dst[i] = src0[i] + src1[i];
+  }
+}
+
+template <typename Scalar>
+A_TARGET("avx512f")
+static void add_avx512(Scalar *dst, Scalar const *src0, Scalar const *src1,
+                       int const width) {
+  using Lane = lane_t<Scalar>;
+  using ops = avx512_ops<Lane>;
+  Lane *d = reinterpret_cast<Lane *>(dst);
+  Lane const *a = reinterpret_cast<Lane const *>(src0);
+  Lane const *b = reinterpret_cast<Lane const *>(src1);
+  int i = 0;
+  for (; i + 2 * ops::lanes <= width; i += 2 * ops::lanes) {
+    ops::add(d + i, a + i, b + i);
+    ops::add(d + i + ops::lanes, a + i + ops::lanes, b + i + ops::lanes);
+  }
+  for (; i + ops::lanes <= width; i += ops::lanes) {
+    ops::add(d + i, a + i, b + i);
+  }
+  for (; i != width; ++i) {
+    dst[i] = src0[i] + src1[i];
+  }
+}
+
+template <typename Scalar>
+A_TARGET("sse2")
+static void add_scaled_sse2(Scalar *dst, Scalar const *src, Scalar weight,
+                            int const width) {
+  using ops = sse2_ops<Scalar>;
+  int i = 0;
+  for (; i + ops::lanes <= width; i += ops::lanes) {
+    ops::add_scaled(dst + i, src + i, weight);
+  }
+  add_scaled_scalar(dst + i, src + i, weight, width - i);
+}
+
+template <typename Scalar>
+A_TARGET("avx2")
+static void add_scaled_avx2(Scalar *dst, Scalar const *src, Scalar weight,
+                            int const width) {
+  using ops = avx2_ops<Scalar>;
+  int i = 0;
+  for (; i + ops::lanes <= width; i += ops::lanes) {
+    ops::add_scaled(dst + i, src + i, weight);
+  }
+  add_scaled_scalar(dst + i, src + i, weight, width - i);
+}
+
+template <typename Scalar>
+A_TARGET("avx512f")
+static void add_scaled_avx512(Scalar *dst, Scalar const *src, Scalar weight,
+                              int const width) {
+  using ops = avx512_ops<Scalar>;
+  int i = 0;
+  for (; i + ops::lanes <= width; i += ops::lanes) {
+    ops::add_scaled(dst + i, src + i, weight);
+  }
+  add_scaled_scalar(dst + i, src + i, weight, width - i);
+}
+
+#endif  // A_SIMD_X86
+
+template <typename Scalar>
+static inline void add(Scalar *dst, Scalar const *src0, Scalar const *src1,
+                       int const width, ISA isa) {
+  A_NEVER(width < 0);
+#if defined(A_SIMD_X86)
+  static_assert(std::is_same_v<Scalar, float> ||
+                    std::is_same_v<Scalar, double> ||
+                    (std::is_integral_v<Scalar> &&
+                     (sizeof(Scalar) == 4 || sizeof(Scalar) == 8)),
+                "unsupported scalar type");
+  switch (isa) {
+    case ISA::AVX512:
+      return add_avx512(dst, src0, src1, width);
+    case ISA::AVX2:
+      return add_avx2(dst, src0, src1, width);
+    case ISA::SSE2:
+      return add_sse2(dst, src0, src1, width);
+    case ISA::Scalar:
+      break;
+  }
+#endif
+  add_scalar(dst, src0, src1, width);
+}
+
+// Floating point only, integer images are not resampled
+template <typename Scalar>
+static inline void add_scaled(Scalar *dst, Scalar const *src, Scalar weight,
+                              int const width, ISA isa) {
+  static_assert(std::is_floating_point_v<Scalar>,
+                "unsupported scalar type");
+  A_NEVER(width < 0);
+#if defined(A_SIMD_X86)
+  switch (isa) {
+    case ISA::AVX512:
+      return add_scaled_avx512(dst, src, weight, width);
+    case ISA::AVX2:
+      return add_scaled_avx2(dst, src, weight, width);
+    case ISA::SSE2:
+      return add_scaled_sse2(dst, src, weight, width);
+    case ISA::Scalar:
+      break;
+  }
+#endif
+  add_scaled_scalar(dst, src, weight, width);
+}
+
+}  // namespace simd
+}  // namespace adrt
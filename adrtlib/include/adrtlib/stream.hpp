@@ -0,0 +1,132 @@
+#pragma once
+#include <memory>  // std::unique_ptr
+
+#include "fht2d.hpp"
+
+namespace adrt {
+
+//
+// `dt` of a sliding window over a stream of rows, as line-scan cameras
+// deliver them. The window of `height` rows is cut into blocks of `block`
+// rows, a power of two that divides `height`. Then every block is a subtree
+// of the merge tree of the window, wherever the window starts on a block
+// boundary. Block transforms are computed once, when their rows arrive, and
+// kept in a ring indexed by the stream row number modulo `height`.
+//
+// Merges above the blocks cover other rows after every shift of the window,
+// so they are recomputed for every window and read blocks straight from the
+// ring: a window costs height * width * log2(height / block) additions plus
+// the transforms of its new blocks, instead of height * width *
+// log2(height).
+//
+template <typename Scalar>
+class dt_stream {
+  int block;
+  Sign sign;
+  d<Scalar> block_transform;
+  MergePlan plan;  // of the whole window
+  std::unique_ptr<Scalar[]> data;
+  Tensor2D ring;
+  Tensor2D buffer;
+  int64_t rows_seen{};
+
+  // row `y` of the window, which is `rows_seen - height + y` in the stream
+  Scalar *ring_line(int y) const {
+    int const height = this->ring.height;
+    return A_LINE(this->ring.template as<Scalar>(),
+                  static_cast<int>((this->rows_seen + y) % height));
+  }
+
+  int step_height(MergeStep const &step) const {
+    return step.rows_end - step.rows_begin;
+  }
+
+ public:
+  dt_stream(int height, int width, int block, Sign sign)
+      : block{block},
+        sign{sign},
+        block_transform{d<Scalar>::create(
+            Tensor2D{block, width,
+                     static_cast<Tensor2D::stride_t>(width * sizeof(Scalar)),
+                     nullptr}
+                .as<Scalar>())},
+        plan{MergePlan::create(height, width, dt_mid)},
+        data{new Scalar[2 * static_cast<size_t>(height) * width]},
+        ring{height, width,
+             static_cast<Tensor2D::stride_t>(width * sizeof(Scalar)),
+             reinterpret_cast<uint8_t *>(this->data.get())},
+        buffer{this->ring} {
+    A_NEVER(block < 1 || (block & (block - 1)) != 0 || height % block != 0);
+    this->buffer.data = reinterpret_cast<uint8_t *>(
+        this->data.get() + static_cast<size_t>(height) * width);
+  }
+
+  // `block` must be a power of two that divides the height of `prototype`
+  static dt_stream<Scalar> create(Tensor2DTyped<Scalar> const &prototype,
+                                  int block, Sign sign) {
+    return dt_stream<Scalar>{prototype.height, prototype.width, block, sign};
+  }
+
+  int height() const { return this->ring.height; }
+  int width() const { return this->ring.width; }
+  int block_height() const { return this->block; }
+
+  // a full window has been pushed
+  bool ready() const { return this->rows_seen >= this->ring.height; }
+
+  // Appends `rows`, a whole number of blocks, the oldest rows leave the
+  // window. `Input` may be narrower than `Scalar` as in `d`.
+  template <typename Input>
+  void push(Tensor2DTyped<Input> const &rows) {
+    A_NEVER(rows.width != this->ring.width || rows.height % this->block != 0);
+    int const height = this->ring.height;
+    for (int begin = 0; begin != rows.height; begin += this->block) {
+      int const ring_begin = static_cast<int>(this->rows_seen % height);
+      Tensor2D const src{slice_no_checks(rows, begin, begin + this->block)};
+      Tensor2D const dst{
+          slice_no_checks(this->ring, ring_begin, ring_begin + this->block)};
+      this->block_transform.dt_non_recursive(
+          dst.as<Scalar>(), src.template as<Input>(), this->sign);
+      this->rows_seen += this->block;
+    }
+  }
+
+  // `dt` of the window, `dst` has its shape
+  void operator()(Tensor2DTyped<Scalar> const &dst) const {
+    A_NEVER(!this->ready() || dst.height != this->ring.height ||
+            dst.width != this->ring.width);
+    int const width = this->ring.width;
+    if A_UNLIKELY (this->block == this->ring.height) {
+      // the window is one block, which starts the ring
+      copy_tensor(dst, this->ring, sizeof(Scalar));
+      return;
+    }
+    auto const &buffer = this->buffer.template as<Scalar>();
+    for (MergeStep const &step : this->plan.steps) {
+      int const height = this->step_height(step);
+      if (height <= this->block) {
+        continue;  // inside a block
+      }
+      bool const even = (step.level & 1) == 0;
+      Tensor2DTyped<Scalar> const &out = even ? dst : buffer;
+      Tensor2DTyped<Scalar> const &in = even ? buffer : dst;
+      MergeRow const *const begin = this->plan.rows.data() + step.rows_begin;
+      MergeRow const *const end = this->plan.rows.data() + step.rows_end;
+      int const height_T = begin->src_B - begin->row;
+      bool const ring_T = height_T == this->block;
+      bool const ring_B = height - height_T == this->block;
+      for (MergeRow const *row = begin; row != end; ++row) {
+        Scalar *line_T =
+            ring_T ? this->ring_line(row->src_T) : A_LINE(in, row->src_T);
+        Scalar *line_B =
+            ring_B ? this->ring_line(row->src_B) : A_LINE(in, row->src_B);
+        add_with_2nd_shifted(A_LINE(out, row->row), line_T, line_B, width,
+                             this->sign == Sign::Positive
+                                 ? row->shift_positive
+                                 : row->shift_negative);
+      }
+    }
+  }
+};
+
+}  // namespace adrt
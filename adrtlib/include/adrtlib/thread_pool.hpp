@@ -0,0 +1,266 @@
+#pragma once
+#include <algorithm>  // std::max, std::min
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>  // std::unique_ptr
+#include <mutex>
+#include <thread>
+#include <utility>  // std::exchange, std::forward
+#include <vector>
+
+namespace adrt {
+
+//
+// Work-stealing thread pool. Every worker owns a deque: it pushes and pops
+// its own tasks at the back and steals from the front of the other deques.
+// Threads waiting for a `TaskGroup` execute pending tasks instead of
+// blocking, so groups may be nested freely, even in a pool with no workers.
+//
+class ThreadPool {
+  using Task = std::function<void()>;
+  struct Queue {
+    std::mutex mutex;
+    std::deque<Task> tasks;
+  };
+  // queues[0] is shared by threads that are not workers of this pool
+  std::vector<std::unique_ptr<Queue>> queues;
+  std::vector<std::thread> threads;
+  std::atomic<int> queued{0};
+  std::mutex sleep_mutex;
+  std::condition_variable wake;
+  bool stop{false};
+
+  struct Current {
+    ThreadPool const *pool;
+    size_t queue_idx;
+  };
+  static Current &current() {
+    static thread_local Current current{nullptr, 0};
+    return current;
+  }
+  size_t own_queue() const {
+    Current const &cur = current();
+    return cur.pool == this ? cur.queue_idx : 0;
+  }
+
+  bool pop(size_t queue_idx, Task &task, bool back) {
+    Queue &queue = *this->queues[queue_idx];
+    std::lock_guard<std::mutex> lock{queue.mutex};
+    if (queue.tasks.empty()) {
+      return false;
+    }
+    if (back) {
+      task = std::move(queue.tasks.back());
+      queue.tasks.pop_back();
+    } else {
+      task = std::move(queue.tasks.front());
+      queue.tasks.pop_front();
+    }
+    this->queued.fetch_sub(1, std::memory_order_relaxed);
+    return true;
+  }
+
+  void worker(size_t queue_idx) {
+    current() = Current{this, queue_idx};
+    for (;;) {
+      if (this->try_run_one()) {
+        continue;
+      }
+      std::unique_lock<std::mutex> lock{this->sleep_mutex};
+      this->wake.wait(lock, [this] {
+        return this->stop || this->queued.load(std::memory_order_relaxed) > 0;
+      });
+      if (this->stop && this->queued.load(std::memory_order_relaxed) == 0) {
+        return;
+      }
+    }
+  }
+
+ public:
+  // by default the calling thread together with the workers occupy every
+  // hardware thread
+  static unsigned default_workers() {
+    unsigned const hardware = std::thread::hardware_concurrency();
+    return hardware > 1 ? hardware - 1 : 0;
+  }
+
+  explicit ThreadPool(unsigned num_workers = default_workers()) {
+    this->queues.reserve(num_workers + 1);
+    for (unsigned idx = 0; idx != num_workers + 1; ++idx) {
+      this->queues.emplace_back(new Queue);
+    }
+    this->threads.reserve(num_workers);
+    for (unsigned idx = 0; idx != num_workers; ++idx) {
+      this->threads.emplace_back([this, idx] { this->worker(idx + 1); });
+    }
+  }
+  ThreadPool(ThreadPool const &) = delete;
+  ThreadPool &operator=(ThreadPool const &) = delete;
+
+  ~ThreadPool() {
+    {
+      std::lock_guard<std::mutex> lock{this->sleep_mutex};
+      this->stop = true;
+    }
+    this->wake.notify_all();
+    for (auto &thread : this->threads) {
+      thread.join();
+    }
+  }
+
+  // number of threads that execute tasks, including the waiting caller
+  unsigned concurrency() const {
+    return static_cast<unsigned>(this->threads.size()) + 1;
+  }
+
+  void submit(Task &&task) {
+    Queue &queue = *this->queues[this->own_queue()];
+    {
+      std::lock_guard<std::mutex> lock{queue.mutex};
+      queue.tasks.emplace_back(std::move(task));
+    }
+    {
+      std::lock_guard<std::mutex> lock{this->sleep_mutex};
+      this->queued.fetch_add(1, std::memory_order_relaxed);
+    }
+    this->wake.notify_one();
+  }
+
+  // Runs one task: own queue first (newest task), then steals the oldest
+  // task of another queue. Returns false when no task was found.
+  bool try_run_one() {
+    size_t const own = this->own_queue();
+    Task task;
+    bool found = this->pop(own, task, true);
+    for (size_t idx = 1; !found && idx != this->queues.size(); ++idx) {
+      found = this->pop((own + idx) % this->queues.size(), task, false);
+    }
+    if (!found) {
+      return false;
+    }
+    task();
+    return true;
+  }
+};
+
+//
+// Tasks of a group run on `pool`, `wait` returns when all of them finished.
+// The waiting thread runs queued tasks meanwhile and sleeps when there are
+// none left, while the last tasks of the group run on other threads. The
+// first exception thrown by a task is rethrown by `wait`, the destructor
+// waits without rethrowing.
+//
+class TaskGroup {
+  ThreadPool &pool;
+  std::atomic<int> pending{0};
+  std::mutex mutex;
+  std::condition_variable done;
+  std::exception_ptr error;
+
+  // decrements `pending` when a task leaves, by return or by exception
+  struct Finish {
+    TaskGroup &group;
+    ~Finish() {
+      std::lock_guard<std::mutex> lock{this->group.mutex};
+      if (this->group.pending.fetch_sub(1, std::memory_order_release) == 1) {
+        this->group.done.notify_all();
+      }
+    }
+  };
+
+  void join() {
+    while (this->pending.load(std::memory_order_acquire) != 0) {
+      if (this->pool.try_run_one()) {
+        continue;
+      }
+      std::unique_lock<std::mutex> lock{this->mutex};
+      this->done.wait(lock, [this] {
+        return this->pending.load(std::memory_order_acquire) == 0;
+      });
+    }
+    // the last `Finish` may still hold the mutex
+    std::lock_guard<std::mutex> lock{this->mutex};
+  }
+
+ public:
+  explicit TaskGroup(ThreadPool &pool) : pool{pool} {}
+  TaskGroup(TaskGroup const &) = delete;
+  ~TaskGroup() { this->join(); }
+
+  template <typename Callback>
+  void run(Callback &&callback) {
+    this->pending.fetch_add(1, std::memory_order_relaxed);
+    this->pool.submit([this, callback = std::forward<Callback>(callback)] {
+      Finish const finish{*this};
+      try {
+        callback();
+      } catch (...) {
+        std::lock_guard<std::mutex> lock{this->mutex};
+        if (!this->error) {
+          this->error = std::current_exception();
+        }
+      }
+    });
+  }
+
+  void wait() {
+    this->join();
+    if (this->error) {
+      std::rethrow_exception(std::exchange(this->error, nullptr));
+    }
+  }
+};
+
+// Calls `callback(begin, end)` for chunks of [begin, end) that are at least
+// `grain` long, one chunk runs on the calling thread
+template <typename Callback>
+static inline void parallel_for(ThreadPool &pool, int begin, int end,
+                                int grain, Callback const &callback) {
+  int const size = end - begin;
+  if (size <= 0) {
+    return;
+  }
+  int const max_chunks = static_cast<int>(pool.concurrency());
+  int const num_chunks =
+      std::max(1, std::min(max_chunks, size / std::max(grain, 1)));
+  if (num_chunks == 1) {
+    callback(begin, end);
+    return;
+  }
+  TaskGroup group{pool};
+  for (int chunk = 1; chunk != num_chunks; ++chunk) {
+    int const chunk_begin = begin + static_cast<int>(
+                                        int64_t{size} * chunk / num_chunks);
+    int const chunk_end = begin + static_cast<int>(int64_t{size} *
+                                                   (chunk + 1) / num_chunks);
+    group.run([&callback, chunk_begin, chunk_end] {
+      callback(chunk_begin, chunk_end);
+    });
+  }
+  callback(begin, begin + static_cast<int>(int64_t{size} / num_chunks));
+  group.wait();
+}
+
+// Parallel execution mode for the transforms
+struct Parallel {
+  ThreadPool *pool;
+  // subtrees with height not greater than this are processed serially
+  int cutoff_height{64};
+  // minimal number of pixels in one chunk of a split merge step
+  int grain{1 << 14};
+
+  explicit Parallel(ThreadPool &pool) : pool{&pool} {}
+  Parallel(ThreadPool &pool, int cutoff_height)
+      : pool{&pool}, cutoff_height{cutoff_height} {}
+
+  // number of rows of width `width` per merge chunk
+  int rows_grain(int width) const {
+    return std::max(1, this->grain / std::max(width, 1));
+  }
+};
+
+}  // namespace adrt
@@ -1,7 +1,16 @@
 #include <gtest/gtest.h>
 
 #include <adrtlib/adrtlib.hpp>
+#include <algorithm>
 #include <array>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <limits>
+#include <numeric>
+#include <stdexcept>
+#include <thread>
 
 template <size_t N>
 static void check_equal(float const (&a)[N], float const (&b)[N]) {
@@ -427,3 +436,1379 @@ TEST(ADRTLib, ProcessPair_2_4_pos) {
   check_equal(exp0, line0);
   check_equal(exp1, line1);
 }
+
+template <typename Scalar>
+static void check_simd_add() {
+  using adrt::simd::ISA;
+  int const max_width = 131;
+  std::vector<Scalar> src0(max_width), src1(max_width);
+  for (int i = 0; i != max_width; ++i) {
+    src0[i] = static_cast<Scalar>(i * 7 + 3);
+    src1[i] = static_cast<Scalar>(i * 5 + 11);
+  }
+  for (ISA isa : {ISA::Scalar, ISA::SSE2, ISA::AVX2, ISA::AVX512}) {
+    if (static_cast<int>(isa) > static_cast<int>(adrt::simd::supported_isa())) {
+      break;
+    }
+    for (int width = 0; width != max_width; ++width) {
+      std::vector<Scalar> ref(max_width, Scalar{}), out(max_width, Scalar{});
+      adrt::simd::add_scalar(ref.data(), src0.data(), src1.data(), width);
+      adrt::simd::add(out.data(), src0.data(), src1.data(), width, isa);
+      ASSERT_EQ(ref, out) << adrt::simd::isa_name(isa) << " width " << width;
+      // in-place accumulation, as used by ProcessLineAndSaveT
+      std::vector<Scalar> inplace{src0};
+      adrt::simd::add(inplace.data(), inplace.data(), src1.data(), width, isa);
+      ASSERT_TRUE(std::equal(ref.begin(), ref.begin() + width, inplace.begin()))
+          << adrt::simd::isa_name(isa) << " in-place width " << width;
+    }
+  }
+}
+
+TEST(ADRTLib, simd_add_float) { check_simd_add<float>(); }
+TEST(ADRTLib, simd_add_double) { check_simd_add<double>(); }
+TEST(ADRTLib, simd_add_int32) { check_simd_add<int32_t>(); }
+TEST(ADRTLib, simd_add_uint32) { check_simd_add<uint32_t>(); }
+TEST(ADRTLib, simd_add_int64) { check_simd_add<int64_t>(); }
+TEST(ADRTLib, simd_add_uint64) { check_simd_add<uint64_t>(); }
+
+template <typename Scalar>
+static void check_simd_add_scaled() {
+  using adrt::simd::ISA;
+  int const max_width = 131;
+  std::vector<Scalar> src(max_width), init(max_width);
+  for (int i = 0; i != max_width; ++i) {
+    src[i] = static_cast<Scalar>(i * 7 + 3) / 9;
+    init[i] = static_cast<Scalar>(i * 5 + 11) / 7;
+  }
+  Scalar const weight = Scalar{1} / 3;
+  for (ISA isa : {ISA::Scalar, ISA::SSE2, ISA::AVX2, ISA::AVX512}) {
+    if (static_cast<int>(isa) > static_cast<int>(adrt::simd::supported_isa())) {
+      break;
+    }
+    for (int width = 0; width != max_width; ++width) {
+      std::vector<Scalar> ref{init}, out{init};
+      adrt::simd::add_scaled_scalar(ref.data(), src.data(), weight, width);
+      adrt::simd::add_scaled(out.data(), src.data(), weight, width, isa);
+      for (int i = 0; i != max_width; ++i) {
+        // up to a rounding of the product, which FMA skips
+        ASSERT_NEAR(ref[i], out[i], 4 * std::numeric_limits<Scalar>::epsilon() *
+                                        std::abs(ref[i]))
+            << adrt::simd::isa_name(isa) << " width " << width;
+      }
+    }
+  }
+}
+
+TEST(ADRTLib, simd_add_scaled_float) { check_simd_add_scaled<float>(); }
+TEST(ADRTLib, simd_add_scaled_double) { check_simd_add_scaled<double>(); }
+
+TEST(ADRTLib, simd_set_isa) {
+  using adrt::simd::ISA;
+  ISA const initial = adrt::simd::active_isa();
+  ASSERT_EQ(adrt::simd::set_isa(ISA::Scalar), ISA::Scalar);
+  ASSERT_EQ(adrt::simd::active_isa(), ISA::Scalar);
+  // never activates a level above the supported one
+  ASSERT_EQ(adrt::simd::set_isa(ISA::AVX512), adrt::simd::supported_isa());
+  adrt::simd::set_isa(initial);
+}
+
+// ProcessPair and ProcessLineWithoutSavingT as they were defined through a
+// full line rotation
+template <typename Scalar>
+static void ref_process_pair(std::vector<Scalar> &line0,
+                             std::vector<Scalar> &line1, adrt::Sign sign,
+                             int shift1) {
+  int const width = static_cast<int>(line0.size());
+  std::vector<Scalar> const l0{line0}, l1{line1};
+  for (int j = 0; j != width; ++j) {
+    int const delta = sign == adrt::Sign::Positive ? 1 : -1;
+    line1[j] = l0[j] + l1[((j - shift1) % width + width) % width];
+    line0[j] = l0[j] + l1[((j - shift1 + delta) % width + 2 * width) % width];
+  }
+}
+
+TEST(ADRTLib, ProcessPair_fused) {
+  for (int width = 1; width < 300; width += (width < 40 ? 1 : 37)) {
+    for (int shift = 0; shift != width + 1; ++shift) {
+      for (auto sign : {adrt::Sign::Positive, adrt::Sign::Negative}) {
+        std::vector<int> line0(width), line1(width);
+        for (int i = 0; i != width; ++i) {
+          line0[i] = i * i + 1;
+          line1[i] = 1000 * (i + 1);
+        }
+        std::vector<int> ref0{line0}, ref1{line1};
+        ref_process_pair(ref0, ref1, sign, shift);
+        std::vector<int> buffer(width, -1);
+        adrt::ProcessPair(line0.data(), line1.data(), buffer.data(), width,
+                          sign, shift);
+        ASSERT_EQ(ref0, line0) << "width " << width << " shift " << shift;
+        ASSERT_EQ(ref1, line1) << "width " << width << " shift " << shift;
+      }
+    }
+  }
+}
+
+TEST(ADRTLib, ProcessPair_wide) {
+  // lines longer than `shifted_add_tile` are walked in several chunks
+  for (int width : {1000, 4097}) {
+    std::vector<int> shifts{0, 1, 2, width / 2 - 1, width / 2, width / 2 + 1,
+                            width - 1, width};
+    for (int near : {adrt::shifted_add_tile, width - adrt::shifted_add_tile}) {
+      for (int shift : {near - 1, near, near + 1}) {
+        shifts.push_back(shift);
+      }
+    }
+    for (int shift : shifts) {
+      for (auto sign : {adrt::Sign::Positive, adrt::Sign::Negative}) {
+        std::vector<int> line0(width), line1(width);
+        for (int i = 0; i != width; ++i) {
+          line0[i] = i * i + 1;
+          line1[i] = 1000 * (i + 1);
+        }
+        std::vector<int> ref0{line0}, ref1{line1};
+        ref_process_pair(ref0, ref1, sign, shift);
+        std::vector<int> buffer(width / 2 + 2, -1);
+        adrt::ProcessPair(line0.data(), line1.data(), buffer.data(), width,
+                          sign, shift);
+        ASSERT_EQ(ref0, line0) << "width " << width << " shift " << shift;
+        ASSERT_EQ(ref1, line1) << "width " << width << " shift " << shift;
+
+        std::vector<int> line(width), ref(width);
+        for (int i = 0; i != width; ++i) {
+          line[i] = 1000 * (i + 1);
+        }
+        for (int i = 0; i != width; ++i) {
+          ref[i] = line0[i] + line[((i - shift) % width + width) % width];
+        }
+        adrt::ProcessLineWithoutSavingT(line0.data(), line.data(),
+                                        buffer.data(), width, shift);
+        ASSERT_EQ(ref, line) << "width " << width << " shift " << shift;
+      }
+    }
+  }
+}
+
+TEST(ADRTLib, ProcessLineWithoutSavingT_fused) {
+  for (int width = 1; width < 300; width += (width < 40 ? 1 : 37)) {
+    for (int shift = 0; shift != width + 1; ++shift) {
+      std::vector<int> line0(width), line1(width), ref(width);
+      for (int i = 0; i != width; ++i) {
+        line0[i] = i * i + 1;
+        line1[i] = 1000 * (i + 1);
+      }
+      for (int j = 0; j != width; ++j) {
+        ref[j] = line0[j] + line1[((j - shift) % width + width) % width];
+      }
+      std::vector<int> const ref0{line0};
+      std::vector<int> buffer(width, -1);
+      adrt::ProcessLineWithoutSavingT(line0.data(), line1.data(),
+                                      buffer.data(), width, shift);
+      ASSERT_EQ(ref, line1) << "width " << width << " shift " << shift;
+      ASSERT_EQ(ref0, line0) << "width " << width << " shift " << shift;
+    }
+  }
+}
+
+struct TestImage {
+  std::vector<int32_t> data;
+  adrt::Tensor2D tensor;
+  TestImage(int height, int width, int seed = 0)
+      : data(static_cast<size_t>(height) * width),
+        tensor{height, width,
+               static_cast<adrt::Tensor2D::stride_t>(width * sizeof(int32_t)),
+               nullptr} {
+    for (size_t idx = 0; idx != data.size(); ++idx) {
+      data[idx] = static_cast<int32_t>((idx * 2654435761u + seed) % 1000u);
+    }
+    tensor.data = reinterpret_cast<uint8_t *>(data.data());
+  }
+  adrt::Tensor2DTyped<int32_t> const &as() const {
+    return tensor.as<int32_t>();
+  }
+};
+
+// Every line crosses every image row once, so every row of a transform sums
+// to the sum of the image, `total`
+static ::testing::AssertionResult check_row_sums(TestImage const &out,
+                                                 int rows, int width,
+                                                 int64_t total) {
+  for (int t = 0; t != rows; ++t) {
+    auto const row = out.data.begin() + t * width;
+    int64_t const sum = std::accumulate(row, row + width, int64_t{0});
+    if (sum != total) {
+      return ::testing::AssertionFailure()
+             << "row " << t << " sums to " << sum << " instead of " << total;
+    }
+  }
+  return ::testing::AssertionSuccess();
+}
+
+// Calls `check(src, sign)` for images of every height and width and both
+// signs, until an assertion fails
+template <typename Check>
+static void for_each_shape(std::vector<int> const &heights,
+                           std::vector<int> const &widths,
+                           Check const &check) {
+  for (int height : heights) {
+    for (int width : widths) {
+      TestImage const src{height, width};
+      for (auto sign : {adrt::Sign::Positive, adrt::Sign::Negative}) {
+        check(src, sign);
+        if (::testing::Test::HasFatalFailure()) {
+          return;
+        }
+      }
+    }
+  }
+}
+
+TEST(ADRTLib, task_group) {
+  for (unsigned workers : {0u, 3u}) {
+    adrt::ThreadPool pool{workers};
+    // the first exception reaches `wait`, other tasks still run
+    std::atomic<int> finished{0};
+    adrt::TaskGroup group{pool};
+    for (int idx = 0; idx != 64; ++idx) {
+      group.run([&finished, idx] {
+        if (idx % 16 == 3) {
+          throw std::runtime_error{"task"};
+        }
+        finished.fetch_add(1);
+      });
+    }
+    ASSERT_THROW(group.wait(), std::runtime_error);
+    ASSERT_EQ(60, finished.load());
+    // the group is usable again
+    group.run([&finished] { finished.fetch_add(1); });
+    group.wait();
+    ASSERT_EQ(61, finished.load());
+    // nested groups, some tasks long enough for `wait` to sleep
+    std::atomic<int> leaves{0};
+    adrt::parallel_for(pool, 0, 8, 1, [&](int begin, int end) {
+      for (int idx = begin; idx != end; ++idx) {
+        adrt::TaskGroup inner{pool};
+        for (int leaf = 0; leaf != 4; ++leaf) {
+          inner.run([&leaves] {
+            std::this_thread::sleep_for(std::chrono::microseconds{200});
+            leaves.fetch_add(1);
+          });
+        }
+        inner.wait();
+      }
+    });
+    ASSERT_EQ(32, leaves.load());
+  }
+}
+
+TEST(ADRTLib, fht2d_parallel) {
+  adrt::ThreadPool pool{3};
+  for (int cutoff_height : {1, 2, 7}) {
+    adrt::Parallel parallel{pool, cutoff_height};
+    parallel.grain = 1;  // split every merge step
+    for (int height : {1, 2, 3, 5, 16, 33, 64, 100}) {
+      for (int width : {1, 7, 64}) {
+        TestImage const src{height, width};
+        TestImage const ref{height, width}, out{height, width};
+        auto const d = adrt::d<int32_t>::create(src.as());
+        for (auto sign : {adrt::Sign::Positive, adrt::Sign::Negative}) {
+          d.ds_recursive(ref.as(), src.as(), sign);
+          d.ds_recursive(out.as(), src.as(), sign, parallel);
+          ASSERT_EQ(ref.data, out.data) << "ds " << height << "x" << width;
+          d.dt_recursive(ref.as(), src.as(), sign);
+          d.dt_recursive(out.as(), src.as(), sign, parallel);
+          ASSERT_EQ(ref.data, out.data) << "dt " << height << "x" << width;
+        }
+      }
+    }
+  }
+}
+
+TEST(ADRTLib, non_recursive_parallel) {
+  adrt::ThreadPool pool{3};
+  adrt::Parallel parallel{pool};
+  parallel.grain = 1;  // split every merge step
+  for (int height : {1, 2, 3, 5, 16, 33, 64, 100}) {
+    for (int width : {1, 7, 64}) {
+      TestImage const src{height, width};
+      for (auto sign : {adrt::Sign::Positive, adrt::Sign::Negative}) {
+        TestImage const ref{height, width}, out{height, width};
+        auto const d = adrt::d<int32_t>::create(src.as());
+        d.ds_non_recursive(ref.as(), src.as(), sign);
+        d.ds_non_recursive(out.as(), src.as(), sign, parallel);
+        ASSERT_EQ(ref.data, out.data) << "ds " << height << "x" << width;
+        d.dt_non_recursive(ref.as(), src.as(), sign);
+        d.dt_non_recursive(out.as(), src.as(), sign, parallel);
+        ASSERT_EQ(ref.data, out.data) << "dt " << height << "x" << width;
+
+        TestImage const ids_ref{height, width}, ids_out{height, width};
+        auto const ids = adrt::ids_non_recursive<int32_t>::create(src.as());
+        ids(ids_ref.as(), sign);
+        std::vector<int> const ids_ref_swaps{ids.swaps.get(),
+                                             ids.swaps.get() + height};
+        ids(ids_out.as(), sign, parallel);
+        ASSERT_EQ(ids_ref.data, ids_out.data) << "ids " << height;
+        ASSERT_EQ(ids_ref_swaps,
+                  std::vector<int>(ids.swaps.get(), ids.swaps.get() + height));
+
+        TestImage const idt_ref{height, width}, idt_out{height, width};
+        auto idt = adrt::idt_non_recursive<int32_t>::create(src.as());
+        idt(idt_ref.as(), sign);
+        std::vector<int> const idt_ref_swaps{idt.swaps.get(),
+                                             idt.swaps.get() + height};
+        idt(idt_out.as(), sign, parallel);
+        ASSERT_EQ(idt_ref.data, idt_out.data) << "idt " << height;
+        ASSERT_EQ(idt_ref_swaps,
+                  std::vector<int>(idt.swaps.get(), idt.swaps.get() + height));
+      }
+    }
+  }
+}
+
+TEST(ADRTLib, fht2d_tiled) {
+  // the last two are the whole tree in strips and no tiling at all
+  for (auto tiling : {adrt::Tiling{4, 1}, adrt::Tiling{5, 2},
+                      adrt::Tiling{8, 5}, adrt::Tiling{3, 7},
+                      adrt::Tiling{4, 31}, adrt::Tiling{4, 0}}) {
+    for (int height : {2, 3, 5, 16, 33, 64, 100}) {
+      for (int width : {1, 7, 9, 64, 100}) {
+        TestImage const src{height, width};
+        auto const d = adrt::d<int32_t>::create(src.as());
+        for (auto sign : {adrt::Sign::Positive, adrt::Sign::Negative}) {
+          TestImage const ref{height, width}, out{height, width};
+          d.ds_recursive(ref.as(), src.as(), sign);
+          d.ds_recursive(out.as(), src.as(), sign, tiling);
+          ASSERT_EQ(ref.data, out.data) << "ds " << height << "x" << width;
+          d.dt_recursive(ref.as(), src.as(), sign);
+          d.dt_recursive(out.as(), src.as(), sign, tiling);
+          ASSERT_EQ(ref.data, out.data) << "dt " << height << "x" << width;
+        }
+      }
+    }
+  }
+}
+
+TEST(ADRTLib, fht2d_plan) {
+  for (int height : {1, 2, 3, 7, 16, 33, 100}) {
+    for (int width : {1, 2, 5, 64, 99}) {
+      TestImage const src{height, width}, buffer{height, width};
+      auto const d = adrt::d<int32_t>::create(src.as());
+      for (auto sign : {adrt::Sign::Positive, adrt::Sign::Negative}) {
+        TestImage const ref{height, width}, out{height, width};
+        adrt::fht2d_recursive(ref.as(), src.as(), buffer.as(), sign,
+                              adrt::ds_mid);
+        d.ds_recursive(out.as(), src.as(), sign);
+        ASSERT_EQ(ref.data, out.data) << "ds " << height << "x" << width;
+        d.ds_non_recursive(out.as(), src.as(), sign);
+        ASSERT_EQ(ref.data, out.data) << "ds " << height << "x" << width;
+        adrt::fht2d_recursive(ref.as(), src.as(), buffer.as(), sign,
+                              adrt::dt_mid);
+        d.dt_recursive(out.as(), src.as(), sign);
+        ASSERT_EQ(ref.data, out.data) << "dt " << height << "x" << width;
+        d.dt_non_recursive(out.as(), src.as(), sign);
+        ASSERT_EQ(ref.data, out.data) << "dt " << height << "x" << width;
+      }
+    }
+  }
+}
+
+TEST(ADRTLib, half_to_float) {
+  auto const to_float = [](uint16_t bits) {
+    return static_cast<float>(adrt::half{bits});
+  };
+  ASSERT_EQ(0.0f, to_float(0x0000));
+  ASSERT_TRUE(std::signbit(to_float(0x8000)));
+  ASSERT_EQ(1.0f, to_float(0x3c00));
+  ASSERT_EQ(-2.0f, to_float(0xc000));
+  ASSERT_EQ(65504.0f, to_float(0x7bff));
+  ASSERT_EQ(std::ldexp(1.0f, -24), to_float(0x0001));  // subnormals
+  ASSERT_EQ(std::ldexp(1023.0f, -24), to_float(0x03ff));
+  ASSERT_EQ(std::ldexp(1.0f, -14), to_float(0x0400));
+  ASSERT_EQ(-std::numeric_limits<float>::infinity(), to_float(0xfc00));
+  ASSERT_TRUE(std::isnan(to_float(0x7e00)));
+  ASSERT_EQ(1.0f, static_cast<float>(adrt::bfloat16{0x3f80}));
+  ASSERT_EQ(-3.5f, static_cast<float>(adrt::bfloat16{0xc060}));
+}
+
+// `Input` pixels give the transform of the same pixels widened beforehand
+template <typename Scalar, typename Input>
+static void check_narrow_input(std::vector<Input> const &pixels, int height,
+                               int width) {
+  std::vector<Scalar> widened(pixels.size());
+  for (size_t idx = 0; idx != pixels.size(); ++idx) {
+    widened[idx] = static_cast<Scalar>(pixels[idx]);
+  }
+  std::vector<Scalar> ref(pixels.size()), out(pixels.size());
+  auto const tensor = [&](auto const &data) {
+    using Pixel = typename std::decay_t<decltype(data)>::value_type;
+    return adrt::Tensor2D{
+        height, width,
+        static_cast<adrt::Tensor2D::stride_t>(width * sizeof(Pixel)),
+        reinterpret_cast<uint8_t *>(const_cast<Pixel *>(data.data()))};
+  };
+  adrt::Tensor2D const src{tensor(pixels)}, src_widened{tensor(widened)};
+  adrt::Tensor2D const ref_tensor{tensor(ref)}, out_tensor{tensor(out)};
+  auto const d = adrt::d<Scalar>::create(src_widened.as<Scalar>());
+  adrt::ThreadPool pool{2};
+  adrt::Parallel parallel{pool, 2};
+  parallel.grain = 1;
+  auto const &dst = out_tensor.as<Scalar>();
+  auto const &narrow = src.as<Input>();
+  for (auto sign : {adrt::Sign::Positive, adrt::Sign::Negative}) {
+    d.ds_recursive(ref_tensor.as<Scalar>(), src_widened.as<Scalar>(), sign);
+    d.ds_recursive(dst, narrow, sign);
+    ASSERT_EQ(ref, out) << "ds " << height << "x" << width;
+    d.ds_non_recursive(dst, narrow, sign);
+    ASSERT_EQ(ref, out) << "ds " << height << "x" << width;
+    d.ds_recursive(dst, narrow, sign, parallel);
+    ASSERT_EQ(ref, out) << "ds " << height << "x" << width;
+    d.ds_non_recursive(dst, narrow, sign, parallel);
+    ASSERT_EQ(ref, out) << "ds " << height << "x" << width;
+    d.dt_recursive(ref_tensor.as<Scalar>(), src_widened.as<Scalar>(), sign);
+    d.dt_recursive(dst, narrow, sign);
+    ASSERT_EQ(ref, out) << "dt " << height << "x" << width;
+    d.dt_non_recursive(dst, narrow, sign);
+    ASSERT_EQ(ref, out) << "dt " << height << "x" << width;
+    d.dt_recursive(dst, narrow, sign, parallel);
+    ASSERT_EQ(ref, out) << "dt " << height << "x" << width;
+    d.dt_non_recursive(dst, narrow, sign, parallel);
+    ASSERT_EQ(ref, out) << "dt " << height << "x" << width;
+  }
+}
+
+TEST(ADRTLib, fht2d_narrow_input) {
+  for (int height : {1, 2, 3, 7, 16, 33}) {
+    for (int width : {1, 5, 64}) {
+      size_t const size = static_cast<size_t>(height) * width;
+      std::vector<uint8_t> u8(size);
+      std::vector<uint16_t> u16(size);
+      std::vector<int16_t> i16(size);
+      std::vector<adrt::half> f16(size);
+      std::vector<adrt::bfloat16> bf16(size);
+      for (size_t idx = 0; idx != size; ++idx) {
+        uint32_t const value = static_cast<uint32_t>(idx * 2654435761u);
+        u8[idx] = static_cast<uint8_t>(value >> 24);
+        u16[idx] = static_cast<uint16_t>(value >> 16);
+        i16[idx] = static_cast<int16_t>(value >> 16);
+        // close to 1 with few mantissa bits, so that float sums are exact
+        f16[idx] = adrt::half{static_cast<uint16_t>(0x3c00 + (value >> 26))};
+        bf16[idx] =
+            adrt::bfloat16{static_cast<uint16_t>(0x3f80 + (value >> 26))};
+      }
+      check_narrow_input<int32_t>(u8, height, width);
+      check_narrow_input<int32_t>(u16, height, width);
+      check_narrow_input<int64_t>(i16, height, width);
+      check_narrow_input<float>(f16, height, width);
+      check_narrow_input<float>(bf16, height, width);
+    }
+  }
+}
+
+static int64_t dot(std::vector<int32_t> const &lhs,
+                   std::vector<int32_t> const &rhs) {
+  return std::inner_product(lhs.begin(), lhs.end(), rhs.begin(), int64_t{});
+}
+
+// <A x, y> == <x, A^T y> for every transform and its adjoint
+TEST(ADRTLib, fht2d_adjoint) {
+  for (int height : {1, 2, 3, 7, 16, 33, 100}) {
+    for (int width : {1, 2, 5, 64, 99}) {
+      TestImage const x{height, width};
+      auto const d = adrt::d<int32_t>::create(x.as());
+      auto const ids = adrt::ids_non_recursive<int32_t>::create(x.as());
+      auto idt = adrt::idt_non_recursive<int32_t>::create(x.as());
+      for (int seed : {17, 331}) {
+        TestImage const y{height, width, seed};
+        for (auto sign : {adrt::Sign::Positive, adrt::Sign::Negative}) {
+          TestImage const ax{height, width}, aty{height, width};
+          d.ds_recursive(ax.as(), x.as(), sign);
+          d.ds_adjoint(aty.as(), y.as(), sign);
+          ASSERT_EQ(dot(ax.data, y.data), dot(x.data, aty.data))
+              << "ds " << height << "x" << width;
+          d.dt_recursive(ax.as(), x.as(), sign);
+          d.dt_adjoint(aty.as(), y.as(), sign);
+          ASSERT_EQ(dot(ax.data, y.data), dot(x.data, aty.data))
+              << "dt " << height << "x" << width;
+          if (height < 2) {
+            continue;
+          }
+          TestImage const in_place{height, width};
+          ids(in_place.as(), sign);
+          d.ds_adjoint(aty.as(), y.as(), sign, ids.swaps.get());
+          ASSERT_EQ(dot(in_place.data, y.data), dot(x.data, aty.data))
+              << "ids " << height << "x" << width;
+          TestImage const in_place_t{height, width};
+          idt(in_place_t.as(), sign);
+          d.dt_adjoint(aty.as(), y.as(), sign, idt.swaps.get());
+          ASSERT_EQ(dot(in_place_t.data, y.data), dot(x.data, aty.data))
+              << "idt " << height << "x" << width;
+        }
+      }
+    }
+  }
+}
+
+TEST(ADRTLib, fht2m_reference) {
+  // values of `ref/fht2ms.py` and `ref/fht2mt.py`
+  std::vector<int32_t> const positive_5x4{
+      440,  4245, 3050, 1855, 1289, 1962, 3767, 2572,
+      1528, 2245, 3006, 2811, 2289, 2006, 2767, 2528};
+  std::vector<int32_t> const negative_5x4{
+      440,  4245, 3050, 1855, 2723, 3528, 2333, 1006,
+      2484, 3289, 2050, 1767, 2767, 2528, 2289, 2006};
+  std::vector<int32_t> const positive_6x7{
+      2905, 2471, 3037, 3603, 2169, 2735, 3301, 3037, 2949, 2515, 3081,
+      2647, 3213, 2779, 1647, 3559, 3471, 2037, 2603, 3169, 3735, 2691,
+      3603, 2515, 2754, 3320, 2886, 2452, 3169, 3081, 3320, 2559, 2798,
+      3364, 1930, 2125, 3364, 2603, 3842, 2081, 3320, 2886};
+  TestImage const src_5x4{5, 4}, src_6x7{6, 7};
+  TestImage const out_5x4{4, 4}, out_6x7{6, 7};
+  auto const m_5x4 = adrt::m<int32_t>::create(src_5x4.as());
+  auto const m_6x7 = adrt::m<int32_t>::create(src_6x7.as());
+  m_5x4.ms(out_5x4.as(), src_5x4.as(), adrt::Sign::Positive);
+  ASSERT_EQ(positive_5x4, out_5x4.data);
+  m_5x4.mt(out_5x4.as(), src_5x4.as(), adrt::Sign::Positive);
+  ASSERT_EQ(positive_5x4, out_5x4.data);
+  m_5x4.ms(out_5x4.as(), src_5x4.as(), adrt::Sign::Negative);
+  ASSERT_EQ(negative_5x4, out_5x4.data);
+  m_6x7.ms(out_6x7.as(), src_6x7.as(), adrt::Sign::Positive);
+  ASSERT_EQ(positive_6x7, out_6x7.data);
+  m_6x7.mt(out_6x7.as(), src_6x7.as(), adrt::Sign::Positive);
+  ASSERT_EQ(positive_6x7, out_6x7.data);
+}
+
+TEST(ADRTLib, fht2m) {
+  for_each_shape(
+      {1, 2, 3, 7, 16, 22, 33, 64, 100}, {1, 2, 5, 64, 99},
+      [](TestImage const &src, adrt::Sign sign) {
+        int const height = src.tensor.height, width = src.tensor.width;
+        int const rows = std::min(height, width);
+        int64_t const total =
+            std::accumulate(src.data.begin(), src.data.end(), int64_t{0});
+        auto const m = adrt::m<int32_t>::create(src.as());
+        TestImage const ms{rows, width}, mt{rows, width};
+        m.ms(ms.as(), src.as(), sign);
+        m.mt(mt.as(), src.as(), sign);
+        ASSERT_TRUE(check_row_sums(ms, rows, width, total))
+            << height << "x" << width;
+        ASSERT_TRUE(check_row_sums(mt, rows, width, total))
+            << height << "x" << width;
+        // with a power of two height the best patterns are the dyadic ones
+        if ((height & (height - 1)) == 0 && rows == height) {
+          TestImage const ds{height, width};
+          adrt::d<int32_t>::create(src.as()).ds_recursive(ds.as(), src.as(),
+                                                          sign);
+          ASSERT_EQ(ds.data, ms.data) << height << "x" << width;
+          ASSERT_EQ(ds.data, mt.data) << height << "x" << width;
+        }
+      });
+}
+
+TEST(ADRTLib, asd2_reference) {
+  // values of `ref/asd2.py`
+  std::vector<int32_t> const positive_5x4{
+      440,  4245, 3050, 1855, 1006, 2723, 3528, 2333,
+      1767, 2528, 2245, 3050, 2528, 2289, 2006, 2767};
+  std::vector<int32_t> const negative_5x4{
+      440,  4245, 3050, 1855, 1962, 3767, 2572, 1289,
+      2245, 3050, 1767, 2528, 2528, 2289, 2006, 2767};
+  std::vector<int32_t> const positive_7x7{
+      3867, 3194, 3521, 3848, 2175, 3502, 3829, 3565, 3911, 3238,
+      3565, 2892, 3219, 3546, 3175, 3521, 4194, 3521, 2848, 3175,
+      3502, 1892, 3892, 4238, 3238, 3565, 3892, 3219, 3175, 2848,
+      3848, 3521, 3521, 3848, 3175, 3892, 2892, 3565, 3565, 2565,
+      4565, 2892, 2848, 3848, 2848, 3848, 2848, 3848, 3848};
+  TestImage const src_5x4{5, 4}, src_7x7{7, 7};
+  TestImage const out_5x4{4, 4}, out_7x7{7, 7};
+  auto const asd2_5x4 = adrt::asd2<int32_t>::create(src_5x4.as());
+  asd2_5x4(out_5x4.as(), src_5x4.as(), adrt::Sign::Positive);
+  ASSERT_EQ(positive_5x4, out_5x4.data);
+  asd2_5x4(out_5x4.as(), src_5x4.as(), adrt::Sign::Negative);
+  ASSERT_EQ(negative_5x4, out_5x4.data);
+  adrt::asd2<int32_t>::create(src_7x7.as())(out_7x7.as(), src_7x7.as(),
+                                            adrt::Sign::Positive);
+  ASSERT_EQ(positive_7x7, out_7x7.data);
+}
+
+TEST(ADRTLib, asd2_statistics) {
+  // rows of `ref/asd2/statistics.csv`
+  struct Row {
+    int size;
+    int64_t memory;
+    int64_t operations;
+  };
+  for (Row const row : {Row{2, 8, 4}, Row{3, 30, 15}, Row{5, 120, 65},
+                        Row{16, 2048, 1408}, Row{33, 11022, 9801},
+                        Row{100, 134400, 188000}}) {
+    auto const plan = adrt::ASD2Plan::create(row.size, row.size);
+    ASSERT_EQ(row.memory, plan.statistics.memory) << row.size;
+    ASSERT_EQ(row.operations, plan.statistics.operations) << row.size;
+  }
+}
+
+TEST(ADRTLib, asd2) {
+  for_each_shape({1, 2, 3, 7, 16, 22, 33, 64}, {1, 2, 5, 64, 99},
+                 [](TestImage const &src, adrt::Sign sign) {
+                   int const height = src.tensor.height;
+                   int const width = src.tensor.width;
+                   int const rows = std::min(height, width);
+                   int64_t const total = std::accumulate(
+                       src.data.begin(), src.data.end(), int64_t{0});
+                   TestImage const out{rows, width};
+                   adrt::asd2<int32_t>::create(src.as())(out.as(), src.as(),
+                                                         sign);
+                   ASSERT_TRUE(check_row_sums(out, rows, width, total))
+                       << height << "x" << width;
+                 });
+}
+
+TEST(ADRTLib, fht2s_reference) {
+  // values of `ref/fht2ss.py` and `ref/fht2st.py`
+  std::vector<int32_t> const ss_positive_5x5{
+      2050, 2855, 2660, 2465, 2270, 2182, 2572, 2377, 2182,
+      2987, 2704, 2899, 2094, 1899, 2704, 2943, 3138, 2138,
+      1138, 2943, 3660, 3660, 2660, 1660, 660};
+  std::vector<int32_t> const ss_negative_6x6{
+      2490, 3056, 2622, 3188, 2754, 3320, 2534, 3100, 2666,
+      3232, 2798, 3100, 3056, 2622, 3188, 2754, 3188, 2622,
+      2339, 3905, 3471, 2471, 2905, 2339, 2861, 3427, 3427,
+      2427, 2427, 2861, 2905, 2905, 2905, 2905, 1905, 3905};
+  std::vector<int32_t> const st_positive_6x4{
+      660,  5226, 3792, 2358, 1226, 3704, 4270, 2836,
+      2270, 2748, 3226, 3792, 3031, 2509, 2987, 3509,
+      3270, 2748, 3270, 2748, 3748, 3270, 2792, 2226};
+  std::vector<int32_t> const st_negative_7x7{
+      3867, 3194, 3521, 3848, 2175, 3502, 3829, 3150, 3477, 3804,
+      3131, 2458, 3785, 4131, 2194, 3521, 3848, 3175, 2502, 4175,
+      4521, 2716, 3043, 4370, 2697, 3697, 3370, 4043, 2521, 3848,
+      3175, 4175, 2848, 3848, 3521, 2565, 3892, 3892, 3892, 2565,
+      3565, 3565, 1848, 3848, 4848, 2848, 1848, 4848, 3848};
+  auto const check = [](int height, int width, adrt::StripRule rule,
+                        adrt::Sign sign, std::vector<int32_t> const &ref) {
+    TestImage const src{height, width}, out{height, width};
+    auto const s = adrt::s<int32_t>::create(src.as());
+    if (rule == adrt::StripRule::SS) {
+      s.ss(out.as(), src.as(), sign);
+    } else {
+      s.st(out.as(), src.as(), sign);
+    }
+    ASSERT_EQ(ref, out.data) << height << "x" << width;
+  };
+  check(5, 5, adrt::StripRule::SS, adrt::Sign::Positive, ss_positive_5x5);
+  check(6, 6, adrt::StripRule::SS, adrt::Sign::Negative, ss_negative_6x6);
+  check(6, 4, adrt::StripRule::ST, adrt::Sign::Positive, st_positive_6x4);
+  check(7, 7, adrt::StripRule::ST, adrt::Sign::Negative, st_negative_7x7);
+}
+
+TEST(ADRTLib, fht2s) {
+  adrt::ThreadPool pool{3};
+  for_each_shape(
+      {1, 2, 3, 7, 16, 45, 100}, {1, 2, 5, 64, 99},
+      [&pool](TestImage const &src, adrt::Sign sign) {
+        int const height = src.tensor.height, width = src.tensor.width;
+        int64_t const total =
+            std::accumulate(src.data.begin(), src.data.end(), int64_t{0});
+        auto const s = adrt::s<int32_t>::create(src.as());
+        TestImage const ss{height, width}, st{height, width};
+        TestImage const ss_pool{height, width}, st_pool{height, width};
+        s.ss(ss.as(), src.as(), sign);
+        s.st(st.as(), src.as(), sign);
+        s.ss(ss_pool.as(), src.as(), sign, &pool);
+        s.st(st_pool.as(), src.as(), sign, &pool);
+        ASSERT_EQ(ss.data, ss_pool.data) << height << "x" << width;
+        ASSERT_EQ(st.data, st_pool.data) << height << "x" << width;
+        ASSERT_TRUE(check_row_sums(ss, height, width, total))
+            << height << "x" << width;
+        ASSERT_TRUE(check_row_sums(st, height, width, total))
+            << height << "x" << width;
+        // a power of two height is one strip
+        if ((height & (height - 1)) == 0) {
+          TestImage const ds{height, width};
+          adrt::d<int32_t>::create(src.as()).ds_recursive(ds.as(), src.as(),
+                                                          sign);
+          ASSERT_EQ(ds.data, ss.data) << height << "x" << width;
+        }
+      });
+}
+
+TEST(ADRTLib, fht2sp_reference) {
+  // values of `ref/fht2sp.py`
+  std::vector<int32_t> const positive_4x5{
+      1830, 1874, 1918, 1962, 2006, 1918, 2352, 1396, 1440, 2484,
+      2723, 2157, 2396, 1635, 679,  440,  2679, 2918, 2157, 1396};
+  std::vector<int32_t> const negative_7x3_hs2_ws1_ns0{
+      2943, 3270, 3597, 2748, 3075, 3987, 3270, 3031, 3509, 2509, 3270,
+      4031, 2270, 3031, 4509, 1509, 5270, 3031, 3509, 4270, 2031};
+  TestImage const src_4x5{4, 5}, src_7x3{7, 3};
+  TestImage const out_4x5{4, 5}, out_7x3{7, 3};
+  adrt::sp<int32_t>::create(src_4x5.as())(out_4x5.as(), src_4x5.as(),
+                                          adrt::Sign::Positive);
+  ASSERT_EQ(positive_4x5, out_4x5.data);
+  adrt::sp<int32_t>::create(src_7x3.as(), 2, 1, 0)(
+      out_7x3.as(), src_7x3.as(), adrt::Sign::Negative);
+  ASSERT_EQ(negative_7x3_hs2_ws1_ns0, out_7x3.data);
+}
+
+// `fht2sp` as in `ref/fht2sp.py`: `fht2dt` of the superpixel image
+static std::vector<int32_t> ref_fht2sp(TestImage const &src, adrt::Sign sign,
+                                       int hs, int ws, int ns) {
+  int const h = src.tensor.height, w = src.tensor.width;
+  int const super_h = h * hs, super_w = w * ws;
+  TestImage super_img{super_h, super_w}, super_fht{super_h, super_w};
+  std::fill(super_img.data.begin(), super_img.data.end(), 0);
+  for (int y = 0; y != h; ++y) {
+    for (int x = 0; x != super_w; ++x) {
+      super_img.data[(y * hs + ns) * super_w + x] = src.data[y * w + x / ws];
+    }
+  }
+  adrt::d<int32_t>::create(super_img.as())
+      .dt_recursive(super_fht.as(), super_img.as(), sign);
+  int const s = sign == adrt::Sign::Positive ? 1 : -1;
+  std::vector<int32_t> out(static_cast<size_t>(h) * w);
+  for (int y = 0; y != h; ++y) {
+    double const a = static_cast<double>(ws) / hs * (s * y / (h - 1.0));
+    for (int x = 0; x != w; ++x) {
+      double const b = ws * (x + 0.5) - 0.5;
+      int const l = static_cast<int>(std::nearbyint(a * (0.5 - hs / 2.0) + b));
+      int const r = static_cast<int>(
+          std::nearbyint(a * (super_h - 0.5 - hs / 2.0) + b));
+      int const xs = (l % super_w + super_w) % super_w;
+      int const ys = (s * (r - l) % super_h + super_h) % super_h;
+      out[y * w + x] = super_fht.data[ys * super_w + xs];
+    }
+  }
+  return out;
+}
+
+TEST(ADRTLib, fht2sp) {
+  for (int height : {2, 3, 7, 16, 45}) {
+    for (int width : {1, 2, 5, 64}) {
+      TestImage const src{height, width};
+      for (auto sign : {adrt::Sign::Positive, adrt::Sign::Negative}) {
+        // a 1x1 superpixel samples every line of `fht2dt` once
+        TestImage const out{height, width}, dt{height, width};
+        adrt::sp<int32_t>::create(src.as(), 1, 1)(out.as(), src.as(), sign);
+        adrt::d<int32_t>::create(src.as()).dt_recursive(dt.as(), src.as(),
+                                                        sign);
+        ASSERT_EQ(dt.data, out.data) << height << "x" << width;
+        for (int hs : {1, 2, 3, 4}) {
+          for (int ns = 0; ns != hs; ++ns) {
+            adrt::sp<int32_t>::create(src.as(), hs, 3, ns)(out.as(),
+                                                           src.as(), sign);
+            ASSERT_EQ(ref_fht2sp(src, sign, hs, 3, ns), out.data)
+                << height << "x" << width << " hs=" << hs << " ns=" << ns;
+          }
+        }
+      }
+    }
+  }
+  // a single row is returned as is
+  TestImage const src{1, 5}, out{1, 5};
+  adrt::sp<int32_t>::create(src.as())(out.as(), src.as(),
+                                      adrt::Sign::Positive);
+  ASSERT_EQ(src.data, out.data);
+}
+
+TEST(ADRTLib, fht2sp_buffers) {
+  // tall superpixels: the samples hit few rows of the superpixel transform
+  for (int hs : {8, 16}) {
+    TestImage const src{16, 20}, out{16, 20};
+    auto const sp = adrt::sp<int32_t>::create(src.as(), hs, 3);
+    size_t const full = 2 * static_cast<size_t>(16 * hs) * (20 * 3);
+    ASSERT_LE(sp.buffer_size() * 2, full) << "hs=" << hs;
+    for (auto sign : {adrt::Sign::Positive, adrt::Sign::Negative}) {
+      sp(out.as(), src.as(), sign);
+      ASSERT_EQ(ref_fht2sp(src, sign, hs, 3, hs / 2), out.data)
+          << "hs=" << hs;
+    }
+  }
+  // the default superpixel: every root row is sampled, the subtrees of
+  // the frontier share the buffers, which fit in the output
+  TestImage const src{16, 20}, out{16, 20};
+  auto const sp = adrt::sp<int32_t>::create(src.as());
+  ASSERT_LE(sp.buffer_size(), static_cast<size_t>(16) * 20);
+  for (auto sign : {adrt::Sign::Positive, adrt::Sign::Negative}) {
+    sp(out.as(), src.as(), sign);
+    ASSERT_EQ(ref_fht2sp(src, sign, 3, 3, 1), out.data);
+  }
+}
+
+TEST(ADRTLib, khanipov_reference) {
+  // values of `ref/khanipov.py`
+  std::vector<int32_t> const positive_4x5{
+      1830, 1874, 1918, 1962, 2006, 1918, 2352, 1396, 1440, 2484,
+      2201, 2635, 1874, 918,  1962, 2679, 2918, 2157, 1396, 440};
+  std::vector<int32_t> const positive_6x3{
+      2245, 2811, 3377, 2811, 2528, 3094, 1811, 3811, 2811,
+      2811, 2811, 2811, 2811, 2811, 2811, 2811, 2811, 2811};
+  TestImage const src_4x5{4, 5}, src_6x3{6, 3};
+  TestImage const out_4x5{4, 5}, out_6x3{6, 3};
+  adrt::khanipov<int32_t>::create(src_4x5.as())(out_4x5.as(), src_4x5.as(),
+                                                adrt::Sign::Positive);
+  ASSERT_EQ(positive_4x5, out_4x5.data);
+  adrt::khanipov<int32_t>::create(src_6x3.as())(out_6x3.as(), src_6x3.as(),
+                                                adrt::Sign::Positive);
+  ASSERT_EQ(positive_6x3, out_6x3.data);
+}
+
+TEST(ADRTLib, khanipov) {
+  for (int height : {2, 3, 8, 13, 33, 64}) {
+    for (int width : {1, 4, 31}) {
+      TestImage const src{height, width}, out{height, width};
+      auto const transform = adrt::khanipov<int32_t>::create(src.as());
+      for (auto sign : {adrt::Sign::Positive, adrt::Sign::Negative}) {
+        transform(out.as(), src.as(), sign);
+        // row `t` sums the digital straight line round(x * t / (h - 1))
+        std::vector<int32_t> ref(static_cast<size_t>(height) * width, 0);
+        for (int t = 0; t != height; ++t) {
+          for (int x = 0; x != height; ++x) {
+            int const y = (height - 1 + 2 * x * t) / (2 * (height - 1));
+            int const shift = adrt::apply_sign(sign, y, width);
+            for (int c = 0; c != width; ++c) {
+              ref[t * width + (c + shift) % width] += src.data[x * width + c];
+            }
+          }
+        }
+        ASSERT_EQ(ref, out.data) << height << "x" << width;
+      }
+    }
+  }
+  TestImage const src{1, 5}, out{1, 5};
+  adrt::khanipov<int32_t>::create(src.as())(out.as(), src.as(),
+                                            adrt::Sign::Positive);
+  ASSERT_EQ(src.data, out.data);
+}
+
+TEST(ADRTLib, dt_stream) {
+  struct Case {
+    int height, block;
+  };
+  for (Case c : {Case{1, 1}, Case{2, 1}, Case{6, 2}, Case{8, 2}, Case{12, 4},
+                 Case{16, 16}, Case{20, 4}, Case{24, 8}, Case{32, 4}}) {
+    for (int width : {1, 5, 16}) {
+      for (auto sign : {adrt::Sign::Positive, adrt::Sign::Negative}) {
+        int const total = 4 * c.height;
+        TestImage const rows{total, width}, window{c.height, width};
+        TestImage const out{c.height, width}, ref{c.height, width};
+        auto stream = adrt::dt_stream<int32_t>::create(window.as(), c.block,
+                                                       sign);
+        auto const transform = adrt::d<int32_t>::create(window.as());
+        int pushed = 0;
+        for (int chunk = 1; pushed + chunk * c.block <= total;
+             chunk = chunk % 3 + 1) {
+          int const end = pushed + chunk * c.block;
+          stream.push(adrt::slice_no_checks(rows.as(), pushed, end)
+                          .as<int32_t>());
+          pushed = end;
+          ASSERT_EQ(pushed >= c.height, stream.ready());
+          if (!stream.ready()) {
+            continue;
+          }
+          stream(out.as());
+          transform.dt_non_recursive(
+              ref.as(),
+              adrt::slice_no_checks(rows.as(), pushed - c.height, pushed)
+                  .as<int32_t>(),
+              sign);
+          ASSERT_EQ(ref.data, out.data)
+              << c.height << "x" << width << " block=" << c.block
+              << " pushed=" << pushed;
+        }
+      }
+    }
+  }
+}
+
+TEST(ADRTLib, d_incremental) {
+  for (int height : {1, 2, 5, 16, 33}) {
+    for (int width : {1, 7}) {
+      for (auto sign : {adrt::Sign::Positive, adrt::Sign::Negative}) {
+        for (bool is_dt : {false, true}) {
+          TestImage frame{height, width};
+          TestImage const out{height, width}, ref{height, width};
+          auto transform =
+              is_dt ? adrt::d_incremental<int32_t>::create(frame.as(), sign,
+                                                           adrt::dt_mid)
+                    : adrt::d_incremental<int32_t>::create(frame.as(), sign,
+                                                           adrt::ds_mid);
+          auto const d = adrt::d<int32_t>::create(frame.as());
+          int64_t const total =
+              (is_dt ? adrt::MergePlan::create(height, width, adrt::dt_mid)
+                     : adrt::MergePlan::create(height, width, adrt::ds_mid))
+                  .rows.size();
+          auto const check = [&](std::vector<adrt::Slice> const &changed) {
+            auto const stats = transform(out.as(), frame.as(), changed);
+            if (is_dt) {
+              d.dt_non_recursive(ref.as(), frame.as(), sign);
+            } else {
+              d.ds_non_recursive(ref.as(), frame.as(), sign);
+            }
+            EXPECT_EQ(ref.data, out.data) << height << "x" << width;
+            return stats;
+          };
+          // the first frame is transformed in full
+          auto stats = check({});
+          ASSERT_EQ(height > 1 ? total : 0, stats.merged_rows);
+          ASSERT_EQ(0, stats.skipped_rows);
+          // an unchanged frame runs the root only
+          stats = check({});
+          ASSERT_EQ(height > 1 ? height : 0, stats.merged_rows);
+          ASSERT_EQ(total, stats.merged_rows + stats.skipped_rows);
+          for (int begin = 0; begin < height; begin += 3) {
+            int const end = std::min(height, begin + 2);
+            for (int y = begin; y != end; ++y) {
+              frame.data[y * width] += 17 * y + 1;
+            }
+            frame.data[(height - 1) * width + width - 1] += 3;
+            check({adrt::Slice(begin, end),
+                   adrt::Slice(height - 1, height)});
+          }
+          transform.reset();
+          stats = check({});
+          ASSERT_EQ(height > 1 ? total : 0, stats.merged_rows);
+        }
+      }
+    }
+  }
+}
+
+TEST(ADRTLib, d_pruned) {
+  for (int height : {1, 2, 5, 16, 33, 64}) {
+    for (int width : {1, 7}) {
+      TestImage const src{height, width}, ref{height, width};
+      auto const d = adrt::d<int32_t>::create(src.as());
+      std::vector<std::vector<int>> subsets{{0}, {height - 1}};
+      std::vector<int> all, odd, band;
+      for (int t = 0; t != height; ++t) {
+        all.push_back(t);
+        if (t % 2 == 1) {
+          odd.push_back(height - t);  // descending
+        }
+        if (t >= height / 3 && t < height / 3 + 4) {
+          band.push_back(t);
+        }
+      }
+      subsets.push_back(all);
+      subsets.push_back(odd);
+      subsets.push_back(band);
+      subsets.push_back({height / 2, 0, height / 2});  // repeated
+      for (auto sign : {adrt::Sign::Positive, adrt::Sign::Negative}) {
+        for (bool is_dt : {false, true}) {
+          if (is_dt) {
+            d.dt_non_recursive(ref.as(), src.as(), sign);
+          } else {
+            d.ds_non_recursive(ref.as(), src.as(), sign);
+          }
+          for (auto const &ts : subsets) {
+            int const rows = static_cast<int>(ts.size());
+            TestImage const out{rows, width};
+            auto const pruned =
+                is_dt ? adrt::d_pruned<int32_t>::create(src.as(), ts,
+                                                        adrt::dt_mid)
+                      : adrt::d_pruned<int32_t>::create(src.as(), ts,
+                                                        adrt::ds_mid);
+            pruned(out.as(), src.as(), sign);
+            for (int i = 0; i != rows; ++i) {
+              for (int x = 0; x != width; ++x) {
+                ASSERT_EQ(ref.data[ts[i] * width + x], out.data[i * width + x])
+                    << height << "x" << width << " t=" << ts[i];
+              }
+            }
+          }
+        }
+      }
+    }
+  }
+  // a band of slopes merges a fraction of the rows
+  TestImage const src{1024, 1};
+  std::vector<int> const band{500, 501, 502, 503, 504, 505, 506, 507};
+  auto const pruned =
+      adrt::d_pruned<int32_t>::create(src.as(), band, adrt::ds_mid);
+  ASSERT_LT(pruned.merged_rows(), 1024 * 10 / 4);
+}
+
+TEST(ADRTLib, d_roi) {
+  for (int height : {1, 2, 5, 16, 33}) {
+    for (int width : {1, 7, 40, 100}) {
+      TestImage const src{height, width}, ref{height, width};
+      // the window is written into the middle of a wider image
+      TestImage const out{height, width + 3};
+      auto const d = adrt::d<int32_t>::create(src.as());
+      for (auto sign : {adrt::Sign::Positive, adrt::Sign::Negative}) {
+        for (bool is_dt : {false, true}) {
+          if (is_dt) {
+            d.dt_non_recursive(ref.as(), src.as(), sign);
+          } else {
+            d.ds_non_recursive(ref.as(), src.as(), sign);
+          }
+          for (int begin = 0; begin < width; begin += 3) {
+            for (int end : {begin + 1, (begin + width + 1) / 2, width}) {
+              if (end <= begin) {
+                continue;
+              }
+              auto const roi =
+                  is_dt ? adrt::d_roi<int32_t>::create(src.as(), begin, end,
+                                                       adrt::dt_mid)
+                        : adrt::d_roi<int32_t>::create(src.as(), begin, end,
+                                                       adrt::ds_mid);
+              adrt::Tensor2D dst{out.tensor};
+              dst.width = end - begin;
+              dst.data += 2 * sizeof(int32_t);
+              roi(dst.as<int32_t>(), src.as(), sign);
+              for (int y = 0; y != height; ++y) {
+                for (int x = begin; x != end; ++x) {
+                  ASSERT_EQ(ref.data[y * width + x],
+                            out.data[y * (width + 3) + x - begin + 2])
+                      << height << "x" << width << " [" << begin << ", "
+                      << end << ") y=" << y;
+                }
+              }
+            }
+          }
+        }
+      }
+    }
+  }
+  // lower levels of a wide image merge narrow windows
+  TestImage const src{64, 1024};
+  auto const roi =
+      adrt::d_roi<int32_t>::create(src.as(), 500, 516, adrt::ds_mid);
+  for (auto sign : {adrt::Sign::Positive, adrt::Sign::Negative}) {
+    ASSERT_LT(roi.merged_columns(sign), 64 * 1024 * 6 / 4);
+  }
+}
+
+TEST(ADRTLib, fht2d_top_k) {
+  for (int height : {1, 2, 5, 16, 33}) {
+    for (int width : {1, 3, 16}) {
+      // few values, so that neighbours tie
+      TestImage src{height, width};
+      for (int32_t &value : src.data) {
+        value %= 4;
+      }
+      TestImage const ref{height, width};
+      auto const d = adrt::d<int32_t>::create(src.as());
+      adrt::ThreadPool pool{3};
+      // chunks of a single row when there is no suppression
+      adrt::Parallel parallel{pool};
+      parallel.grain = 1;
+      for (auto sign : {adrt::Sign::Positive, adrt::Sign::Negative}) {
+        for (bool is_dt : {false, true}) {
+          if (is_dt) {
+            d.dt_non_recursive(ref.as(), src.as(), sign);
+          } else {
+            d.ds_non_recursive(ref.as(), src.as(), sign);
+          }
+          for (int radius : {0, 1, 3}) {
+            // local maxima of the whole image, by `adrt::stronger`
+            std::vector<adrt::HoughPeak<int32_t>> all;
+            for (int t = 0; t != height; ++t) {
+              for (int x = 0; x != width; ++x) {
+                adrt::HoughPeak<int32_t> const peak{ref.data[t * width + x],
+                                                    t, x};
+                bool is_peak = true;
+                for (int y = 0; y != height; ++y) {
+                  for (int nx = 0; nx != width; ++nx) {
+                    int const dx = std::min((nx - x + width) % width,
+                                            (x - nx + width) % width);
+                    if (std::abs(y - t) <= radius && dx <= radius &&
+                        (y != t || nx != x) &&
+                        adrt::stronger(adrt::HoughPeak<int32_t>{
+                                           ref.data[y * width + nx], y, nx},
+                                       peak)) {
+                      is_peak = false;
+                    }
+                  }
+                }
+                if (is_peak) {
+                  all.push_back(peak);
+                }
+              }
+            }
+            std::sort(all.begin(), all.end(), adrt::stronger<int32_t>);
+            // the larger child of the root or the ring, `ds` splits in
+            // halves and `dt` at a power of two
+            TestImage const scratch{is_dt ? d.dt_top_k_rows(radius)
+                                          : d.ds_top_k_rows(radius),
+                                    width};
+            ASSERT_LE(scratch.tensor.height,
+                      std::max({is_dt ? height - 1 : (height + 1) / 2,
+                                std::min(2 * radius + 1, height), 1}));
+            for (size_t k : {1, 4, 1000}) {
+              auto const serial =
+                  is_dt ? d.dt_top_k(src.as(), scratch.as(), sign, k, radius)
+                        : d.ds_top_k(src.as(), scratch.as(), sign, k, radius);
+              auto const chunked =
+                  is_dt ? d.dt_top_k(src.as(), scratch.as(), sign, k, radius,
+                                     parallel)
+                        : d.ds_top_k(src.as(), scratch.as(), sign, k, radius,
+                                     parallel);
+              for (auto const &peaks : {serial, chunked}) {
+                size_t const count = std::min(k, all.size());
+                ASSERT_EQ(count, peaks.size());
+                for (size_t idx = 0; idx != count; ++idx) {
+                  ASSERT_EQ(all[idx].value, peaks[idx].value);
+                  ASSERT_EQ(all[idx].t, peaks[idx].t);
+                  ASSERT_EQ(all[idx].x, peaks[idx].x)
+                      << height << "x" << width << " radius=" << radius;
+                }
+              }
+            }
+          }
+        }
+      }
+    }
+  }
+}
+
+TEST(ADRTLib, resample_reference) {
+  // values of `ref/fht2resample.py` for a 5x7 image, (3 * y + 5 * x) % 7
+  std::vector<double> const rdbu_positive{
+      14.533333, 13.422222, 14.177778, 14.933333, 15.066667, 14.266667,
+      11.6,      11.683333, 15.113889, 13.977778, 14.033333, 14.75,
+      14.241667, 14.2,      11.35,     14.836111, 13.988889, 13.95,
+      14.511111, 14.313889, 15.05,     12.658333, 14.5125,   13.85,
+      14.054167, 14.563889, 14.152778, 14.208333, 14.733333, 16.066667,
+      13.2,      13.716667, 15.122222, 13.427778, 11.733333};
+  std::vector<double> const rubd_negative{
+      14.897521, 14.178512, 17.021488, 15.009091, 17.892562, 14.17686,
+      13.733058, 11.57438,  16.229752, 17.443388, 14.09876,  16.590909,
+      14.171074, 16.800826, 12.52314,  18.628926, 14.866942, 14.921488,
+      15.047934, 15.978512, 14.942149, 15.02562,  15.95062,  15.318802,
+      15.271488, 15.005165, 15.374587, 14.96281,  13.108471, 14.949174,
+      16.260537, 15.030785, 14.115289, 16.825826, 16.619008};
+  int const height = 5, width = 7;
+  std::vector<double> src_data(height * width), out_data(height * width);
+  for (int y = 0; y != height; ++y) {
+    for (int x = 0; x != width; ++x) {
+      src_data[y * width + x] = (3 * y + 5 * x) % 7;
+    }
+  }
+  adrt::Tensor2D::stride_t const stride = width * sizeof(double);
+  adrt::Tensor2D const src{height, width, stride,
+                           reinterpret_cast<uint8_t *>(src_data.data())};
+  adrt::Tensor2D const out{height, width, stride,
+                           reinterpret_cast<uint8_t *>(out_data.data())};
+  auto const check = [&](adrt::HeightRound round, adrt::Sign sign,
+                         std::vector<double> const &ref) {
+    adrt::resample<double>::create(src.as<double>(), round)(
+        out.as<double>(), src.as<double>(), sign);
+    for (size_t idx = 0; idx != ref.size(); ++idx) {
+      ASSERT_NEAR(ref[idx], out_data[idx], 1e-6) << "index " << idx;
+    }
+  };
+  check(adrt::HeightRound::Floor, adrt::Sign::Positive, rdbu_positive);
+  check(adrt::HeightRound::Ceil, adrt::Sign::Negative, rubd_negative);
+}
+
+TEST(ADRTLib, resample) {
+  for (int height : {1, 2, 3, 7, 16, 45, 100}) {
+    for (int width : {1, 2, 5, 64, 99}) {
+      size_t const size = static_cast<size_t>(height) * width;
+      std::vector<float> src_data(size), out_data(size), dt_data(size);
+      for (size_t idx = 0; idx != size; ++idx) {
+        src_data[idx] = static_cast<float>((idx * 2654435761u) % 1000u);
+      }
+      adrt::Tensor2D::stride_t const stride = width * sizeof(float);
+      adrt::Tensor2D const src{height, width, stride,
+                               reinterpret_cast<uint8_t *>(src_data.data())};
+      adrt::Tensor2D const out{height, width, stride,
+                               reinterpret_cast<uint8_t *>(out_data.data())};
+      adrt::Tensor2D const dt{height, width, stride,
+                              reinterpret_cast<uint8_t *>(dt_data.data())};
+      double const total =
+          std::accumulate(src_data.begin(), src_data.end(), 0.0);
+      for (auto round : {adrt::HeightRound::Floor, adrt::HeightRound::Ceil}) {
+        auto const resample =
+            adrt::resample<float>::create(src.as<float>(), round);
+        for (auto sign : {adrt::Sign::Positive, adrt::Sign::Negative}) {
+          resample(out.as<float>(), src.as<float>(), sign);
+          if ((height & (height - 1)) == 0) {
+            // nothing to resize, weights are exactly 1
+            adrt::d<float>::create(src.as<float>())
+                .dt_recursive(dt.as<float>(), src.as<float>(), sign);
+            ASSERT_EQ(dt_data, out_data) << height << "x" << width;
+          }
+          // every row of the transform sums to `total` * new_h / h, the
+          // resize back scales the sum by h * w / (new_h * new_w)
+          double const expected = total * resample.new_height() * width /
+                                  resample.new_width();
+          double const sum =
+              std::accumulate(out_data.begin(), out_data.end(), 0.0);
+          ASSERT_NEAR(expected, sum, 1e-5 * expected)
+              << height << "x" << width;
+        }
+      }
+    }
+  }
+}
+
+template <typename Transform>
+static void check_idt_compiled() {
+  for (int height : {1, 2, 3, 5, 16, 33, 100}) {
+    for (int width : {1, 2, 7, 64}) {
+      for (auto sign : {adrt::Sign::Positive, adrt::Sign::Negative}) {
+        TestImage const ref{height, width}, out{height, width};
+        auto dynamic = Transform::create(ref.as());
+        auto compiled =
+            Transform::create(out.as(), adrt::ScheduleMode::Compiled);
+        dynamic(ref.as(), sign);
+        compiled(out.as(), sign);
+        ASSERT_EQ(ref.data, out.data) << height << "x" << width;
+        ASSERT_TRUE(std::equal(dynamic.swaps.get(),
+                               dynamic.swaps.get() + height,
+                               compiled.swaps.get()));
+        // replay must not depend on the state left by the previous call
+        compiled(out.as(), sign);
+        dynamic(ref.as(), sign);
+        ASSERT_EQ(ref.data, out.data) << height << "x" << width;
+      }
+    }
+  }
+}
+
+TEST(ADRTLib, idt_recursive_compiled) {
+  check_idt_compiled<adrt::idt_recursive<int32_t>>();
+}
+
+TEST(ADRTLib, idt_non_recursive_compiled) {
+  check_idt_compiled<adrt::idt_non_recursive<int32_t>>();
+}
+
+// `batch` images of `height` x `width` stored with padding between images
+struct TestBatch {
+  static constexpr int padding = 3;  // rows
+  std::vector<int32_t> data;
+  adrt::Tensor3D tensor;
+  TestBatch(int batch, int height, int width)
+      : data(static_cast<size_t>(batch) * (height + padding) * width),
+        tensor{batch,
+               height,
+               width,
+               static_cast<int64_t>((height + padding) * width * 4),
+               static_cast<adrt::Tensor2D::stride_t>(width * 4),
+               nullptr} {
+    for (size_t idx = 0; idx != data.size(); ++idx) {
+      data[idx] = static_cast<int32_t>((idx * 2654435761u) % 1000u);
+    }
+    tensor.data = reinterpret_cast<uint8_t *>(data.data());
+  }
+  std::vector<int32_t> image(int idx) const {
+    adrt::Tensor2D const image{tensor.image(idx)};
+    auto const begin = data.begin() + (image.data - tensor.data) / 4;
+    return std::vector<int32_t>(begin, begin + tensor.height * tensor.width);
+  }
+};
+
+TEST(ADRTLib, batch) {
+  adrt::ThreadPool pool{3};
+  int const batch = 7;
+  for (int height : {1, 2, 5, 16, 33}) {
+    for (int width : {1, 7, 64}) {
+      TestBatch const src{batch, height, width};
+      auto const d_batch = adrt::d_batch<int32_t>::create(height, width);
+      auto const ids_batch = adrt::ids_batch<int32_t>::create(height, width);
+      auto const idt_batch = adrt::idt_batch<int32_t>::create(height, width);
+      std::vector<int> swaps(batch * height);
+      for (auto sign : {adrt::Sign::Positive, adrt::Sign::Negative}) {
+        TestBatch const ds{batch, height, width}, dt{batch, height, width};
+        TestBatch const ids{batch, height, width}, idt{batch, height, width};
+        d_batch.ds(ds.tensor, src.tensor, sign, pool);
+        d_batch.dt(dt.tensor, src.tensor, sign, pool);
+        // in place, `TestBatch` fills the pixels of `src`
+        TestBatch const ds_inplace{batch, height, width};
+        d_batch.ds(ds_inplace.tensor, ds_inplace.tensor, sign, pool);
+        ASSERT_EQ(ds.data, ds_inplace.data) << height << "x" << width;
+        ids_batch(ids.tensor, src.tensor, sign, swaps.data(), pool);
+        std::vector<int> const ids_swaps{swaps};
+        idt_batch(idt.tensor, src.tensor, sign, swaps.data(), pool);
+        std::vector<int> const idt_swaps{swaps};
+        for (int idx = 0; idx != batch; ++idx) {
+          TestImage image{height, width};
+          TestImage const out{height, width};
+          std::vector<int32_t> const pixels{src.image(idx)};
+          std::copy(pixels.begin(), pixels.end(), image.data.begin());
+          auto const d = adrt::d<int32_t>::create(image.as());
+          d.ds_recursive(out.as(), image.as(), sign);
+          ASSERT_EQ(out.data, ds.image(idx));
+          d.dt_recursive(out.as(), image.as(), sign);
+          ASSERT_EQ(out.data, dt.image(idx));
+
+          auto ids_one = adrt::ids_non_recursive<int32_t>::create(image.as());
+          ids_one(image.as(), sign);
+          ASSERT_EQ(image.data, ids.image(idx));
+          if (height > 1) {
+            ASSERT_TRUE(std::equal(ids_one.swaps.get(),
+                                   ids_one.swaps.get() + height,
+                                   ids_swaps.begin() + idx * height));
+          }
+
+          std::copy(pixels.begin(), pixels.end(), image.data.begin());
+          auto idt_one = adrt::idt_non_recursive<int32_t>::create(image.as());
+          idt_one(image.as(), sign);
+          ASSERT_EQ(image.data, idt.image(idx));
+          ASSERT_TRUE(std::equal(idt_one.swaps.get(),
+                                 idt_one.swaps.get() + height,
+                                 idt_swaps.begin() + idx * height));
+        }
+      }
+    }
+  }
+}
+
+TEST(ADRTLib, fht2_full) {
+  adrt::ThreadPool pool{3};
+  for (auto transform : {adrt::FullTransform::DS, adrt::FullTransform::DT,
+                         adrt::FullTransform::IDS, adrt::FullTransform::IDT}) {
+    for (auto shape : {std::pair{1, 1}, {2, 2}, {5, 5}, {16, 16}, {33, 33},
+                       {70, 70}, {1, 4}, {5, 2}, {16, 33}, {70, 9}}) {
+      int const height = shape.first;
+      int const width = shape.second;
+      TestImage const src{height, width};
+      TestImage transposed{width, height};
+      adrt::transpose_tensor(transposed.as(), src.as());
+      auto const full =
+          adrt::fht2_full<int32_t>::create(transform, height, width);
+      for (adrt::ThreadPool *cur_pool : {&pool, (adrt::ThreadPool *)nullptr}) {
+        TestBatch const out{2, height, width}, out_T{2, width, height};
+        std::vector<int> swaps(2 * (height + width));
+        full(out.tensor, out_T.tensor, src.as(), swaps.data(), cur_pool);
+        for (int quadrant = 0; quadrant != 4; ++quadrant) {
+          auto const sign = quadrant % 2 == 0 ? adrt::Sign::Positive
+                                              : adrt::Sign::Negative;
+          TestImage const &image = quadrant < 2 ? src : transposed;
+          int const rows = image.tensor.height;
+          TestImage ref{rows, image.tensor.width};
+          std::vector<int> ref_swaps(rows);
+          if (transform == adrt::FullTransform::DS) {
+            adrt::d<int32_t>::create(image.as()).ds_recursive(
+                ref.as(), image.as(), sign);
+          } else if (transform == adrt::FullTransform::DT) {
+            adrt::d<int32_t>::create(image.as()).dt_recursive(
+                ref.as(), image.as(), sign);
+          } else {
+            std::copy(image.data.begin(), image.data.end(), ref.data.begin());
+            if (transform == adrt::FullTransform::IDS) {
+              auto ids = adrt::ids_recursive<int32_t>::create(ref.as());
+              ids(ref.as(), sign);
+              std::copy(ids.swaps.get(), ids.swaps.get() + rows,
+                        ref_swaps.begin());
+            } else {
+              auto idt = adrt::idt_recursive<int32_t>::create(ref.as());
+              idt(ref.as(), sign);
+              std::copy(idt.swaps.get(), idt.swaps.get() + rows,
+                        ref_swaps.begin());
+            }
+            if (rows > 1) {
+              ASSERT_TRUE(std::equal(ref_swaps.begin(), ref_swaps.end(),
+                                     swaps.begin() +
+                                         full.swaps_offset(quadrant)));
+            }
+          }
+          ASSERT_EQ(ref.data, quadrant < 2 ? out.image(quadrant)
+                                           : out_T.image(quadrant - 2))
+              << height << "x" << width << " quadrant " << quadrant;
+        }
+      }
+    }
+  }
+}